@@ -0,0 +1,803 @@
+﻿/*
+ * Concurrent hash map container (sharded)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "chmap.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define ALLOC(t)            ((t*)malloc(sizeof(t)))
+
+#define DEFAULT_SHARDS      16
+#define CACHE_LINE_SIZE     64
+#define ITER_KEY_SIZE       64    // 走査子のキー複製領域の初期サイズ
+#define SHARD_FLAGS         (HMAP_FLAG_GROWABLE|HMAP_FLAG_STABLE_FETCH)
+
+/*
+ * シャードの選択
+ *
+ *  FNV1のハッシュ値の上位bitにはキーの末尾のバイトがほとんど影響しないた
+ *  め、上位bitをそのまま使うと先頭が共通するキーが同じシャードに集中する。
+ *  このため撹拌(mix())した値からシャードを選択する。hmap_tのバケット位置
+ *  は撹拌前のハッシュ値の下位bitで決まるので、撹拌後の上位bitを使用する。
+ */
+#define SHARD(ptr,hv)       ((ptr)->shard + ((mix(hv) >> 32) & (ptr)->mask))
+
+/*
+ * 構造体の定義
+ *
+ *  シャード間でのフォルスシェアリングを避けるため、各シャードはキャッシュ
+ *  ラインの境界に揃えて配置する。
+ */
+struct shard {
+  pthread_rwlock_t lock;
+  hmap_t* map;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct __chmap_t__ {
+  struct shard* shard;
+  size_t size;
+  size_t mask;
+};
+
+/*
+ * 内部処理用の非公開関数の定義
+ */
+// MurmurHash3のfmix64(ハッシュ値の各bitを全体に拡散させる)
+static inline uint64_t
+mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+static int
+store_entry(chmap_t* ptr, void* key, size_t len, void* val)
+{
+  int ret;
+  uint64_t hv;
+  struct shard* sh;
+
+  ret = 0;
+  hv  = hmap_hash_fnv1(key, len, 0);
+  sh  = SHARD(ptr, hv);
+
+  if (pthread_rwlock_wrlock(&sh->lock)) ret = CHMAP_ERROR_LOCK;
+
+  if (!ret) {
+    ret = hmap_store_hashed(sh->map, key, len, hv, val);
+    pthread_rwlock_unlock(&sh->lock);
+  }
+
+  return ret;
+}
+
+static int
+fetch_entry(chmap_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+  uint64_t hv;
+  struct shard* sh;
+
+  ret = 0;
+  hv  = hmap_hash_fnv1(key, len, 0);
+  sh  = SHARD(ptr, hv);
+
+  if (pthread_rwlock_rdlock(&sh->lock)) ret = CHMAP_ERROR_LOCK;
+
+  if (!ret) {
+    ret = hmap_fetch_hashed(sh->map, key, len, hv, dst);
+    pthread_rwlock_unlock(&sh->lock);
+  }
+
+  return ret;
+}
+
+static int
+remove_entry(chmap_t* ptr, void* key, size_t len)
+{
+  int ret;
+  uint64_t hv;
+  struct shard* sh;
+
+  ret = 0;
+  hv  = hmap_hash_fnv1(key, len, 0);
+  sh  = SHARD(ptr, hv);
+
+  if (pthread_rwlock_wrlock(&sh->lock)) ret = CHMAP_ERROR_LOCK;
+
+  if (!ret) {
+    ret = hmap_remove_hashed(sh->map, key, len, hv);
+    pthread_rwlock_unlock(&sh->lock);
+
+    if (ret == HMAP_ERROR_EMPTY) ret = CHMAP_ERROR_NOT_FOUND;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int copy_key(chmap_iter_t* it, void* key, size_t ksz)
+ *
+ * @brief 走査子へのキーの複製
+ *
+ * @remark
+ *  NUL終端を付加して複製する。領域が足りない場合は倍々で拡張する。
+ */
+static int
+copy_key(chmap_iter_t* it, void* key, size_t ksz)
+{
+  int ret;
+  size_t capa;
+  char* p;
+
+  ret = 0;
+
+  if (ksz + 1 > it->capa) {
+    capa = (it->capa > 0)? it->capa: ITER_KEY_SIZE;
+    while (capa < ksz + 1) capa *= 2;
+
+    p = (char*)realloc(it->key, capa);
+    if (p != NULL) {
+      it->key  = p;
+      it->capa = capa;
+
+    } else {
+      ret = CHMAP_ERROR_NO_MEMORY;
+    }
+  }
+
+  if (!ret) {
+    memcpy(it->key, key, ksz);
+    it->key[ksz] = '\0';
+  }
+
+  return ret;
+}
+
+/*
+ * 外部公開関数の定義
+ */
+
+int
+chmap_new(size_t shards, size_t size, int flags, chmap_t** dst)
+{
+  int ret;
+  int err;
+  chmap_t* obj;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+  i   = 0;
+
+  if (shards == 0) shards = DEFAULT_SHARDS;
+
+  /*
+   * argument check
+   */
+  do {
+    if (shards > CHMAP_MAX_SHARDS) {
+      ret = CHMAP_ERROR_OUT_OF_RANGE;
+      break;
+    }
+
+    // 二の冪乗チェック
+    if ((shards & (shards - 1)) != 0) {
+      ret = CHMAP_ERROR_CONSTRAINT;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) do {
+    obj = ALLOC(chmap_t);
+    if (obj == NULL) {
+      ret = CHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    memset(obj, 0, sizeof(*obj));
+
+    err = posix_memalign((void**)&obj->shard,
+                         CACHE_LINE_SIZE, sizeof(struct shard) * shards);
+    if (err) {
+      obj->shard = NULL;
+      ret        = CHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    /*
+     * setup shards
+     */
+    for (i = 0; i < shards; i++) {
+      ret = hmap_new2(size, SHARD_FLAGS | flags, &obj->shard[i].map);
+      if (ret) break;
+
+      if (pthread_rwlock_init(&obj->shard[i].lock, NULL)) {
+        hmap_destroy(obj->shard[i].map);
+        ret = CHMAP_ERROR_LOCK;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->size = shards;
+    obj->mask = shards - 1;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) {
+      if (obj->shard != NULL) {
+        while (i-- > 0) {
+          pthread_rwlock_destroy(&obj->shard[i].lock);
+          hmap_destroy(obj->shard[i].map);
+        }
+
+        free(obj->shard);
+      }
+
+      free(obj);
+    }
+  }
+
+  return ret;
+}
+
+int
+chmap_destroy(chmap_t* ptr)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->size; i++) {
+      hmap_destroy(ptr->shard[i].map);
+      pthread_rwlock_destroy(&ptr->shard[i].lock);
+    }
+
+    free(ptr->shard);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+chmap_store(chmap_t* ptr, char* key, void* val)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, strlen(key), val);
+
+  return ret;
+}
+
+int
+chmap_store_bin(chmap_t* ptr, void* key, size_t len, void* val)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, len, val);
+
+  return ret;
+}
+
+int
+chmap_fetch(chmap_t* ptr, char* key, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, strlen(key), dst);
+
+  return ret;
+}
+
+int
+chmap_fetch_bin(chmap_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, len, dst);
+
+  return ret;
+}
+
+int
+chmap_remove(chmap_t* ptr, char* key)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, strlen(key));
+
+  return ret;
+}
+
+int
+chmap_remove_bin(chmap_t* ptr, void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, len);
+
+  return ret;
+}
+
+int
+chmap_clear(chmap_t* ptr)
+{
+  int ret;
+  size_t i;
+  struct shard* sh;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * clear each shard
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->size; i++) {
+      sh = ptr->shard + i;
+
+      if (pthread_rwlock_wrlock(&sh->lock)) {
+        ret = CHMAP_ERROR_LOCK;
+        break;
+      }
+
+      ret = hmap_clear(sh->map);
+      pthread_rwlock_unlock(&sh->lock);
+
+      if (ret) break;
+    }
+  }
+
+  return ret;
+}
+
+int
+chmap_size(chmap_t* ptr, size_t* dst)
+{
+  int ret;
+  size_t i;
+  size_t n;
+  size_t sum;
+  struct shard* sh;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  sum = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * count entries
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->size; i++) {
+      sh = ptr->shard + i;
+
+      if (pthread_rwlock_rdlock(&sh->lock)) {
+        ret = CHMAP_ERROR_LOCK;
+        break;
+      }
+
+      hmap_size(sh->map, &n);
+      pthread_rwlock_unlock(&sh->lock);
+
+      sum += n;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = sum;
+
+  return ret;
+}
+
+int
+chmap_set_callback(chmap_t* ptr, void (*fn)(char*, void*))
+{
+  int ret;
+  size_t i;
+  struct shard* sh;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * object update
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->size; i++) {
+      sh = ptr->shard + i;
+
+      if (pthread_rwlock_wrlock(&sh->lock)) {
+        ret = CHMAP_ERROR_LOCK;
+        break;
+      }
+
+      hmap_set_callback(sh->map, fn);
+      pthread_rwlock_unlock(&sh->lock);
+    }
+  }
+
+  return ret;
+}
+
+int
+chmap_iter_init(chmap_t* ptr, chmap_iter_t* it)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (it == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * setup iterator
+   */
+  if (!ret) {
+    it->map   = ptr;
+    it->shard = 0;
+    it->pos   = 0;
+    it->key   = NULL;
+    it->capa  = 0;
+  }
+
+  return ret;
+}
+
+int
+chmap_iter_next(chmap_iter_t* it, void** dsk, size_t* dsz, void** dsv)
+{
+  int ret;
+  struct shard* sh;
+  size_t pos;
+  void* key;
+  size_t ksz;
+  void* val;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (it == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (it->map == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = CHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   *
+   *  現在のシャードの終端に達したら次のシャードの先頭から探す。キーの実体
+   *  はロックの開放後に他スレッドの削除やリハッシュで開放・移動されうるの
+   *  で、ロックを保持している間に走査子の領域へ複製する。
+   */
+  if (!ret) {
+    ret = CHMAP_ERROR_NOT_FOUND;
+
+    while (it->shard < it->map->size) {
+      sh = it->map->shard + it->shard;
+
+      if (pthread_rwlock_rdlock(&sh->lock)) {
+        ret = CHMAP_ERROR_LOCK;
+        break;
+      }
+
+      pos = it->pos;
+      ret = hmap_iter_r(sh->map, &pos, &key, &ksz, &val);
+
+      if (!ret) {
+        ret = copy_key(it, key, ksz);
+        if (!ret) it->pos = pos;
+      }
+
+      pthread_rwlock_unlock(&sh->lock);
+
+      if (ret != HMAP_ERROR_NOT_FOUND) break;
+
+      it->shard++;
+      it->pos = 0;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsk != NULL) *dsk = it->key;
+    if (dsz != NULL) *dsz = ksz;
+    *dsv = val;
+  }
+
+  return ret;
+}
+
+int
+chmap_iter_release(chmap_iter_t* it)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (it == NULL) ret = CHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    if (it->key != NULL) free(it->key);
+
+    it->map  = NULL;
+    it->key  = NULL;
+    it->capa = 0;
+  }
+
+  return ret;
+}
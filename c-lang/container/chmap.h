@@ -0,0 +1,297 @@
+﻿/*
+ * Concurrent hash map container (sharded)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __CONCURRENT_HASH_MAP_H__
+#define __CONCURRENT_HASH_MAP_H__
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hmap.h"
+
+typedef struct __chmap_t__ chmap_t;
+
+/*
+ * 走査子(呼び出し側で確保する)
+ */
+typedef struct {
+  chmap_t* map;
+  size_t shard;
+  size_t pos;
+  char* key;          // 直前に返したキーの複製(走査子が所有する)
+  size_t capa;        // keyの領域のサイズ
+} chmap_iter_t;
+
+#define CHMAP_ERROR_OUT_OF_RANGE    HMAP_ERROR_OUT_OF_RANGE
+#define CHMAP_ERROR_CONSTRAINT      HMAP_ERROR_CONSTRAINT
+#define CHMAP_ERROR_NULL_POINTER    HMAP_ERROR_NULL_POINTER
+#define CHMAP_ERROR_NO_MEMORY       HMAP_ERROR_NO_MEMORY
+#define CHMAP_ERROR_EMPTY           HMAP_ERROR_EMPTY
+#define CHMAP_ERROR_NOT_FOUND       HMAP_ERROR_NOT_FOUND
+#define CHMAP_ERROR_LOCK            (-10)   // HMAP_ERROR_*と重ならない値
+
+#define CHMAP_MAX_SHARDS            (1024)
+
+/*
+ * @fn
+ *   int chmap_new(size_t shards, size_t size, int flags, chmap_t** dst);
+ *
+ * @brief  並行ハッシュマップオブジェクトの生成
+ *
+ * @param [in] shards  シャード数(2の冪乗、0の場合は16)
+ * @param [in] size  シャード毎のハッシュマップの初期サイズ
+ * @param [in] flags  各シャードのハッシュマップに追加で指定するフラグ
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval CHMAP_ERROR_OUT_OF_RANGE
+ *   引数shardsがCHMAP_MAX_SHARDSを超える場合、または引数sizeが16未満の場
+ *   合に返す。
+ *
+ * @retval CHMAP_ERROR_CONSTRAINT
+ *   引数shardsまたは引数sizeが2の冪乗数でない場合、または引数flagsに未定
+ *   義のフラグが含まれている場合に返す。
+ *
+ * @retval CHMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval CHMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @retval CHMAP_ERROR_LOCK
+ *   ロックの初期化に失敗した場合に返す。
+ *
+ * @remark
+ *   本オブジェクトはキーのハッシュ値を撹拌した値で選択される複数のシャード
+ *   から構成され、各シャードは独立した読み書きロックとhmap_tを持つ。異なる
+ *   シャードへのアクセスは互いに待たされず、同じシャードへのアクセスも読み
+ *   出し同士であれば並行して行われる。
+ *
+ * @remark
+ *   各シャードのハッシュマップはHMAP_FLAG_GROWABLE及び
+ *   HMAP_FLAG_STABLE_FETCHを指定して生成する(引数flagsはこれに追加される)。
+ */
+extern int chmap_new(size_t shards, size_t size, int flags, chmap_t** dst);
+
+/*
+ * @fn
+ *   int chmap_destroy(chmap_t* ptr);
+ *
+ * @brief  並行ハッシュマップオブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象のオブジェクト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   他のスレッドがアクセスしていない状態で呼び出すこと。
+ */
+extern int chmap_destroy(chmap_t* ptr);
+
+/*
+ * @fn
+ *   int chmap_store(chmap_t* ptr, char* key, void* value);
+ *
+ * @brief  並行ハッシュマップへの保存
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  データのキー(NUL終端文字列)
+ * @param [in] value  データの値(任意のオブジェクトのポインタ, NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   対象シャードの書き込みロックを取得して保存を行う。その他はhmap_store()
+ *   と同じ。
+ */
+extern int chmap_store(chmap_t* ptr, char* key, void* value);
+
+/*
+ * @fn
+ *   int chmap_store_bin(chmap_t* ptr, void* key, size_t len, void* value);
+ *
+ * @brief  並行ハッシュマップへの保存(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はchmap_store()と同じ。
+ */
+extern int chmap_store_bin(chmap_t* ptr, void* key, size_t len, void* value);
+
+/*
+ * @fn
+ *   int chmap_fetch(chmap_t* ptr, char* key, void** dst);
+ *
+ * @brief  並行ハッシュマップの読み出し
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  読み出し対象のキー
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval CHMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ *
+ * @remark
+ *   対象シャードの読み出しロックのみを取得する。読み出し処理はハッシュマッ
+ *   プを変更しないので、同じシャードに対する読み出し同士は並行して行われる。
+ */
+extern int chmap_fetch(chmap_t* ptr, char* key, void** dst);
+
+/*
+ * @fn
+ *   int chmap_fetch_bin(chmap_t* ptr, void* key, size_t len, void** dst);
+ *
+ * @brief  並行ハッシュマップの読み出し(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はchmap_fetch()と同じ。
+ */
+extern int chmap_fetch_bin(chmap_t* ptr, void* key, size_t len, void** dst);
+
+/*
+ * @fn
+ *   int chmap_remove(chmap_t* ptr, char* key);
+ *
+ * @brief  並行ハッシュマップからの削除
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  削除対象のキー
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval CHMAP_ERROR_NOT_FOUND
+ *   キーに対応するエントリが見つからなかった場合に返す。
+ *
+ * @remark
+ *   空のシャードに対して呼び出した場合もCHMAP_ERROR_NOT_FOUNDを返す。
+ */
+extern int chmap_remove(chmap_t* ptr, char* key);
+
+/*
+ * @fn
+ *   int chmap_remove_bin(chmap_t* ptr, void* key, size_t len);
+ *
+ * @brief  並行ハッシュマップからの削除(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はchmap_remove()と同じ。
+ */
+extern int chmap_remove_bin(chmap_t* ptr, void* key, size_t len);
+
+/*
+ * @fn
+ *   int chmap_clear(chmap_t* ptr);
+ *
+ * @brief  並行ハッシュマップのクリア
+ *
+ * @remark
+ *   シャード毎に順次クリアを行うので、全体としては不可分な操作ではない。
+ */
+extern int chmap_clear(chmap_t* ptr);
+
+/*
+ * @fn
+ *   int chmap_size(chmap_t* ptr, size_t* dst);
+ *
+ * @brief  登録済みエントリ数の取得
+ *
+ * @remark
+ *   各シャードのエントリ数の合計を返す。他スレッドによる更新中の場合、値
+ *   は概数となる。
+ */
+extern int chmap_size(chmap_t* ptr, size_t* dst);
+
+/*
+ * @fn
+ *   int chmap_set_callback(chmap_t* ptr, void(*fn)(char*, void*));
+ *
+ * @brief  コールバック関数の登録
+ *
+ * @remark
+ *   hmap_set_callback()と同じ。コールバック関数は対象シャードの書き込みロ
+ *   ックを保持した状態で呼び出されるので、コールバック関数から同じオブジェ
+ *   クトにアクセスしてはならない。
+ */
+extern int chmap_set_callback(chmap_t* ptr, void(*fn)(char*, void*));
+
+/*
+ * @fn
+ *   int chmap_iter_init(chmap_t* ptr, chmap_iter_t* it);
+ *
+ * @brief  走査子の初期化
+ *
+ * @param [in] ptr  走査対象のオブジェクト
+ * @param [out] it  初期化する走査子
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   走査位置は走査子に保持されるので、複数のスレッドがそれぞれの走査子で同
+ *   時に走査を行うことができる。走査子は返したキーの複製を保持するので、走
+ *   査の終了後はchmap_iter_release()で開放すること(初期化済みの走査子を再
+ *   度初期化する場合も、先に開放を行うこと)。
+ */
+extern int chmap_iter_init(chmap_t* ptr, chmap_iter_t* it);
+
+/*
+ * @fn
+ *   int chmap_iter_next(chmap_iter_t* it, void** dsk, size_t* dsz, void** dsv);
+ *
+ * @brief  登録済みエントリの走査
+ *
+ * @param [in] it  走査子
+ * @param [out] dsk  キーの書き込み先(NULL可)
+ * @param [out] dsz  キーのサイズの書き込み先(NULL可)
+ * @param [out] dsv  値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval CHMAP_ERROR_NOT_FOUND
+ *   走査が終端に達した場合に返す。
+ *
+ * @retval CHMAP_ERROR_NO_MEMORY
+ *   キーの複製領域の確保に失敗した場合に返す。走査位置は進めないので、再度
+ *   呼び出すことで同じエントリから走査を再開できる。
+ *
+ * @remark
+ *   ロックは一回の呼び出しの間のみ保持する。走査中に他スレッドによる更新が
+ *   行われた場合、その間に追加・削除・移動されたエントリは返されないか重複
+ *   して返される可能性がある。
+ *
+ * @remark
+ *   キーはロックを保持している間に走査子内の領域へ複製され(NUL終端を付加
+ *   する)、dskにはその複製のアドレスが返される。このため他スレッドがエン
+ *   トリを削除・移動しても返されたキーは影響を受けないが、アドレスは同じ
+ *   走査子で次にchmap_iter_next()を呼び出すか、chmap_iter_release()を呼び
+ *   出すまでの間のみ有効である。
+ */
+extern int chmap_iter_next(chmap_iter_t* it,
+                           void** dsk, size_t* dsz, void** dsv);
+
+/*
+ * @fn
+ *   int chmap_iter_release(chmap_iter_t* it);
+ *
+ * @brief  走査子の開放
+ *
+ * @param [in] it  開放する走査子
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   走査子が保持するキーの複製領域を開放する。開放後の走査子は
+ *   chmap_iter_init()で再度初期化するまで使用できない。
+ */
+extern int chmap_iter_release(chmap_iter_t* it);
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+#endif /* !defined(__CONCURRENT_HASH_MAP_H__) */
@@ -0,0 +1,650 @@
+﻿/*
+ * Bounded cache container (LRU on hash map)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hmap.h"
+#include "hcache.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define ALLOC(t)            ((t*)malloc(sizeof(t)))
+
+#define MIN_MAP_SIZE        16
+
+/*
+ * 構造体の定義
+ *
+ *  ハッシュマップにはキーに対してノードのアドレスを格納する。ノードは参照
+ *  順のリスト(先頭が最新)を構成し、追い出し時にハッシュマップから削除す
+ *  るためにキーの複製を持つ。
+ */
+struct node {
+  struct node* prev;
+  struct node* next;
+  void* val;
+  size_t cost;
+  size_t ksz;
+  char key[];
+};
+
+struct __hcache_t__ {
+  hmap_t* map;
+
+  struct node* head;  // 最も新しく参照されたエントリ
+  struct node* tail;  // 最も長く参照されていないエントリ
+
+  size_t max_entries;
+  size_t max_bytes;
+  size_t used;
+  size_t bytes;
+
+  void (*fn)(char*, void*);
+};
+
+/*
+ * 内部処理用の非公開関数の定義
+ */
+static void
+unlink_node(hcache_t* ptr, struct node* node)
+{
+  if (node->prev != NULL) {
+    node->prev->next = node->next;
+  } else {
+    ptr->head = node->next;
+  }
+
+  if (node->next != NULL) {
+    node->next->prev = node->prev;
+  } else {
+    ptr->tail = node->prev;
+  }
+
+  node->prev = NULL;
+  node->next = NULL;
+}
+
+static void
+push_front(hcache_t* ptr, struct node* node)
+{
+  node->prev = NULL;
+  node->next = ptr->head;
+
+  if (ptr->head != NULL) {
+    ptr->head->prev = node;
+  } else {
+    ptr->tail = node;
+  }
+
+  ptr->head = node;
+}
+
+static void
+touch(hcache_t* ptr, struct node* node)
+{
+  if (ptr->head != node) {
+    unlink_node(ptr, node);
+    push_front(ptr, node);
+  }
+}
+
+/**
+ * @fn
+ *  static void drop(hcache_t* ptr, struct node* node)
+ *
+ * @brief エントリの削除
+ *
+ * @remark
+ *   リスト及びハッシュマップからエントリを外し、コールバック呼び出しを行っ
+ *   てからノードを開放する。
+ */
+static void
+drop(hcache_t* ptr, struct node* node)
+{
+  unlink_node(ptr, node);
+  hmap_remove_bin(ptr->map, node->key, node->ksz);
+
+  ptr->used--;
+  ptr->bytes -= node->cost;
+
+  if (ptr->fn != NULL) ptr->fn(node->key, node->val);
+
+  free(node);
+}
+
+static int
+over_limit(hcache_t* ptr)
+{
+  return (ptr->max_entries > 0 && ptr->used > ptr->max_entries) ||
+         (ptr->max_bytes > 0 && ptr->bytes > ptr->max_bytes);
+}
+
+static int
+store_entry(hcache_t* ptr, void* key, size_t len, void* val, size_t cost)
+{
+  int ret;
+  int created;
+  void** slot;
+  struct node* node;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  node = NULL;
+
+  /*
+   * check cost
+   */
+  if (ptr->max_bytes > 0 && cost > ptr->max_bytes) {
+    ret = HCACHE_ERROR_OUT_OF_RANGE;
+  }
+
+  /*
+   * acquire entry
+   */
+  if (!ret) {
+    ret = hmap_upsert_bin(ptr->map, key, len, &slot, &created);
+    if (ret) ret = HCACHE_ERROR_NO_MEMORY;
+  }
+
+  if (!ret) {
+    if (created) {
+      node = (struct node*)malloc(sizeof(struct node) + len + 1);
+
+      if (node != NULL) {
+        memcpy(node->key, key, len);
+        node->key[len] = '\0';
+        node->ksz      = len;
+        node->cost     = 0;
+
+        *slot = node;
+        push_front(ptr, node);
+        ptr->used++;
+
+      } else {
+        hmap_remove_bin(ptr->map, key, len);
+        ret = HCACHE_ERROR_NO_MEMORY;
+      }
+
+    } else {
+      node = (struct node*)*slot;
+
+      if (ptr->fn != NULL) ptr->fn(node->key, node->val);
+      touch(ptr, node);
+    }
+  }
+
+  /*
+   * update entry
+   */
+  if (!ret) {
+    ptr->bytes += cost - node->cost;
+    node->val   = val;
+    node->cost  = cost;
+  }
+
+  /*
+   * evict
+   *
+   *  保存したエントリは先頭にあるので、末尾からの追い出しで保存したエント
+   *  リ自身が追い出されることはない(コストの上限は保存前に確認済み)。
+   */
+  if (!ret) {
+    while (over_limit(ptr) && ptr->tail != node) drop(ptr, ptr->tail);
+  }
+
+  return ret;
+}
+
+static int
+fetch_entry(hcache_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+  struct node* node;
+
+  ret = hmap_fetch_bin(ptr->map, key, len, (void**)&node);
+  if (ret) ret = HCACHE_ERROR_NOT_FOUND;
+
+  if (!ret) {
+    touch(ptr, node);
+    *dst = node->val;
+  }
+
+  return ret;
+}
+
+static int
+remove_entry(hcache_t* ptr, void* key, size_t len)
+{
+  int ret;
+  struct node* node;
+
+  ret = 0;
+
+  if (ptr->used == 0) ret = HCACHE_ERROR_EMPTY;
+
+  if (!ret) {
+    if (hmap_fetch_bin(ptr->map, key, len, (void**)&node)) {
+      ret = HCACHE_ERROR_NOT_FOUND;
+    }
+  }
+
+  if (!ret) drop(ptr, node);
+
+  return ret;
+}
+
+/*
+ * 外部公開関数の定義
+ */
+
+int
+hcache_new(size_t entries, size_t bytes, hcache_t** dst)
+{
+  int ret;
+  hcache_t* obj;
+  size_t size;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  obj  = NULL;
+  size = MIN_MAP_SIZE;
+
+  /*
+   * argument check
+   */
+  do {
+    if (entries == 0 && bytes == 0) {
+      ret = HCACHE_ERROR_OUT_OF_RANGE;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   *
+   *  エントリ数の上限が指定されている場合は、上限まで拡張が発生しないサイ
+   *  ズでハッシュマップを確保する。
+   */
+  if (!ret) do {
+    obj = ALLOC(hcache_t);
+    if (obj == NULL) {
+      ret = HCACHE_ERROR_NO_MEMORY;
+      break;
+    }
+
+    while (entries > 0 && size * 3 / 4 < entries) size <<= 1;
+
+    if (hmap_new2(size, HMAP_FLAG_GROWABLE|HMAP_FLAG_BACKSHIFT, &obj->map)) {
+      ret = HCACHE_ERROR_NO_MEMORY;
+      break;
+    }
+  } while (0);
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->head        = NULL;
+    obj->tail        = NULL;
+    obj->max_entries = entries;
+    obj->max_bytes   = bytes;
+    obj->used        = 0;
+    obj->bytes       = 0;
+    obj->fn          = NULL;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+hcache_destroy(hcache_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HCACHE_ERROR_NULL_POINTER;
+
+  /*
+   * clear cache
+   */
+  if (!ret) ret = hcache_clear(ptr);
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    hmap_destroy(ptr->map);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+hcache_store(hcache_t* ptr, char* key, void* val, size_t cost)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, strlen(key), val, cost);
+
+  return ret;
+}
+
+int
+hcache_store_bin(hcache_t* ptr, void* key, size_t len, void* val, size_t cost)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, len, val, cost);
+
+  return ret;
+}
+
+int
+hcache_fetch(hcache_t* ptr, char* key, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, strlen(key), dst);
+
+  return ret;
+}
+
+int
+hcache_fetch_bin(hcache_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, len, dst);
+
+  return ret;
+}
+
+int
+hcache_remove(hcache_t* ptr, char* key)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, strlen(key));
+
+  return ret;
+}
+
+int
+hcache_remove_bin(hcache_t* ptr, void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HCACHE_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, len);
+
+  return ret;
+}
+
+int
+hcache_clear(hcache_t* ptr)
+{
+  int ret;
+  struct node* node;
+  struct node* next;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HCACHE_ERROR_NULL_POINTER;
+
+  /*
+   * clear entries
+   */
+  if (!ret) {
+    for (node = ptr->head; node != NULL; node = next) {
+      next = node->next;
+
+      if (ptr->fn != NULL) ptr->fn(node->key, node->val);
+      free(node);
+    }
+
+    hmap_clear(ptr->map);
+
+    ptr->head  = NULL;
+    ptr->tail  = NULL;
+    ptr->used  = 0;
+    ptr->bytes = 0;
+  }
+
+  return ret;
+}
+
+int
+hcache_size(hcache_t* ptr, size_t* entries, size_t* bytes)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HCACHE_ERROR_NULL_POINTER;
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (entries != NULL) *entries = ptr->used;
+    if (bytes != NULL) *bytes = ptr->bytes;
+  }
+
+  return ret;
+}
+
+int
+hcache_set_callback(hcache_t* ptr, void (*fn)(char*, void*))
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HCACHE_ERROR_NULL_POINTER;
+
+  /*
+   * object update
+   */
+  if (!ret) ptr->fn = fn;
+
+  return ret;
+}
@@ -0,0 +1,232 @@
+﻿/*
+ * Bounded cache container (LRU on hash map)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __HASH_CACHE_H__
+#define __HASH_CACHE_H__
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct __hcache_t__ hcache_t;
+
+#define HCACHE_ERROR_OUT_OF_RANGE   (-1)
+#define HCACHE_ERROR_NULL_POINTER   (-3)
+#define HCACHE_ERROR_NO_MEMORY      (-4)
+#define HCACHE_ERROR_EMPTY          (-6)
+#define HCACHE_ERROR_NOT_FOUND      (-7)
+
+/*
+ * @fn
+ *   int hcache_new(size_t entries, size_t bytes, hcache_t** dst);
+ *
+ * @brief  キャッシュオブジェクトの生成
+ *
+ * @param [in] entries  保持するエントリ数の上限(0の場合は制限なし)
+ * @param [in] bytes  保持するエントリのコストの合計の上限(0の場合は制限なし)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HCACHE_ERROR_OUT_OF_RANGE
+ *   entries及びbytesの両方に0を指定した場合に返す。
+ *
+ * @retval HCACHE_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HCACHE_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @remark
+ *   本オブジェクトは拡張可能なhmap_tと、エントリを最近参照した順に並べた
+ *   双方向リストで構成される。上限を超える保存が行われた時点で、最も長く
+ *   参照されていないエントリから順に追い出す(LRU)。追い出しはリストの末
+ *   尾から行うので、一回あたりO(1)で完了する。
+ *
+ * @remark
+ *   コストはhcache_store()でエントリ毎に指定する任意の値(画像のバイト数等)
+ *   で、bytesを0以外とした場合にその合計が上限を超えないように追い出しが行
+ *   われる。
+ */
+extern int hcache_new(size_t entries, size_t bytes, hcache_t** dst);
+
+/*
+ * @fn
+ *   int hcache_destroy(hcache_t* ptr);
+ *
+ * @brief  キャッシュオブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象のオブジェクト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   コールバック関数が登録済みの場合、残っているエントリについてコールバッ
+ *   ク呼び出しを行う。
+ */
+extern int hcache_destroy(hcache_t* ptr);
+
+/*
+ * @fn
+ *   int hcache_store(hcache_t* ptr, char* key, void* value, size_t cost);
+ *
+ * @brief  キャッシュへの保存
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  データのキー(NUL終端文字列)
+ * @param [in] value  データの値(任意のオブジェクトのポインタ, NULL可)
+ * @param [in] cost  エントリのコスト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HCACHE_ERROR_OUT_OF_RANGE
+ *   コストの上限が設定されていて、costがそれを超える場合に返す(保存は行わ
+ *   れない)。
+ *
+ * @retval HCACHE_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HCACHE_ERROR_NO_MEMORY
+ *   メモリ確保に失敗した場合に返す。
+ *
+ * @remark
+ *   保存したエントリは最も新しく参照されたエントリとなる。キーがすでに保
+ *   存済みの場合は値とコストの上書きを行う(上書き前の値についてコールバッ
+ *   ク呼び出しが行われる)。保存後に上限を超えている場合は、保存したエン
+ *   トリ以外のエントリを古いものから順に追い出す。
+ */
+extern int hcache_store(hcache_t* ptr, char* key, void* value, size_t cost);
+
+/*
+ * @fn
+ *   int hcache_store_bin(hcache_t* ptr,
+ *                        void* key, size_t len, void* value, size_t cost);
+ *
+ * @brief  キャッシュへの保存(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はhcache_store()と同じ。
+ */
+extern int hcache_store_bin(hcache_t* ptr,
+                            void* key, size_t len, void* value, size_t cost);
+
+/*
+ * @fn
+ *   int hcache_fetch(hcache_t* ptr, char* key, void** dst);
+ *
+ * @brief  キャッシュの読み出し
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  読み出し対象のキー
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HCACHE_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HCACHE_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった(追い出し済みの場合を含む)場合
+ *   に返す。
+ *
+ * @remark
+ *   読み出したエントリは最も新しく参照されたエントリとなる。
+ */
+extern int hcache_fetch(hcache_t* ptr, char* key, void** dst);
+
+/*
+ * @fn
+ *   int hcache_fetch_bin(hcache_t* ptr, void* key, size_t len, void** dst);
+ *
+ * @brief  キャッシュの読み出し(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はhcache_fetch()と同じ。
+ */
+extern int hcache_fetch_bin(hcache_t* ptr, void* key, size_t len, void** dst);
+
+/*
+ * @fn
+ *   int hcache_remove(hcache_t* ptr, char* key);
+ *
+ * @brief  キャッシュからの削除
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  削除対象のキー
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HCACHE_ERROR_EMPTY
+ *   空のオブジェクトに対して呼び出した場合に返す。
+ *
+ * @retval HCACHE_ERROR_NOT_FOUND
+ *   キーに対応するエントリが見つからなかった場合に返す。
+ *
+ * @remark
+ *   コールバック関数の登録が行われていればコールバック呼び出しが行われる。
+ */
+extern int hcache_remove(hcache_t* ptr, char* key);
+
+/*
+ * @fn
+ *   int hcache_remove_bin(hcache_t* ptr, void* key, size_t len);
+ *
+ * @brief  キャッシュからの削除(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はhcache_remove()と同じ。
+ */
+extern int hcache_remove_bin(hcache_t* ptr, void* key, size_t len);
+
+/*
+ * @fn
+ *   int hcache_clear(hcache_t* ptr);
+ *
+ * @brief  キャッシュのクリア
+ *
+ * @remark
+ *   コールバック関数の登録が行われていれば、削除する各エントリについてコー
+ *   ルバック呼び出しが行われる。
+ */
+extern int hcache_clear(hcache_t* ptr);
+
+/*
+ * @fn
+ *   int hcache_size(hcache_t* ptr, size_t* entries, size_t* bytes);
+ *
+ * @brief  保持しているエントリ数及びコストの合計の取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [out] entries  エントリ数の書き込み先(NULL可)
+ * @param [out] bytes  コストの合計の書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ */
+extern int hcache_size(hcache_t* ptr, size_t* entries, size_t* bytes);
+
+/*
+ * @fn
+ *   int hcache_set_callback(hcache_t* ptr, void(*fn)(char*, void*));
+ *
+ * @brief  コールバック関数の登録
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] fn  コールバック関数
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   hmap_set_callback()と同様に、エントリがキャッシュから外れる時(上書き、
+ *   削除、クリア、破棄、及び上限超過による追い出し)に呼び出される。値の開
+ *   放はコールバック関数で行うこと。
+ */
+extern int hcache_set_callback(hcache_t* ptr, void(*fn)(char*, void*));
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+#endif /* !defined(__HASH_CACHE_H__) */
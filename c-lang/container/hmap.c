@@ -8,6 +8,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+#include <time.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif /* defined(__AVX2__) || defined(__SSE2__) */
 
 #include "hmap.h"
 
@@ -19,6 +29,79 @@
 #define ST_USED             1
 #define ST_REMOVED          2
 
+#define DEFAULT_MAX_LOAD    0.75
+#define MIN_MAX_LOAD        0.25
+#define REHASH_STEP         8
+
+#define VALID_FLAGS         (HMAP_FLAG_GROWABLE|\
+                             HMAP_FLAG_GROUP_PROBE|\
+                             HMAP_FLAG_ARENA_KEY|\
+                             HMAP_FLAG_BACKSHIFT|\
+                             HMAP_FLAG_STABLE_FETCH|\
+                             HMAP_FLAG_EXTERN_KEY)
+#define IS_GROWABLE(ptr)    ((ptr)->flags & HMAP_FLAG_GROWABLE)
+#define IS_ARENA(ptr)       ((ptr)->flags & HMAP_FLAG_ARENA_KEY)
+#define IS_EXTERN(ptr)      ((ptr)->flags & HMAP_FLAG_EXTERN_KEY)
+#define OWNS_KEY(ptr)       (!((ptr)->flags & (HMAP_FLAG_ARENA_KEY|\
+                                               HMAP_FLAG_EXTERN_KEY)))
+#define IS_BACKSHIFT(ptr)   ((ptr)->flags & HMAP_FLAG_BACKSHIFT)
+#define IS_STABLE(ptr)      ((ptr)->flags & HMAP_FLAG_STABLE_FETCH)
+
+#define DIST(tbl,a,b)       (((b) - (a)) & (tbl)->mask)
+#define HASH(ptr,k,n)       ((ptr)->hfn((k), (n), (ptr)->seed))
+#define IS_REHASHING(ptr)   ((ptr)->old.bucket != NULL)
+
+/*
+ * コントロールバイト(HMAP_FLAG_GROUP_PROBE指定時のみ使用)
+ *
+ *  使用中のバケットにはハッシュ値を撹拌した値の最上位7bit(H2)を格納し、空
+ *  き及び削除済みのバケットには最上位bitが立った値を格納する。
+ *
+ *  FNV1では末尾のバイトが下位bitにしか影響しないため、ハッシュ値の上位bit
+ *  をそのまま使うと末尾だけが異なるキー同士でH2が一致し、キーの比較が無駄
+ *  に増える。このためH2は撹拌(mix())後の値から取り出す。
+ */
+#define CTRL_EMPTY          0x80
+#define CTRL_REMOVED        0xfe
+#define H2(hv)              ((uint8_t)(mix(hv) >> 57))
+
+#if defined(__AVX2__)
+#define GROUP_WIDTH         32
+#else /* defined(__AVX2__) */
+#define GROUP_WIDTH         16
+#endif /* defined(__AVX2__) */
+
+#define CTZ(x)              __builtin_ctz(x)
+
+/*
+ * 一括処理(hmap_fetch_many()/hmap_store_many())の単位
+ */
+#define BATCH_SIZE          16
+
+#ifdef __GNUC__
+#define PREFETCH(p)         __builtin_prefetch(p)
+#else /* defined(__GNUC__) */
+#define PREFETCH(p)
+#endif /* defined(__GNUC__) */
+
+/*
+ * キー格納領域(HMAP_FLAG_ARENA_KEY指定時のみ使用)
+ *
+ *  INLINE_KEY_SIZE未満のキー(NUL終端を含めてINLINE_KEY_SIZEバイト以内)は
+ *  バケットと同じ並びのインラインキー配列(struct tableのinl)に直接格納し、
+ *  それ以上のキーはアリーナ(チャンク単位で確保するバンプポインタ方式の領
+ *  域)に格納する。インラインキー配列はHMAP_FLAG_ARENA_KEY指定時のみ確保す
+ *  るので、指定しないハッシュマップのバケットの大きさは変わらない。
+ */
+#define INLINE_KEY_SIZE     16
+#define ARENA_CHUNK_SIZE    (64 * 1024)
+
+#define IS_INLINE(tbl,n)    (((tbl)->flags & HMAP_FLAG_ARENA_KEY) &&\
+                             ((n) < INLINE_KEY_SIZE))
+#define INL(tbl,b)          ((tbl)->inl[(b) - (tbl)->bucket])
+#define KEY(tbl,b)          (IS_INLINE(tbl, (b)->ksz)? \
+                             INL(tbl, b): (char*)(b)->key)
+
 /*
  * 構造体の定義
  */
@@ -27,37 +110,104 @@ struct key {
   size_t size;
 };
 
+typedef char inline_key_t[INLINE_KEY_SIZE];
+
 struct bucket {
   int state;
+  uint64_t hash;
   void* key;
   size_t ksz;
   void* val;
 };
 
-struct __hmap_t__ {
+struct chunk {
+  struct chunk* next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+struct table {
+  int flags;
   struct bucket* bucket;
+  uint8_t* ctrl;      // コントロールバイト配列(不使用時はNULL)
+  inline_key_t* inl;  // インラインキー配列(不使用時はNULL)
   size_t size;
   size_t mask;
   size_t used;
+  size_t removed;     // ST_REMOVEDのバケットの数
+};
+
+struct __hmap_t__ {
+  int flags;
+  double max_load;
+
+  struct table tbl;   // 現行テーブル(リハッシュ中は移行先のテーブル)
+  struct table old;   // リハッシュ中の移行元テーブル(非リハッシュ時は空)
+  size_t ridx;        // 移行元テーブルで次に移行を行うバケットの位置
 
-  struct bucket* pos;
+  size_t used;
+  size_t pos;
+
+  struct chunk* arena;
+
+  hmap_hash_t hfn;    // ハッシュ関数
+  uint64_t seed;      // ハッシュ関数に渡すシード値
 
   void (*fn)(char*, void*);
 };
 
+/*
+ * スナップショット(hmap_freeze()で書き出すファイル)の形式
+ *
+ *  ファイルはヘッダ、バケット配列、キー及び値の実体の順に並ぶ。参照は全
+ *  てファイル先頭からのオフセットで行う。オフセット0はヘッダを指すので、
+ *  キーのオフセットが0のバケットは空きバケットを表す。
+ */
+#define FROZEN_MAGIC        "HMAPFRZ1"
+#define FROZEN_ORDER        0x01020304
+#define FROZEN_ALIGN        8
+#define FROZEN_MIN_SIZE     16
+#define ALIGN_UP(n,a)       (((n) + ((a) - 1)) & ~((uint64_t)(a) - 1))
+
+struct frozen_header {
+  char magic[8];
+  uint32_t order;     // バイトオーダーの確認用(FROZEN_ORDER)
+  uint32_t reserved;
+  uint64_t size;      // バケットの数(二の冪乗)
+  uint64_t used;      // エントリの数
+  uint64_t length;    // ファイル全体のサイズ
+};
+
+struct frozen_bucket {
+  uint64_t hash;
+  uint64_t koff;
+  uint64_t ksz;
+  uint64_t voff;      // 値がNULLの場合は0
+  uint64_t vsz;
+};
+
+struct __hmap_frozen_t__ {
+  void* addr;
+  size_t length;
+  struct frozen_bucket* bucket;
+  uint64_t mask;
+  uint64_t used;
+};
+
 /*
  * 内部処理用の非公開関数の定義
  */
-// implement by FNV1-32
-static uint32_t
+// implement by FNV1 (c-lang/hash/fnv1.cのfnv164()と同じ値を返す)
+static uint64_t
 hash(uint8_t* data, size_t size)
 {
-  uint32_t ret;
-  int i;
+  uint64_t ret;
+  size_t i;
 
-  ret = 0x811c9dc5;
+  ret = 0xcbf29ce484222325ULL;
 
-  for (i = 0; i < (int)size; i++) {
+  for (i = 0; i < size; i++) {
     ret *= 0x01000193;
 		/* 
      * 上記の乗算は以下の処理と同じ
@@ -74,17 +224,352 @@ hash(uint8_t* data, size_t size)
   return ret;
 }
 
+/*
+ * wyhash(final4)の実装
+ *
+ *  8バイト単位(48バイト以上は3系統並行)で64x64→128bitの乗算による撹拌を
+ *  行う。ハッシュ値はバイトオーダーに依存する(ファイル等に保存する用途に
+ *  は使用しないこと)。
+ */
+static const uint64_t wyp[4] = {
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+  0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+static inline void
+wymum(uint64_t* a, uint64_t* b)
+{
+  __uint128_t r;
+
+  r  = *a;
+  r *= *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t
+wymix(uint64_t a, uint64_t b)
+{
+  wymum(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t
+wyr8(const uint8_t* p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t
+wyr4(const uint8_t* p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t
+wyr3(const uint8_t* p, size_t k)
+{
+  return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static uint64_t
+wyhash(const uint8_t* p, size_t len, uint64_t seed)
+{
+  uint64_t a;
+  uint64_t b;
+  uint64_t s1;
+  uint64_t s2;
+  size_t i;
+
+  seed ^= wymix(seed ^ wyp[0], wyp[1]);
+
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+      b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = wyr3(p, len);
+      b = 0;
+    } else {
+      a = 0;
+      b = 0;
+    }
+
+  } else {
+    i = len;
+
+    if (i > 48) {
+      s1 = seed;
+      s2 = seed;
+
+      do {
+        seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+        s1   = wymix(wyr8(p + 16) ^ wyp[2], wyr8(p + 24) ^ s1);
+        s2   = wymix(wyr8(p + 32) ^ wyp[3], wyr8(p + 40) ^ s2);
+        p   += 48;
+        i   -= 48;
+      } while (i > 48);
+
+      seed ^= s1 ^ s2;
+    }
+
+    while (i > 16) {
+      seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+      p   += 16;
+      i   -= 16;
+    }
+
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
+
+  a ^= wyp[1];
+  b ^= seed;
+  wymum(&a, &b);
+
+  return wymix(a ^ wyp[0] ^ len, b ^ wyp[1]);
+}
+
+/**
+ * @fn
+ *  static uint64_t make_seed(void* obj)
+ *
+ * @brief ハッシュマップ毎のシード値の生成
+ *
+ * @remark
+ *   getrandom()で取得できない場合は、時刻及びオブジェクトのアドレスから生
+ *   成する(外部からの推測は困難ではなくなるが、動作には支障はない)。
+ */
+static uint64_t
+make_seed(void* obj)
+{
+  uint64_t ret;
+  struct timespec ts;
+
+  if (getrandom(&ret, sizeof(ret), GRND_NONBLOCK) != sizeof(ret)) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    ret = wymix((uint64_t)ts.tv_sec ^ wyp[2], (uint64_t)ts.tv_nsec ^ wyp[3]);
+    ret = wymix(ret ^ (uint64_t)(uintptr_t)obj, wyp[0]);
+  }
+
+  return ret;
+}
+
+/*
+ * H2算出用の撹拌処理(MurmurHash3のfmix64)
+ */
+static inline uint64_t
+mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+/*
+ * コントロールバイトのグループ比較
+ *
+ *  いずれもGROUP_WIDTH個のコントロールバイトを一度に比較し、条件に一致した
+ *  位置のbitを立てたマスクを返す。
+ */
+#if defined(__AVX2__)
+static inline uint32_t
+group_match(const uint8_t* p, uint8_t c)
+{
+  __m256i g;
+
+  g = _mm256_loadu_si256((const __m256i*)p);
+  return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g,
+                                                 _mm256_set1_epi8((char)c)));
+}
+
+static inline uint32_t
+group_match_free(const uint8_t* p)
+{
+  // 空き及び削除済みは最上位bitが立っているので符号bitの抽出のみで判定可
+  return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)p));
+}
+
+#elif defined(__SSE2__)
+static inline uint32_t
+group_match(const uint8_t* p, uint8_t c)
+{
+  __m128i g;
+
+  g = _mm_loadu_si128((const __m128i*)p);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+}
+
+static inline uint32_t
+group_match_free(const uint8_t* p)
+{
+  // 空き及び削除済みは最上位bitが立っているので符号bitの抽出のみで判定可
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p));
+}
+
+#else /* defined(__SSE2__) */
+static inline uint32_t
+group_match(const uint8_t* p, uint8_t c)
+{
+  uint32_t ret;
+  int i;
+
+  ret = 0;
+  for (i = 0; i < GROUP_WIDTH; i++) if (p[i] == c) ret |= (1 << i);
+
+  return ret;
+}
+
+static inline uint32_t
+group_match_free(const uint8_t* p)
+{
+  uint32_t ret;
+  int i;
+
+  ret = 0;
+  for (i = 0; i < GROUP_WIDTH; i++) if (p[i] & 0x80) ret |= (1 << i);
+
+  return ret;
+}
+#endif /* defined(__AVX2__) */
+
+static inline uint32_t
+group_limit(struct table* tbl, size_t n)
+{
+  // テーブルサイズがグループ幅より小さい場合は、周回分のbitを落とす
+  return ((tbl->size - n) < GROUP_WIDTH)?
+         (uint32_t)((1 << (tbl->size - n)) - 1): (uint32_t)~0;
+}
+
+/**
+ * @fn
+ *  static void search_group(struct table* tbl,
+ *                           void* key, 
+ *                           size_t size, 
+ *                           uint64_t hv,
+ *                           struct bucket** dst)
+ *
+ * @brief コントロールバイトを用いたバケットの探査
+ *
+ * @remark
+ *  探査順序及び結果はsearch_bucket()と同じ。コントロールバイトをGROUP_WIDTH
+ *  個ずつSIMD命令で比較し、H2が一致したバケットについてのみキーの比較を行
+ *  うので、キーが一致しないバケットのキー領域にはアクセスしない。
+ */
+static void
+search_group(struct table* tbl,
+             void* key, size_t size, uint64_t hv, struct bucket** dst)
+{
+  size_t pos;
+  size_t n;
+  uint32_t lim;
+  uint32_t match;
+  uint32_t empty;
+  uint32_t avail;
+  uint8_t h2;
+  struct bucket* pc;
+  struct bucket* pt;
+
+  /*
+   * initialize
+   */
+  pos = hv & tbl->mask;
+  h2  = H2(hv);
+  pt  = NULL;
+
+  /*
+   * search bucket
+   */
+  for (n = 0; n < tbl->size; n += GROUP_WIDTH) {
+    lim   = group_limit(tbl, n);
+    match = group_match(tbl->ctrl + pos, h2) & lim;
+    empty = group_match(tbl->ctrl + pos, CTRL_EMPTY) & lim;
+
+    // 最初のST_EMPTYより後ろのバケットは探査対象外
+    if (empty) match &= (empty ^ (empty - 1));
+
+    while (match) {
+      pc = tbl->bucket + ((pos + CTZ(match)) & tbl->mask);
+
+      if (pc->hash == hv && pc->ksz == size && !memcmp(KEY(tbl, pc), key, size)) {
+        *dst = pc;
+        return;
+      }
+
+      match &= match - 1;
+    }
+
+    // 最初の空き(削除済みを含む)のバケットを記録
+    if (pt == NULL) {
+      avail = group_match_free(tbl->ctrl + pos) & lim;
+      if (avail) pt = tbl->bucket + ((pos + CTZ(avail)) & tbl->mask);
+    }
+
+    if (empty) break;
+
+    pos = (pos + GROUP_WIDTH) & tbl->mask;
+  }
+
+  *dst = pt;
+}
+
+static void
+set_state(struct table* tbl, struct bucket* item, int state, uint64_t hv)
+{
+  size_t i;
+  uint8_t c;
+
+  if (item->state == ST_REMOVED) tbl->removed--;
+  if (state == ST_REMOVED) tbl->removed++;
+
+  item->state = state;
+
+  if (tbl->ctrl != NULL) {
+    switch (state) {
+    case ST_USED:
+      c = H2(hv);
+      break;
+
+    case ST_REMOVED:
+      c = CTRL_REMOVED;
+      break;
+
+    default:
+      c = CTRL_EMPTY;
+      break;
+    }
+
+    // 末尾のGROUP_WIDTHバイトは先頭の複製(周回をまたぐグループ読み出し用)
+    for (i = item - tbl->bucket; i < tbl->size + GROUP_WIDTH; i += tbl->size) {
+      tbl->ctrl[i] = c;
+    }
+  }
+}
+
 /**
  * @fn
- *  static void search_bucket(hmap_t* ptr,
+ *  static void search_bucket(struct table* tbl,
  *                            void* key, 
  *                            size_t size, 
+ *                            uint64_t hv,
  *                            struct bucket** dst)
  *
  * @brief バケットの探査
- * @param [in] ptr  探査対象のハッシュマップオブジェクト
+ * @param [in] tbl  探査対象のテーブル
  * @param [in] key  探査キーのアドレス
  * @param [in] size  探査キーのサイズ
+ * @param [in] hv  探査キーのハッシュ値
  * @param [out] dst  見つかったバケットの出力先
  *
  * @remark
@@ -99,16 +584,25 @@ hash(uint8_t* data, size_t size)
  *    キーに一致するバケットが見つからず新規割り当てされたバケット
  */
 static void
-search_bucket(hmap_t* ptr, void* key, size_t size, struct bucket** dst)
+search_bucket(struct table* tbl,
+              void* key, size_t size, uint64_t hv, struct bucket** dst)
 {
   struct bucket* p0; // 探査開始位置
   struct bucket* pc; // 現探査位置
   struct bucket* pt; // 対象バケット
 
+  /*
+   * dispatch
+   */
+  if (tbl->ctrl != NULL) {
+    search_group(tbl, key, size, hv, dst);
+    return;
+  }
+
   /*
    * initialize
    */
-  p0 = ptr->bucket + (hash(key, size) & ptr->mask);
+  p0 = tbl->bucket + (hv & tbl->mask);
   pc = p0;
   pt = NULL;
 
@@ -117,7 +611,7 @@ search_bucket(hmap_t* ptr, void* key, size_t size, struct bucket** dst)
    */
   do {
     if (pc->state == ST_USED) {
-      if (pc->ksz == size && !memcmp(pc->key, key, size)) {
+      if (pc->hash == hv && pc->ksz == size && !memcmp(KEY(tbl, pc), key, size)) {
         // 使用中且つキーが一致する場合はそのバケットで確定
         pt = pc;
         break;
@@ -132,7 +626,7 @@ search_bucket(hmap_t* ptr, void* key, size_t size, struct bucket** dst)
     }
 
     // 探査位置を次に進める。領域末端まで到達したら終端に巻き戻し
-    if ((++pc - ptr->bucket) >= ptr->size) pc = ptr->bucket;
+    if ((++pc - tbl->bucket) >= tbl->size) pc = tbl->bucket;
   } while (pc != p0);
 
   /*
@@ -143,97 +637,1927 @@ search_bucket(hmap_t* ptr, void* key, size_t size, struct bucket** dst)
   *dst = pt;
 }
 
-/*
- * 外部公開関数の定義
+/**
+ * @fn
+ *  static void lookup(hmap_t* ptr,
+ *                     void* key,
+ *                     size_t size,
+ *                     uint64_t hv,
+ *                     struct table** dtb,
+ *                     struct bucket** dst)
+ *
+ * @brief キーに対応するバケットの探査(リハッシュ中の移行元テーブルを含む)
+ *
+ * @param [in] ptr  探査対象のハッシュマップオブジェクト
+ * @param [in] key  探査キーのアドレス
+ * @param [in] size  探査キーのサイズ
+ * @param [in] hv  探査キーのハッシュ値
+ * @param [out] dtb  見つかったバケットが属するテーブルの出力先
+ * @param [out] dst  見つかったバケットの出力先
+ *
+ * @remark
+ *  移行元テーブルでキーが見つかった場合は、そのバケットを返す。それ以外は
+ *  現行テーブルに対するsearch_bucket()の結果を返す(新規割り当ては常に現行
+ *  テーブル側で行う)。
  */
-
-int
-hmap_new(size_t size, hmap_t** dst)
+static void
+lookup(hmap_t* ptr, void* key, size_t size, uint64_t hv,
+       struct table** dtb, struct bucket** dst)
 {
-  int ret;
-  hmap_t* obj;
-  struct bucket* bucket;
+  struct bucket* item;
 
-  /*
-   * initialize
-   */
-  ret    = 0;
-  obj    = NULL;
-  bucket = NULL;
+  item = NULL;
 
-  /*
-   * argument check
-   */
-  do {
-    if (size < 16) {
-      ret = HMAP_ERROR_OUT_OF_RANGE;
-      break;
-    }
+  if (IS_REHASHING(ptr)) {
+    search_bucket(&ptr->old, key, size, hv, &item);
 
-    // 二の冪乗チェック
-    if ((size & (size -1)) != 0) {
-      ret = HMAP_ERROR_CONSTRAINT;
-      break;
+    if (item != NULL && item->state == ST_USED) {
+      *dtb = &ptr->old;
+      *dst = item;
+      return;
     }
+  }
 
-    if (dst == NULL) {
-      ret = HMAP_ERROR_NULL_POINTER;
-      break;
-    }
-  } while (0);
+  search_bucket(&ptr->tbl, key, size, hv, &item);
 
-  /*
-   * memory allocate
-   */
-  if (!ret) do {
-    obj = ALLOC(hmap_t);
-    if (obj == NULL) {
-      ret = HMAP_ERROR_NO_MEMORY;
-      break;
-    }
+  *dtb = &ptr->tbl;
+  *dst = item;
+}
 
-    bucket = NALLOC(struct bucket, size);
-    if (obj == NULL) {
-      ret = HMAP_ERROR_NO_MEMORY;
-      break;
-    }
-  } while (0);
+static size_t
+load_limit(hmap_t* ptr, struct table* tbl)
+{
+  return (size_t)((double)tbl->size * ptr->max_load);
+}
 
-  /*
-   * setup object
-   */
+static int
+table_init(struct table* tbl, size_t size, int flags)
+{
+  int ret;
+
+  ret         = 0;
+  tbl->flags  = flags;
+  tbl->bucket = NALLOC(struct bucket, size);
+  tbl->ctrl   = NULL;
+  tbl->inl    = NULL;
+
+  if (tbl->bucket == NULL) ret = HMAP_ERROR_NO_MEMORY;
+
+  if (!ret && (flags & HMAP_FLAG_GROUP_PROBE)) {
+    tbl->ctrl = NALLOC(uint8_t, size + GROUP_WIDTH);
+    if (tbl->ctrl == NULL) ret = HMAP_ERROR_NO_MEMORY;
+  }
+
+  if (!ret && (flags & HMAP_FLAG_ARENA_KEY)) {
+    tbl->inl = NALLOC(inline_key_t, size);
+    if (tbl->inl == NULL) ret = HMAP_ERROR_NO_MEMORY;
+  }
+
+  if (!ret) {
+    memset(tbl->bucket, 0, sizeof(struct bucket) * size);
+    if (tbl->ctrl != NULL) memset(tbl->ctrl, CTRL_EMPTY, size + GROUP_WIDTH);
+
+    tbl->size    = size;
+    tbl->mask    = size - 1;
+    tbl->used    = 0;
+    tbl->removed = 0;
+  }
+
+  if (ret) {
+    if (tbl->bucket != NULL) free(tbl->bucket);
+    if (tbl->ctrl != NULL) free(tbl->ctrl);
+    tbl->bucket = NULL;
+    tbl->ctrl   = NULL;
+  }
+
+  return ret;
+}
+
+static void
+table_release(struct table* tbl)
+{
+  if (tbl->bucket != NULL) free(tbl->bucket);
+  if (tbl->ctrl != NULL) free(tbl->ctrl);
+  if (tbl->inl != NULL) free(tbl->inl);
+
+  tbl->bucket  = NULL;
+  tbl->ctrl    = NULL;
+  tbl->inl     = NULL;
+  tbl->size    = 0;
+  tbl->mask    = 0;
+  tbl->used    = 0;
+  tbl->removed = 0;
+}
+
+/**
+ * @fn
+ *  static void rehash_step(hmap_t* ptr, size_t n)
+ *
+ * @brief 移行元テーブルから現行テーブルへのエントリ移行(インクリメンタル
+ *        リハッシュ)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] n  処理するバケットの数
+ *
+ * @remark
+ *  一回の呼び出しで処理するのは移行元テーブルのn個のバケットのみ(空きバケ
+ *  ットも1個として数える)なので、処理時間はテーブルのサイズに依存しない。
+ *  移行したバケットは、移行元テーブル上の他の探査リンクを維持するために
+ *  ST_REMOVEDとする。全てのバケットの移行が完了した時点で移行元テーブルを
+ *  開放する。
+ */
+static void
+rehash_step(hmap_t* ptr, size_t n)
+{
+  uint64_t hv;
+  struct bucket* src;
+  struct bucket* dst;
+
+  while (n-- > 0 && ptr->ridx < ptr->old.size) {
+    src = ptr->old.bucket + ptr->ridx++;
+
+    if (src->state == ST_USED) {
+      // 移行先には同じキーは存在しないので、最初の空きバケットに格納する
+      hv  = src->hash;
+      dst = ptr->tbl.bucket + (hv & ptr->tbl.mask);
+      while (dst->state == ST_USED) {
+        if ((++dst - ptr->tbl.bucket) >= ptr->tbl.size) dst = ptr->tbl.bucket;
+      }
+
+      set_state(&ptr->tbl, dst, ST_USED, hv);
+      set_state(&ptr->old, src, ST_REMOVED, 0);
+
+      dst->hash = src->hash;
+      dst->key  = src->key;
+      dst->ksz  = src->ksz;
+      dst->val  = src->val;
+      src->key  = NULL;
+      src->ksz  = 0;
+      src->val  = NULL;
+
+      if (IS_INLINE(&ptr->tbl, dst->ksz)) {
+        memcpy(INL(&ptr->tbl, dst), INL(&ptr->old, src), INLINE_KEY_SIZE);
+      }
+
+      ptr->old.used--;
+      ptr->tbl.used++;
+    }
+  }
+
+  if (ptr->ridx >= ptr->old.size) {
+    table_release(&ptr->old);
+    ptr->ridx = 0;
+  }
+}
+
+/**
+ * @fn
+ *  static int rebuild(hmap_t* ptr, size_t size)
+ *
+ * @brief テーブルの再構築(リハッシュの開始)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] size  新しいテーブルのサイズ
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *  指定サイズの新しいテーブルを確保し、現行テーブルを移行元テーブルとする。
+ *  エントリの移行はrehash_step()により少しずつ行う。移行が完了していない状
+ *  態で呼び出された場合は、残りの移行を完了させてから再構築を行う。現行テ
+ *  ーブルと同じサイズを指定した場合は、削除済みバケットの一掃となる。
+ */
+static int
+rebuild(hmap_t* ptr, size_t size)
+{
+  int ret;
+  struct table tbl;
+
+  ret = table_init(&tbl, size, ptr->flags);
+
+  if (!ret) {
+    if (IS_REHASHING(ptr)) rehash_step(ptr, ptr->old.size);
+
+    ptr->old  = ptr->tbl;
+    ptr->tbl  = tbl;
+    ptr->ridx = 0;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static void backshift(struct table* tbl, struct bucket* item)
+ *
+ * @brief 後方シフトによるバケットの削除
+ *
+ * @param [in] tbl  対象のテーブル
+ * @param [in] item  削除するバケット
+ *
+ * @remark
+ *  削除したバケットの後ろに続くエントリのうち、本来の位置(ハッシュ値から
+ *  決まる位置)から削除位置までの範囲に収まるものを前に詰める。これにより
+ *  ST_REMOVEDを残さずに探査リンクを維持でき、探査長は削除を繰り返しても伸
+ *  び続けることがない。
+ */
+static void
+backshift(struct table* tbl, struct bucket* item)
+{
+  size_t i;
+  size_t j;
+  struct bucket* pj;
+
+  i = item - tbl->bucket;
+  j = i;
+
+  while (1) {
+    j  = (j + 1) & tbl->mask;
+    pj = tbl->bucket + j;
+
+    // 空きバケットに到達するか一周した時点で終了
+    if (pj->state != ST_USED || j == i) break;
+
+    // jのエントリの探査開始位置からjまでの間にiが含まれていれば移動可能
+    if (DIST(tbl, pj->hash & tbl->mask, j) >= DIST(tbl, i, j)) {
+      set_state(tbl, tbl->bucket + i, ST_USED, pj->hash);
+
+      tbl->bucket[i].hash = pj->hash;
+      tbl->bucket[i].key  = pj->key;
+      tbl->bucket[i].ksz  = pj->ksz;
+      tbl->bucket[i].val  = pj->val;
+
+      if (IS_INLINE(tbl, pj->ksz)) {
+        memcpy(tbl->inl[i], tbl->inl[j], INLINE_KEY_SIZE);
+      }
+
+      i = j;
+    }
+  }
+
+  set_state(tbl, tbl->bucket + i, ST_EMPTY, 0);
+}
+
+static void
+remove_bucket(hmap_t* ptr, struct table* tbl, struct bucket* item)
+{
+  struct bucket* pt;
+
+  // コールバックを呼び出す
+  if (ptr->fn != NULL) ptr->fn(KEY(tbl, item), item->val);
+
+  // キーの情報を削除(アリーナに格納したキーはクリア時にまとめて開放)
+  if (OWNS_KEY(ptr)) free(item->key);
+
+  item->key = NULL;
+  item->ksz = 0;
+  item->val = NULL;
+
+  // バケットの状態を更新する
+  pt = item + 1;
+  if ((pt - tbl->bucket) >= tbl->size) pt = tbl->bucket;
+
+  if (IS_BACKSHIFT(ptr) && tbl == &ptr->tbl) {
+    // 後方シフト削除の場合(移行元テーブルは走査中なので対象外)
+    backshift(tbl, item);
+
+  } else if (pt->state != ST_EMPTY && tbl->used > 1) {
+    // 対象エントリの次のエントリがST_EMPTYでない場合は、探索リンクを
+    // 継続する必要があるのでST_REMOVEDに設定。
+    set_state(tbl, item, ST_REMOVED, 0);
+
+  } else {
+    // 対象リンクの次のエントリがST_EMPTYの場合、もしくはテーブル中の
+    // 最後の一個っだった場合は自身もST_EMPTYに設定。
+    set_state(tbl, item, ST_EMPTY, 0);
+
+    // さらに前方に向かって連続しているST_REMOVEDを全てST_EMPTYに設定。
+    for (pt = item - 1; pt != item; pt--) {
+      if (pt < tbl->bucket) pt += tbl->size;
+      if (pt->state != ST_REMOVED) break;
+
+      set_state(tbl, pt, ST_EMPTY, 0);
+    }
+  }
+
+  // サイズを減らす
+  tbl->used--;
+  ptr->used--;
+}
+
+static void
+clear_table(hmap_t* ptr, struct table* tbl)
+{
+  int i;
+  struct bucket* item;
+
+  // キーを個別に開放する必要もコールバックの必要もない場合は一括で初期化
+  if (!OWNS_KEY(ptr) && ptr->fn == NULL) {
+    memset(tbl->bucket, 0, sizeof(struct bucket) * tbl->size);
+    i = (int)tbl->size;
+  } else {
+    i = 0;
+  }
+
+  for (; i < (int)tbl->size; i++) {
+    item = tbl->bucket + i;
+
+    switch (item->state) {
+    case ST_EMPTY:
+      // ignore;
+      break;
+
+    case ST_USED:
+      if (ptr->fn != NULL) ptr->fn(KEY(tbl, item), item->val);
+
+      if (OWNS_KEY(ptr)) free(item->key);
+      item->state = ST_EMPTY;
+      item->key   = NULL;
+      item->ksz   = 0;
+      item->val   = NULL;
+      break;
+
+    case ST_REMOVED:
+      item->state = ST_EMPTY;
+      break;
+    }
+  }
+
+  if (tbl->ctrl != NULL) memset(tbl->ctrl, CTRL_EMPTY, tbl->size + GROUP_WIDTH);
+
+  tbl->used    = 0;
+  tbl->removed = 0;
+}
+
+/**
+ * @fn
+ *  static char* arena_alloc(hmap_t* ptr, size_t size)
+ *
+ * @brief アリーナからの領域の切り出し
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] size  切り出すサイズ
+ *
+ * @return 切り出した領域のアドレス(確保に失敗した場合はNULL)
+ *
+ * @remark
+ *  先頭のチャンクに空きがあればそこから切り出し、無ければ新しいチャンクを
+ *  確保する。チャンクサイズを超える要求は専用のチャンクを確保し、先頭チャ
+ *  ンクの残りを無駄にしないよう二番目に繋ぐ。
+ */
+static char*
+arena_alloc(hmap_t* ptr, size_t size)
+{
+  char* ret;
+  struct chunk* chunk;
+
+  ret   = NULL;
+  chunk = ptr->arena;
+
+  if (chunk == NULL || (chunk->size - chunk->used) < size) {
+    chunk = (struct chunk*)malloc(sizeof(struct chunk) +
+                                  ((size > ARENA_CHUNK_SIZE)?
+                                   size: ARENA_CHUNK_SIZE));
+
+    if (chunk != NULL) {
+      chunk->size = (size > ARENA_CHUNK_SIZE)? size: ARENA_CHUNK_SIZE;
+      chunk->used = 0;
+
+      if (size > ARENA_CHUNK_SIZE && ptr->arena != NULL) {
+        chunk->next      = ptr->arena->next;
+        ptr->arena->next = chunk;
+      } else {
+        chunk->next = ptr->arena;
+        ptr->arena  = chunk;
+      }
+    }
+  }
+
+  if (chunk != NULL) {
+    ret          = chunk->data + chunk->used;
+    chunk->used += size;
+  }
+
+  return ret;
+}
+
+static void
+arena_release(hmap_t* ptr)
+{
+  struct chunk* chunk;
+
+  while (ptr->arena != NULL) {
+    chunk      = ptr->arena;
+    ptr->arena = chunk->next;
+    free(chunk);
+  }
+}
+
+/**
+ * @fn
+ *  static int acquire_entry(hmap_t* ptr,
+ *                           void* key,
+ *                           size_t len,
+ *                           uint64_t hv,
+ *                           struct table** dtb,
+ *                           struct bucket** dst,
+ *                           int* created)
+ *
+ * @brief エントリの取得(存在しない場合は新規作成)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  キーのアドレス
+ * @param [in] len  キーのサイズ
+ * @param [in] hv  キーのハッシュ値
+ * @param [out] dtb  エントリが属するテーブルの書き込み先
+ * @param [out] dst  エントリのバケットの書き込み先
+ * @param [out] created  新規作成したか否かの書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *  新規作成したエントリの値はNULLとなる。hmap_store系関数及びhmap_upsert系
+ *  関数の共通処理。
+ */
+static int
+acquire_entry(hmap_t* ptr, void* _key, size_t len, uint64_t hv,
+              struct table** dtb, struct bucket** dst, int* created)
+{
+  int ret;
+  size_t lim;
+  char* key;
+  struct table* tbl;
+  struct bucket* item;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  key  = NULL;
+  tbl  = NULL;
+  item = NULL;
+
+  /*
+   * search bucket
+   */
+  if (IS_REHASHING(ptr)) rehash_step(ptr, REHASH_STEP);
+
+  lookup(ptr, _key, len, hv, &tbl, &item);
+
+  /*
+   * state check
+   *
+   *  新規割り当てとなる場合のみ、負荷率の上限を超えないかを確認する。拡張
+   *  可能なハッシュマップの場合は上限を超える場合にテーブルの拡張を行い、
+   *  拡張後のテーブルで割り当てバケットを探査し直す。削除済みバケットは探
+   *  査長を伸ばすので負荷率に含めて判定し、エントリ数自体が上限の半分以下
+   *  の場合は同じサイズで再構築して削除済みバケットを一掃する。エントリ数
+   *  が上限に近い状態で同じサイズの再構築を行うと、追加と削除を繰り返すだ
+   *  けで数回毎に再構築が発生するので、上限の半分を超えている場合は拡張を
+   *  行う。
+   *
+   *  リハッシュ中は移行元テーブルに残っているエントリも最終的には現行テー
+   *  ブルに移るので、エントリ数は両テーブルの合計(ptr->used)で判定する。
+   *  現行テーブルのみで判定すると、再構築時の移行の完了で現行テーブルが
+   *  溢れる場合がある。
+   */
+  if (item == NULL || item->state != ST_USED) {
+    lim = load_limit(ptr, tbl);
+
+    if (IS_GROWABLE(ptr)) {
+      if (ptr->used + tbl->removed + 1 > lim) {
+        if (!rebuild(ptr, tbl->size * ((ptr->used + 1 > lim / 2)? 2: 1))) {
+          lookup(ptr, _key, len, hv, &tbl, &item);
+
+        } else if (item == NULL) {
+          // 拡張できない場合でも空きが残っていればそのまま割り当てを行う
+          ret = HMAP_ERROR_NO_MEMORY;
+        }
+      }
+
+    } else {
+      if (tbl->used + 1 > lim) ret = HMAP_ERROR_FULL;
+    }
+
+    // 上段のstate checkで満杯チェックを行っているので
+    // ここには引っかからないはず
+    if (!ret && item == NULL) ret = HMAP_ERROR_FULL;
+  }
+
+  /*
+   * duplicate key
+   *
+   *  キーは常にNUL終端を付加した形で複製する(コールバック及びhmap_iter()で
+   *  はNUL終端文字列として渡すため)。インラインキー配列に格納するキーは、
+   *  割り当ての確定後に直接書き込む。HMAP_FLAG_EXTERN_KEY指定時は複製しない。
+   */
+  if (!ret) {
+    if (item->state != ST_USED && IS_EXTERN(ptr)) {
+      key = (char*)_key;
+
+    } else if (item->state != ST_USED && !IS_INLINE(tbl, len)) {
+      key = (IS_ARENA(ptr))? arena_alloc(ptr, len + 1): NALLOC(char, len + 1);
+      if (key != NULL) {
+        memcpy(key, _key, len);
+        key[len] = '\0';
+
+      } else {
+        ret = HMAP_ERROR_NO_MEMORY;
+      }
+    }
+  }
+
+  /*
+   * update object
+   */
+  if (!ret) {
+    if (item->state != ST_USED) {
+      // 新規割り当ての場合は状態及びキー情報を書き替え、使用数を加算
+      set_state(tbl, item, ST_USED, hv);
+      item->hash  = hv;
+      item->ksz   = len;
+
+      if (IS_INLINE(tbl, len)) {
+        memcpy(INL(tbl, item), _key, len);
+        INL(tbl, item)[len] = '\0';
+      } else {
+        item->key = key;
+      }
+
+      item->val = NULL;
+
+      tbl->used++;
+      ptr->used++;
+
+      *created = !0;
+
+    } else {
+      *created = 0;
+    }
+
+    *dtb = tbl;
+    *dst = item;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (key != NULL && OWNS_KEY(ptr)) free(key);
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int store_entry(hmap_t* ptr,
+ *                         void* key,
+ *                         size_t len,
+ *                         uint64_t hv,
+ *                         void* val)
+ *
+ * @brief エントリの保存(hmap_store系関数の共通処理)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  キーのアドレス
+ * @param [in] len  キーのサイズ
+ * @param [in] hv  キーのハッシュ値
+ * @param [in] val  保存する値
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ */
+static int
+store_entry(hmap_t* ptr, void* key, size_t len, uint64_t hv, void* val)
+{
+  int ret;
+  int created;
+  struct table* tbl;
+  struct bucket* item;
+
+  ret = acquire_entry(ptr, key, len, hv, &tbl, &item, &created);
+
+  if (!ret) {
+    // 使用中領域の場合(値の上書)の場合、コールバック呼び出し。
+    if (!created && ptr->fn != NULL) ptr->fn(KEY(tbl, item), item->val);
+
+    item->val = val;
+  }
+
+  return ret;
+}
+
+static int
+fetch_entry(hmap_t* ptr, void* key, size_t len, uint64_t hv, void** dst)
+{
+  int ret;
+  struct table* tbl;
+  struct bucket* item;
+
+  ret = 0;
+
+  if (IS_REHASHING(ptr) && !IS_STABLE(ptr)) rehash_step(ptr, REHASH_STEP);
+
+  lookup(ptr, key, len, hv, &tbl, &item);
+  if (item == NULL || item->state != ST_USED) ret = HMAP_ERROR_NOT_FOUND;
+
+  if (!ret) *dst = item->val;
+
+  return ret;
+}
+
+static int
+remove_entry(hmap_t* ptr, void* key, size_t len, uint64_t hv)
+{
+  int ret;
+  struct table* tbl;
+  struct bucket* item;
+
+  ret = 0;
+
+  if (ptr->used == 0) ret = HMAP_ERROR_EMPTY;
+
+  if (!ret) {
+    lookup(ptr, key, len, hv, &tbl, &item);
+    if (item == NULL || item->state != ST_USED) ret = HMAP_ERROR_NOT_FOUND;
+  }
+
+  if (!ret) remove_bucket(ptr, tbl, item);
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static void prefetch_batch(hmap_t* ptr,
+ *                             void* keys[],
+ *                             size_t lens[],
+ *                             size_t n,
+ *                             size_t dsz[],
+ *                             uint64_t dhv[])
+ *
+ * @brief 一括処理用のハッシュ値の算出とプリフェッチ
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] keys  キーの配列
+ * @param [in] lens  キーのサイズの配列(NULLの場合はNUL終端文字列として扱う)
+ * @param [in] n  キーの数(BATCH_SIZE以下)
+ * @param [out] dsz  キーのサイズの書き込み先
+ * @param [out] dhv  ハッシュ値の書き込み先
+ *
+ * @remark
+ *  先に全てのキーのハッシュ値を求めて探査開始位置のプリフェッチを発行して
+ *  おくことで、続く探査でのキャッシュミスの待ち時間を重ね合わせる。
+ */
+static void
+prefetch_batch(hmap_t* ptr, void* keys[], size_t lens[], size_t n,
+               size_t dsz[], uint64_t dhv[])
+{
+  size_t i;
+  size_t pos;
+
+  for (i = 0; i < n; i++) {
+    dsz[i] = (lens != NULL)? lens[i]: strlen(keys[i]);
+    dhv[i] = HASH(ptr, keys[i], dsz[i]);
+
+    pos = dhv[i] & ptr->tbl.mask;
+    if (ptr->tbl.ctrl != NULL) PREFETCH(ptr->tbl.ctrl + pos);
+    PREFETCH(ptr->tbl.bucket + pos);
+
+    if (IS_REHASHING(ptr)) {
+      pos = dhv[i] & ptr->old.mask;
+      if (ptr->old.ctrl != NULL) PREFETCH(ptr->old.ctrl + pos);
+      PREFETCH(ptr->old.bucket + pos);
+    }
+  }
+}
+
+/**
+ * @fn
+ *  static int iter_next(hmap_t* ptr, struct bucket** dst)
+ *
+ * @brief 走査位置以降で最初の使用中バケットの取得
+ *
+ * @remark
+ *  リハッシュ中の場合は、エントリの重複・欠落を避けるために残りの移行を
+ *  完了させてから走査を行う。
+ */
+static int
+iter_next(hmap_t* ptr, struct bucket** dst)
+{
+  int ret;
+  size_t i;
+  struct bucket* item;
+
+  ret  = 0;
+  item = NULL;
+
+  if (IS_REHASHING(ptr)) rehash_step(ptr, ptr->old.size);
+
+  for (i = ptr->pos; i < ptr->tbl.size; i++) {
+    if (ptr->tbl.bucket[i].state == ST_USED) {
+      item = ptr->tbl.bucket + i;
+      break;
+    }
+  }
+
+  if (item == NULL) ret = HMAP_ERROR_NOT_FOUND;
+
+  if (!ret) {
+    ptr->pos = i + 1;
+    *dst     = item;
+  }
+
+  return ret;
+}
+
+static void
+table_stats(struct table* tbl, hmap_stats_t* dst, size_t* sum)
+{
+  size_t i;
+  size_t n;
+  struct bucket* item;
+
+  for (i = 0; i < tbl->size; i++) {
+    item = tbl->bucket + i;
+
+    if (item->state == ST_USED) {
+      n     = DIST(tbl, item->hash & tbl->mask, i) + 1;
+      *sum += n;
+
+      if (n > dst->max_probe) dst->max_probe = n;
+    }
+  }
+
+  dst->size    += tbl->size;
+  dst->used    += tbl->used;
+  dst->removed += tbl->removed;
+}
+
+/**
+ * @fn
+ *  static int frozen_lookup(hmap_frozen_t* ptr,
+ *                           void* key,
+ *                           size_t size,
+ *                           uint64_t hv,
+ *                           void** dst,
+ *                           size_t* dsz)
+ *
+ * @brief スナップショットからのエントリの探索
+ *
+ * @param [in] ptr  対象のスナップショット
+ * @param [in] key  探索するキー
+ * @param [in] size  キーのサイズ
+ * @param [in] hv  キーのハッシュ値
+ * @param [out] dst  値のアドレスの書き込み先
+ * @param [out] dsz  値のサイズの書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   ファイルの内容は信頼せず、オフセットがファイルの範囲外を指している場
+ *   合はHMAP_ERROR_BROKENを返す。探査もバケット数を上限として打ち切る。
+ */
+static int
+frozen_lookup(hmap_frozen_t* ptr, void* key, size_t size, uint64_t hv,
+              void** dst, size_t* dsz)
+{
+  int ret;
+  uint64_t i;
+  uint64_t n;
+  struct frozen_bucket* fb;
+
+  ret = HMAP_ERROR_NOT_FOUND;
+  fb  = NULL;
+
+  for (i = hv & ptr->mask, n = 0; n <= ptr->mask; i = (i + 1) & ptr->mask, n++) {
+    fb = ptr->bucket + i;
+
+    if (fb->koff == 0) break;
+
+    if (fb->hash == hv && fb->ksz == size) {
+      if (fb->koff > ptr->length || size > ptr->length - fb->koff) {
+        ret = HMAP_ERROR_BROKEN;
+        break;
+      }
+
+      if (memcmp((uint8_t*)ptr->addr + fb->koff, key, size) == 0) {
+        ret = 0;
+        break;
+      }
+    }
+  }
+
+  if (!ret) {
+    if (fb->voff > ptr->length || fb->vsz > ptr->length - fb->voff) {
+      ret = HMAP_ERROR_BROKEN;
+    }
+  }
+
+  if (!ret) {
+    *dst = (fb->voff != 0)? (uint8_t*)ptr->addr + fb->voff: NULL;
+    if (dsz != NULL) *dsz = fb->vsz;
+  }
+
+  return ret;
+}
+
+static int
+write_padded(FILE* fp, void* data, size_t size, uint64_t* pos)
+{
+  static const char zero[FROZEN_ALIGN] = {0};
+  int ret;
+  uint64_t pad;
+
+  ret = 0;
+  pad = ALIGN_UP(*pos + size, FROZEN_ALIGN) - (*pos + size);
+
+  if (size > 0 && fwrite(data, size, 1, fp) != 1) ret = HMAP_ERROR_IO;
+  if (!ret && pad > 0 && fwrite(zero, pad, 1, fp) != 1) ret = HMAP_ERROR_IO;
+
+  if (!ret) *pos += size + pad;
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int freeze_table(hmap_t* ptr,
+ *                          struct table* tbl,
+ *                          int (*fn)(void*, void**, size_t*),
+ *                          struct frozen_bucket* fb,
+ *                          uint64_t mask,
+ *                          FILE* fp,
+ *                          size_t* n,
+ *                          uint64_t* pos)
+ *
+ * @brief スナップショットへのエントリの書き出し
+ *
+ * @remark
+ *   tblの使用中のバケットをfbに登録し、キー及び値の実体をfpの現在位置(フ
+ *   ァイル先頭からのオフセット*pos)に書き出す。キーはNUL終端を付加し、キー
+ *   及び値の実体は共にFROZEN_ALIGNバイト境界に揃えて配置する。
+ *
+ * @remark
+ *   シリアライズ関数が返したバイト列は、次にシリアライズ関数を呼び出す前に
+ *   ファイルに書き出す(保持も開放もしない)。このため、シリアライズ関数は同
+ *   じ領域を使い回してよい。
+ *
+ * @remark
+ *   スナップショットのハッシュ値は常にFNV1とするため、FNV1以外のハッシュ関
+ *   数を使用しているハッシュマップではハッシュ値を算出し直して記録する。
+ */
+static int
+freeze_table(hmap_t* ptr, struct table* tbl, int (*fn)(void*, void**, size_t*),
+             struct frozen_bucket* fb, uint64_t mask,
+             FILE* fp, size_t* n, uint64_t* pos)
+{
+  int ret;
+  size_t i;
+  uint64_t j;
+  uint64_t hv;
+  struct bucket* item;
+  void* key;
+  void* val;
+  size_t vsz;
+
+  ret = 0;
+
+  for (i = 0; i < tbl->size; i++) {
+    item = tbl->bucket + i;
+    if (item->state != ST_USED) continue;
+
+    key = KEY(tbl, item);
+
+    if (fn != NULL) {
+      val = NULL;
+      vsz = 0;
+
+      if (fn(item->val, &val, &vsz)) {
+        ret = HMAP_ERROR_IO;
+        break;
+      }
+
+    } else {
+      val = item->val;
+      vsz = (item->val != NULL)? strlen((char*)item->val) + 1: 0;
+    }
+
+    if (val == NULL) vsz = 0;
+
+    hv = (ptr->hfn == hmap_hash_fnv1)? item->hash: hash(key, item->ksz);
+
+    for (j = hv & mask; fb[j].koff != 0; j = (j + 1) & mask);
+
+    fb[j].hash = hv;
+    fb[j].koff = *pos;
+    fb[j].ksz  = item->ksz;
+
+    if (item->ksz > 0 && fwrite(key, item->ksz, 1, fp) != 1) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
+
+    *pos += item->ksz;
+
+    ret = write_padded(fp, "", 1, pos);
+    if (ret) break;
+
+    if (val != NULL) {
+      fb[j].voff = *pos;
+      fb[j].vsz  = vsz;
+
+      ret = write_padded(fp, val, vsz, pos);
+      if (ret) break;
+    }
+
+    (*n)++;
+  }
+
+  return ret;
+}
+
+/*
+ * 外部公開関数の定義
+ */
+
+uint64_t
+hmap_hash_fnv1(void* data, size_t len, uint64_t seed)
+{
+  (void)seed;
+
+  return hash(data, len);
+}
+
+uint64_t
+hmap_hash_wy(void* data, size_t len, uint64_t seed)
+{
+  return wyhash(data, len, seed);
+}
+
+int
+hmap_new(size_t size, hmap_t** dst)
+{
+  return hmap_new3(size, 0, NULL, dst);
+}
+
+int
+hmap_new2(size_t size, int flags, hmap_t** dst)
+{
+  return hmap_new3(size, flags, NULL, dst);
+}
+
+int
+hmap_new3(size_t size, int flags, hmap_hash_t fn, hmap_t** dst)
+{
+  int ret;
+  hmap_t* obj;
+
+  /*
+   * initialize
+   */
+  ret    = 0;
+  obj    = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (size < 16) {
+      ret = HMAP_ERROR_OUT_OF_RANGE;
+      break;
+    }
+
+    // 二の冪乗チェック
+    if ((size & (size -1)) != 0) {
+      ret = HMAP_ERROR_CONSTRAINT;
+      break;
+    }
+
+    if (flags & ~VALID_FLAGS) {
+      ret = HMAP_ERROR_CONSTRAINT;
+      break;
+    }
+
+    if ((flags & HMAP_FLAG_ARENA_KEY) && (flags & HMAP_FLAG_EXTERN_KEY)) {
+      ret = HMAP_ERROR_CONSTRAINT;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) do {
+    obj = ALLOC(hmap_t);
+    if (obj == NULL) {
+      ret = HMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    memset(obj, 0, sizeof(*obj));
+
+    ret = table_init(&obj->tbl, size, flags);
+  } while (0);
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->flags    = flags;
+    obj->max_load = (flags & HMAP_FLAG_GROWABLE)? DEFAULT_MAX_LOAD: 1.0;
+    obj->ridx     = 0;
+    obj->used     = 0;
+    obj->pos      = 0;
+    obj->hfn      = (fn != NULL)? fn: hmap_hash_fnv1;
+    obj->seed     = (obj->hfn != hmap_hash_fnv1)? make_seed(obj): 0;
+    obj->fn       = NULL;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+hmap_destroy(hmap_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HMAP_ERROR_NULL_POINTER;
+
+  /*
+   * clear hashmap
+   *
+   *  キーを所有していない(アリーナまたは外部キー)うえにコールバックも無い
+   *  場合は、キーを個別に開放する必要がないのでバケットの走査を省略する。
+   */
+  if (!ret) {
+    if (OWNS_KEY(ptr) || ptr->fn != NULL) ret = hmap_clear(ptr);
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    table_release(&ptr->tbl);
+    table_release(&ptr->old);
+    arena_release(ptr);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+hmap_set_max_load(hmap_t* ptr, double load)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (!(load >= MIN_MAX_LOAD && load <= 1.0)) {
+      ret = HMAP_ERROR_OUT_OF_RANGE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update object
+   */
+  if (!ret) ptr->max_load = load;
+
+  return ret;
+}
+
+int
+hmap_store(hmap_t* ptr, char* key, void* val)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = store_entry(ptr, key, len, HASH(ptr, key, len), val);
+  }
+
+  return ret;
+}
+
+int
+hmap_hash(hmap_t* ptr, void* key, size_t len, uint64_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL && len > 0) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = HASH(ptr, key, len);
+
+  return ret;
+}
+
+int
+hmap_store_hashed(hmap_t* ptr, void* key, size_t len, uint64_t hv, void* val)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, len, hv, val);
+
+  return ret;
+}
+
+int
+hmap_store_bin(hmap_t* ptr, void* key, size_t len, void* val)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, len, HASH(ptr, key, len), val);
+
+  return ret;
+}
+
+int
+hmap_upsert(hmap_t* ptr, char* key, void*** dst, int* created)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * acquire entry
+   */
+  if (!ret) ret = hmap_upsert_bin(ptr, key, strlen(key), dst, created);
+
+  return ret;
+}
+
+int
+hmap_upsert_bin(hmap_t* ptr, void* key, size_t len, void*** dst, int* created)
+{
+  int ret;
+  int flag;
+  struct table* tbl;
+  struct bucket* item;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * acquire entry
+   */
+  if (!ret) ret = acquire_entry(ptr, key, len, HASH(ptr, key, len),
+                                &tbl, &item, &flag);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = &item->val;
+    if (created != NULL) *created = flag;
+  }
+
+  return ret;
+}
+
+int
+hmap_fetch(hmap_t* ptr, char* key, void** dst)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * search entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = fetch_entry(ptr, key, len, HASH(ptr, key, len), dst);
+  }
+
+  return ret;
+}
+
+int
+hmap_fetch_hashed(hmap_t* ptr, void* key, size_t len, uint64_t hv, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * search entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, len, hv, dst);
+
+  return ret;
+}
+
+int
+hmap_fetch_bin(hmap_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * search entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, len, HASH(ptr, key, len), dst);
+
+  return ret;
+}
+
+int
+hmap_store_many(hmap_t* ptr,
+                void* keys[], size_t lens[], size_t n, void* vals[])
+{
+  int ret;
+  size_t i;
+  size_t j;
+  size_t m;
+  size_t sz[BATCH_SIZE];
+  uint64_t hv[BATCH_SIZE];
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (keys == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (vals == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL) {
+        ret = HMAP_ERROR_NULL_POINTER;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * store entries
+   */
+  for (i = 0; !ret && i < n; i += BATCH_SIZE) {
+    m = ((n - i) < BATCH_SIZE)? (n - i): BATCH_SIZE;
+
+    prefetch_batch(ptr, keys + i, (lens)? lens + i: NULL, m, sz, hv);
+
+    for (j = 0; !ret && j < m; j++) {
+      ret = store_entry(ptr, keys[i + j], sz[j], hv[j], vals[i + j]);
+    }
+  }
+
+  return ret;
+}
+
+int
+hmap_fetch_many(hmap_t* ptr,
+                void* keys[], size_t lens[], size_t n,
+                void* vals[], int found[])
+{
+  int ret;
+  int err;
+  size_t i;
+  size_t j;
+  size_t m;
+  size_t sz[BATCH_SIZE];
+  uint64_t hv[BATCH_SIZE];
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (keys == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (vals == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (found == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL) {
+        ret = HMAP_ERROR_NULL_POINTER;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * search entries
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += BATCH_SIZE) {
+      m = ((n - i) < BATCH_SIZE)? (n - i): BATCH_SIZE;
+
+      prefetch_batch(ptr, keys + i, (lens)? lens + i: NULL, m, sz, hv);
+
+      for (j = 0; j < m; j++) {
+        err = fetch_entry(ptr, keys[i + j], sz[j], hv[j], vals + i + j);
+
+        found[i + j] = !err;
+        if (err) vals[i + j] = NULL;
+      }
+    }
+  }
+
+  return ret;
+}
+
+int
+hmap_remove(hmap_t* ptr, char* key)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = remove_entry(ptr, key, len, HASH(ptr, key, len));
+  }
+
+  return ret;
+}
+
+int
+hmap_remove_bin(hmap_t* ptr, void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, len, HASH(ptr, key, len));
+
+  return ret;
+}
+
+int
+hmap_remove_hashed(hmap_t* ptr, void* key, size_t len, uint64_t hv)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, len, hv);
+
+  return ret;
+}
+
+int
+hmap_clear(hmap_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = HMAP_ERROR_NULL_POINTER;
+
+  /*
+   * clear bucket table
+   */
   if (!ret) {
-    memset(bucket, 0, sizeof(*bucket) * size);
+    if (IS_REHASHING(ptr)) {
+      clear_table(ptr, &ptr->old);
+      table_release(&ptr->old);
+      ptr->ridx = 0;
+    }
 
-    obj->bucket = bucket;
-    obj->size   = size;
-    obj->mask   = size - 1;
-    obj->used   = 0;
-    obj->pos    = bucket - 1;
-    obj->fn     = NULL;
+    clear_table(ptr, &ptr->tbl);
+    arena_release(ptr);
+
+    ptr->used = 0;
   }
 
+  return ret;
+}
+
+int
+hmap_size(hmap_t* ptr, size_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
   /*
    * put return parameter
    */
-  if (!ret) *dst = obj;
+  if (!ret) *dst = ptr->used;
+
+  return ret;
+}
+
+int
+hmap_stats(hmap_t* ptr, hmap_stats_t* dst)
+{
+  int ret;
+  size_t sum;
 
   /*
-   * post process
+   * initialize
    */
-  if (ret) {
-    if (obj != NULL) free(obj);
-    if (bucket != NULL) free(bucket);
+  ret = 0;
+  sum = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * collect statistics
+   */
+  if (!ret) {
+    memset(dst, 0, sizeof(*dst));
+
+    table_stats(&ptr->tbl, dst, &sum);
+    if (IS_REHASHING(ptr)) table_stats(&ptr->old, dst, &sum);
+
+    dst->avg_probe = (dst->used > 0)? (double)sum / (double)dst->used: 0.0;
   }
 
   return ret;
 }
 
 int
-hmap_destroy(hmap_t* ptr)
+hmap_set_callback(hmap_t* ptr, void (*fn)(char*, void*))
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * object update
+   */
+  if (!ret) ptr->fn = fn;
+
+  return ret;
+}
+
+int
+hmap_iter(hmap_t* ptr, char** dsk, void** dsv)
+{
+  int ret;
+  struct bucket* item;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  item = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   */
+  if (!ret) ret = iter_next(ptr, &item);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsk != NULL) *dsk = KEY(&ptr->tbl, item);
+    *dsv = item->val;
+  }
+
+  return ret;
+}
+
+int
+hmap_iter_bin(hmap_t* ptr, void** dsk, size_t* dsz, void** dsv)
+{
+  int ret;
+  struct bucket* item;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  item = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   */
+  if (!ret) ret = iter_next(ptr, &item);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsk != NULL) *dsk = KEY(&ptr->tbl, item);
+    if (dsz != NULL) *dsz = item->ksz;
+    *dsv = item->val;
+  }
+
+  return ret;
+}
+
+int
+hmap_rewind(hmap_t* ptr)
 {
   int ret;
-  int i;
 
   /*
    * initialize
@@ -246,37 +2570,110 @@ hmap_destroy(hmap_t* ptr)
   if (ptr == NULL) ret = HMAP_ERROR_NULL_POINTER;
 
   /*
-   * clear hashmap
+   * rewind find position
+   */
+  if (!ret) ptr->pos = 0;
+
+  return ret;
+}
+
+int
+hmap_iter_r(hmap_t* ptr, size_t* pos, void** dsk, size_t* dsz, void** dsv)
+{
+  int ret;
+  size_t i;
+  struct table* tbl;
+  struct bucket* item;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  item = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (pos == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   *
+   *  走査位置は現行テーブル、移行元テーブルの順に通しで数える(移行済みの
+   *  バケットはST_REMOVEDになっているので重複はしない)。
    */
-  if (!ret) ret = hmap_clear(ptr);
+  if (!ret) {
+    for (i = *pos; item == NULL; i++) {
+      if (i < ptr->tbl.size) {
+        tbl = &ptr->tbl;
+        if (tbl->bucket[i].state == ST_USED) item = tbl->bucket + i;
+
+      } else if (IS_REHASHING(ptr) && i < ptr->tbl.size + ptr->old.size) {
+        tbl = &ptr->old;
+        if (tbl->bucket[i - ptr->tbl.size].state == ST_USED) {
+          item = tbl->bucket + (i - ptr->tbl.size);
+        }
+
+      } else {
+        ret = HMAP_ERROR_NOT_FOUND;
+        break;
+      }
+    }
+  }
 
   /*
-   * release memory
+   * put return parameter
    */
   if (!ret) {
-    if (ptr->bucket) free(ptr->bucket);
-    free(ptr);
+    *pos = i;
+
+    if (dsk != NULL) *dsk = KEY(tbl, item);
+    if (dsz != NULL) *dsz = item->ksz;
+    *dsv = item->val;
+
+  } else if (ret == HMAP_ERROR_NOT_FOUND) {
+    *pos = i;
   }
 
   return ret;
 }
 
-
-
 int
-hmap_store(hmap_t* ptr, char* _key, void* val)
+hmap_freeze(hmap_t* ptr, char* path, int (*fn)(void*, void**, size_t*))
 {
   int ret;
-  size_t len;
-  char* key;
-  struct bucket* item;
+  uint64_t size;
+  uint64_t pos;
+  size_t n;
+  char* tmp;
+  FILE* fp;
+  struct frozen_header hdr;
+  struct frozen_bucket* fb;
 
   /*
    * initialize
    */
-  ret  = 0;
-  key  = NULL;
-  item = NULL;
+  ret = 0;
+  n   = 0;
+  pos = 0;
+  tmp = NULL;
+  fp  = NULL;
+  fb  = NULL;
 
   /*
    * argument check
@@ -287,94 +2684,129 @@ hmap_store(hmap_t* ptr, char* _key, void* val)
       break;
     }
 
-    if (_key == NULL) {
+    if (path == NULL) {
       ret = HMAP_ERROR_NULL_POINTER;
       break;
     }
   } while (0);
 
   /*
-   * state check
+   * memory allocate
+   *
+   *  バケット数は負荷率が0.75以下となる二の冪乗とする(空きバケットが必ず
+   *  残るので探査は必ず終了する)。
    */
-  if (!ret) {
-    if (ptr->used >= ptr->size) ret = HMAP_ERROR_FULL;
-  }
+  if (!ret) do {
+    size = FROZEN_MIN_SIZE;
+    while ((size / 4) * 3 < ptr->used + 1) size <<= 1;
 
-  /*
-   * search empty bucket
-   */
-  if (!ret) {
-    len = strlen(_key);
+    fb = (struct frozen_bucket*)calloc(size, sizeof(struct frozen_bucket));
+    if (fb == NULL) {
+      ret = HMAP_ERROR_NO_MEMORY;
+      break;
+    }
 
-    search_bucket(ptr, _key, len, &item);
+    tmp = NALLOC(char, strlen(path) + 5);
+    if (tmp == NULL) {
+      ret = HMAP_ERROR_NO_MEMORY;
+      break;
+    }
 
-    // 上段のstate checkで満杯チェックを行っているので
-    // ここには引っかからないはず
-    if (item == NULL) ret = HMAP_ERROR_FULL;
-  }
+    sprintf(tmp, "%s.tmp", path);
+  } while (0);
 
   /*
-   * duplicate key
+   * write file
+   *
+   *  キー及び値の実体をバケット配列の後ろの位置から先に書き出し、オフセッ
+   *  トの確定したバケット配列とヘッダを最後に先頭へ書き出す。値はシリアラ
+   *  イズ関数の呼び出し毎にその場で書き出すので、全ての値のバイト列を同時
+   *  にメモリ上に保持することはない。
    */
-  if (!ret) {
-    if (item->state != ST_USED) {
-      key = strdup(_key);
-      if (key == NULL) ret = HMAP_ERROR_NO_MEMORY;
+  if (!ret) do {
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+      ret = HMAP_ERROR_IO;
+      break;
     }
-  }
 
-  /*
-   * update object
-   */
-  if (!ret) {
-    if (item->state != ST_USED) {
-      // 新規割り当ての場合は状態及びキー情報を書き替え、使用数を加算
-      item->state = ST_USED;
-      item->key   = key;
-      item->ksz   = len;
+    pos = sizeof(hdr) + sizeof(struct frozen_bucket) * size;
 
-      ptr->used++;
+    if (fseeko(fp, (off_t)pos, SEEK_SET)) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
 
-    } else {
-      // 使用中領域の場合(値の上書)の場合、コールバック呼び出し。
-      if (ptr->fn != NULL) ptr->fn(item->key, item->val);
+    ret = freeze_table(ptr, &ptr->tbl, fn, fb, size - 1, fp, &n, &pos);
+    if (ret) break;
+
+    if (IS_REHASHING(ptr)) {
+      ret = freeze_table(ptr, &ptr->old, fn, fb, size - 1, fp, &n, &pos);
+      if (ret) break;
     }
 
-    item->val = val;
-  }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, FROZEN_MAGIC, sizeof(hdr.magic));
+    hdr.order  = FROZEN_ORDER;
+    hdr.size   = size;
+    hdr.used   = n;
+    hdr.length = pos;
+
+    if (fseeko(fp, 0, SEEK_SET)) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
+
+    pos = 0;
+
+    ret = write_padded(fp, &hdr, sizeof(hdr), &pos);
+    if (ret) break;
+
+    ret = write_padded(fp, fb, sizeof(struct frozen_bucket) * size, &pos);
+    if (ret) break;
+
+    ret = (fclose(fp) == 0)? 0: HMAP_ERROR_IO;
+    fp  = NULL;
+    if (ret) break;
+
+    if (rename(tmp, path)) ret = HMAP_ERROR_IO;
+  } while (0);
 
   /*
    * post process
    */
-  if (ret) {
-    if (key != NULL) free(key);
-  }
+  if (fp != NULL) fclose(fp);
+  if (ret && tmp != NULL) unlink(tmp);
+
+  if (tmp != NULL) free(tmp);
+  if (fb != NULL) free(fb);
 
   return ret;
 }
 
 int
-hmap_fetch(hmap_t* ptr, char* key, void** dst)
+hmap_open_frozen(char* path, hmap_frozen_t** dst)
 {
   int ret;
-  struct bucket* item;
+  int fd;
+  void* addr;
+  struct stat st;
+  struct frozen_header* hdr;
+  hmap_frozen_t* obj;
 
   /*
    * initialize
    */
   ret  = 0;
-  item = NULL;
+  fd   = -1;
+  addr = MAP_FAILED;
+  obj  = NULL;
 
   /*
    * argument check
    */
   do {
-    if (ptr == NULL) {
-      ret = HMAP_ERROR_NULL_POINTER;
-      break;
-    }
-
-    if (key == NULL) {
+    if (path == NULL) {
       ret = HMAP_ERROR_NULL_POINTER;
       break;
     }
@@ -386,112 +2818,93 @@ hmap_fetch(hmap_t* ptr, char* key, void** dst)
   } while (0);
 
   /*
-   * search entry
+   * map file
    */
-  if (!ret) {
-    search_bucket(ptr, key, strlen(key), &item);
-    if (item == NULL || item->state != ST_USED) ret = HMAP_ERROR_NOT_FOUND;
-  }
+  if (!ret) do {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
 
-  /*
-   * put return parameter
-   */
-  if (!ret) *dst = item->val;
+    if (fstat(fd, &st)) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
 
-  return ret;
-}
+    if ((size_t)st.st_size < sizeof(struct frozen_header)) {
+      ret = HMAP_ERROR_BROKEN;
+      break;
+    }
 
-int
-hmap_remove(hmap_t* ptr, char* key)
-{
-  int ret;
-  struct bucket* item;
-  struct bucket* pt;
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ret = HMAP_ERROR_IO;
+      break;
+    }
+  } while (0);
 
   /*
-   * initialize
+   * validate header
    */
-  ret = 0;
+  if (!ret) do {
+    hdr = (struct frozen_header*)addr;
 
-  /*
-   * argument check
-   */
-  do {
-    if (ptr == NULL) {
-      ret = HMAP_ERROR_NULL_POINTER;
+    if (memcmp(hdr->magic, FROZEN_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->order != FROZEN_ORDER) {
+      ret = HMAP_ERROR_BROKEN;
       break;
     }
 
-    if (key == NULL) {
-      ret = HMAP_ERROR_NULL_POINTER;
+    if (hdr->size == 0 || (hdr->size & (hdr->size - 1)) != 0 ||
+        hdr->used >= hdr->size || hdr->length != (uint64_t)st.st_size) {
+      ret = HMAP_ERROR_BROKEN;
+      break;
+    }
+
+    if (hdr->size > (hdr->length - sizeof(*hdr)) /
+                    sizeof(struct frozen_bucket)) {
+      ret = HMAP_ERROR_BROKEN;
       break;
     }
   } while (0);
 
   /*
-   * state check
+   * create object
    */
   if (!ret) {
-    if (ptr->used == 0) ret = HMAP_ERROR_EMPTY;
+    obj = ALLOC(hmap_frozen_t);
+    if (obj == NULL) ret = HMAP_ERROR_NO_MEMORY;
   }
 
-  /*
-   * search entry
-   */
   if (!ret) {
-    search_bucket(ptr, key, strlen(key), &item);
-    if (item == NULL || item->state != ST_USED) ret = HMAP_ERROR_NOT_FOUND;
+    obj->addr   = addr;
+    obj->length = st.st_size;
+    obj->bucket = (struct frozen_bucket*)(hdr + 1);
+    obj->mask   = hdr->size - 1;
+    obj->used   = hdr->used;
   }
 
   /*
-   * remove entry
+   * put return parameter
    */
-  if (!ret) {
-    pt = item + 1;
-    if ((pt - ptr->bucket) >= ptr->size) pt = ptr->bucket;
-
-    if (pt->state != ST_EMPTY && ptr->used > 1) {
-      // 対象エントリの次のエントリがST_EMPTYでない場合は、探索リンクを
-      // 継続する必要があるのでST_REMOVEDに設定。
-      item->state = ST_REMOVED;
-
-    } else {
-      // 対象リンクの次のエントリがST_EMPTYの場合、もしくはハッシュマップ中の
-      // 最後の一個っだった場合は自身もST_EMPTYに設定。
-      item->state = ST_EMPTY;
-
-      // さらに前方に向かって連続しているST_REMOVEDを全てST_EMPTYに設定。
-      for (pt = item - 1; pt != item; pt--) {
-        if (pt < ptr->bucket) pt += ptr->size;
-        if (pt->state != ST_REMOVED) break;
-
-        pt->state = ST_EMPTY;
-      }
-    }
-
-    // コールバックを呼び出す
-    if (ptr->fn != NULL) ptr->fn(item->key, item->val);
-
-    // キーの情報を削除
-    free(item->key);
-
-    item->key = NULL;
-    item->ksz = 0;
-    item->val = NULL;
+  if (!ret) *dst = obj;
 
-    // サイズを減らす
-    ptr->used--;
-  }
+  /*
+   * post process
+   *
+   *  マッピング後はファイルディスクリプタは不要なので閉じる。
+   */
+  if (fd >= 0) close(fd);
+  if (ret && addr != MAP_FAILED) munmap(addr, st.st_size);
 
   return ret;
 }
 
 int
-hmap_clear(hmap_t* ptr)
+hmap_close_frozen(hmap_frozen_t* ptr)
 {
   int ret;
-  int i;
-  struct bucket* item;
 
   /*
    * initialize
@@ -504,49 +2917,21 @@ hmap_clear(hmap_t* ptr)
   if (ptr == NULL) ret = HMAP_ERROR_NULL_POINTER;
 
   /*
-   * clear bucket table
+   * release resources
    */
   if (!ret) {
-    for (i = 0; i < (int)ptr->size; i++) {
-      item = ptr->bucket + i;
-
-      switch (item->state) {
-      case ST_EMPTY:
-        // ignore;
-        break;
-
-      case ST_USED:
-        if (ptr->fn != NULL) ptr->fn(item->key, item->val);
-
-        free(item->key);
-        item->state = ST_EMPTY;
-        item->key   = NULL;
-        item->ksz   = 0;
-        item->val   = NULL;
-        break;
-
-      case ST_REMOVED:
-        item->state = ST_EMPTY;
-        break;
-      }
-    }
-
-    ptr->used = 0;
+    munmap(ptr->addr, ptr->length);
+    free(ptr);
   }
 
   return ret;
 }
 
 int
-hmap_size(hmap_t* ptr, size_t** dst)
-{
-  return -1;
-}
-
-int
-hmap_set_callback(hmap_t* ptr, void (*fn)(char*, void*))
+hmap_frozen_fetch(hmap_frozen_t* ptr, char* key, void** dst)
 {
   int ret;
+  size_t len;
 
   /*
    * initialize
@@ -556,29 +2941,44 @@ hmap_set_callback(hmap_t* ptr, void (*fn)(char*, void*))
   /*
    * argument check
    */
-  if (ptr == NULL) ret = DEFAULT_ERROR;
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
 
   /*
-   * object update
+   * lookup
    */
-  if (!ret) ptr->fn = fn;
+  if (!ret) {
+    len = strlen(key);
+    ret = frozen_lookup(ptr, key, len, hash((uint8_t*)key, len), dst, NULL);
+  }
 
   return ret;
 }
 
 int
-hmap_iter(hmap_t* ptr, char** dsk, void** dsv)
+hmap_frozen_fetch_bin(hmap_frozen_t* ptr,
+                      void* key, size_t len, void** dst, size_t* dsz)
 {
   int ret;
-  int i;
-  struct bucket* item;
-  struct bucket* p;
 
   /*
    * initialize
    */
-  ret  = 0;
-  item = NULL;
+  ret = 0;
 
   /*
    * argument check
@@ -589,44 +2989,67 @@ hmap_iter(hmap_t* ptr, char** dsk, void** dsv)
       break;
     }
 
-    if (dsv == NULL) {
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
       ret = HMAP_ERROR_NULL_POINTER;
       break;
     }
   } while (0);
 
   /*
-   * find next
+   * lookup
    */
-  if (!ret) {
-    for (p = ptr->pos + 1; (p - ptr->bucket) < ptr->size; p++) {
-      if (p->state == ST_USED) {
-        item = p;
-        break;
-      }
-    }
+  if (!ret) ret = frozen_lookup(ptr, key, len, hash(key, len), dst, dsz);
 
-    if (item == NULL) ret = HMAP_ERROR_NOT_FOUND;
-  }
+  return ret;
+}
+
+int
+hmap_frozen_fetch_hashed(hmap_frozen_t* ptr,
+                         void* key, size_t len, uint64_t hv,
+                         void** dst, size_t* dsz)
+{
+  int ret;
 
   /*
-   * update object
+   * initialize
    */
-  if (!ret) ptr->pos = item;
+  ret = 0;
 
   /*
-   * put return parameter
+   * argument check
    */
-  if (!ret) {
-    if (dsk != NULL) *dsk = item->key;
-    *dsv = item->val;
-  }
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * lookup
+   */
+  if (!ret) ret = frozen_lookup(ptr, key, len, hv, dst, dsz);
 
   return ret;
 }
 
 int
-hmap_rewind(hmap_t* ptr)
+hmap_frozen_size(hmap_frozen_t* ptr, size_t* dst)
 {
   int ret;
 
@@ -638,17 +3061,27 @@ hmap_rewind(hmap_t* ptr)
   /*
    * argument check
    */
-  if (ptr == NULL) ret = HMAP_ERROR_NULL_POINTER;
+  do {
+    if (ptr == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = HMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
 
   /*
-   * rewind find position
+   * put return parameter
    */
-  if (!ret) ptr->pos = ptr->bucket - 1;
+  if (!ret) *dst = ptr->used;
 
   return ret;
 }
 
-#if 1
+#ifndef HMAP_NO_MAIN
 int
 main(int args, char* argv)
 {
@@ -732,4 +3165,4 @@ main(int args, char* argv)
   hmap_destroy(map);
 
 }
-#endif
+#endif /* !defined(HMAP_NO_MAIN) */
@@ -10,8 +10,10 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct __hmap_t__ hmap_t;
+typedef struct __hmap_frozen_t__ hmap_frozen_t;
 
 #define HMAP_ERROR_OUT_OF_RANGE     (-1)
 #define HMAP_ERROR_CONSTRAINT       (-2)
@@ -20,6 +22,31 @@ typedef struct __hmap_t__ hmap_t;
 #define HMAP_ERROR_FULL             (-5)
 #define HMAP_ERROR_EMPTY            (-6)
 #define HMAP_ERROR_NOT_FOUND        (-7)
+#define HMAP_ERROR_IO               (-8)
+#define HMAP_ERROR_BROKEN           (-9)
+
+#define HMAP_FLAG_GROWABLE          (0x0001)
+#define HMAP_FLAG_GROUP_PROBE       (0x0002)
+#define HMAP_FLAG_ARENA_KEY         (0x0004)
+#define HMAP_FLAG_BACKSHIFT         (0x0008)
+#define HMAP_FLAG_STABLE_FETCH      (0x0010)
+#define HMAP_FLAG_EXTERN_KEY        (0x0020)
+
+/*
+ * ハッシュ関数の型
+ *
+ *  キーのアドレス、サイズ及びハッシュマップ毎のシード値を受け取り、64bitの
+ *  ハッシュ値を返す。hmap_new3()で指定する。
+ */
+typedef uint64_t (*hmap_hash_t)(void* data, size_t len, uint64_t seed);
+
+typedef struct {
+  size_t size;        // バケットの総数(拡張中は新旧テーブルの合計)
+  size_t used;        // 使用中のバケットの数
+  size_t removed;     // 削除済み(ST_REMOVED)のバケットの数
+  size_t max_probe;   // 登録済みエントリの探査長の最大値
+  double avg_probe;   // 登録済みエントリの探査長の平均値
+} hmap_stats_t;
 
 /*
  * @fn
@@ -50,10 +77,161 @@ typedef struct __hmap_t__ hmap_t;
  *
  * @remark
  *   本関数で生成されるハッシュマップは満杯になっても自動的に拡張されない(リ
- *   ハッシュは行わない)。
+ *   ハッシュは行わない)。自動拡張を行うハッシュマップが必要な場合は
+ *   hmap_new2()を使用すること。
  */
 extern int hmap_new(size_t size, hmap_t** dst);
 
+/*
+ * @fn
+ *   int hmap_new2(size_t size, int flags, hmap_t** dst);
+ *
+ * @brief  ハッシュマップオブジェクトの生成(動作モード指定付き)
+ *
+ * @param [in] size  ハッシュマップのサイズ(拡張可能な場合は初期サイズ)
+ * @param [in] flags  動作モードを指定するフラグ(HMAP_FLAG_*の論理和)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_OUT_OF_RANGE
+ *   引数sizeで指定されたハッシュマップのサイズが16未満の場合に返す。
+ *
+ * @retval HMAP_ERROR_CONSTRAINT
+ *   引数sizeで指定されたハッシュマップのサイズが2の冪乗数でない場合、引数
+ *   flagsに未定義のフラグが含まれている場合、または同時に指定できないフラ
+ *   グが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_GROWABLEを指定した場合、負荷率(エントリ数/バケット数)
+ *   が上限(デフォルトは0.75、hmap_set_max_load()で変更可能)を超える時点で
+ *   倍のサイズのテーブルへの拡張を開始する。既存エントリの移行は一括では行
+ *   わず、以降のhmap_store()/hmap_fetch()の呼び出し毎に数バケットずつ行う
+ *   ので、一回の操作の処理時間が突出することはない。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_GROUP_PROBEを指定した場合、バケット配列とは別に各バケ
+ *   ットのハッシュ値の7bitを保持するコントロールバイト配列を持ち、探査時は
+ *   これを16個(AVX2有効時は32個)ずつSIMD命令で比較する。ハッシュ値の一部
+ *   が一致したバケットに対してのみキーの比較を行うので、探査でのキャッシュ
+ *   ミスが減少する。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_ARENA_KEYを指定した場合、キーの複製を個別にmalloc()せ
+ *   ず、15バイト以下のキーはバケットと並行するインラインキー配列に、それ以
+ *   上のキーはハッシュマップが所有するアリーナ(64KiB単位で確保する領域)に
+ *   格納する。削除したキーの領域はhmap_clear()またはhmap_destroy()まで再利
+ *   用されない。コールバック未登録時は、破棄はキーの数ではなくアリーナのチ
+ *   ャンク数に比例する時間で完了し、クリアもキー毎の開放は行わずバケット配
+ *   列の一括初期化(memset)とチャンクの開放のみで完了する。なお、このモード
+ *   ではhmap_iter()及びコールバックで渡されるキーのアドレスは、次にハッシ
+ *   ュマップを変更するまでの間のみ有効となる。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_BACKSHIFTを指定した場合、エントリの削除時に削除済みマ
+ *   ークを残さず、後続のエントリを前に詰める(後方シフト削除)。追加・削除
+ *   を繰り返しても探査長が伸び続けることはなくなるが、hmap_iter()での走査
+ *   中にエントリを削除すると走査の重複・欠落が発生する。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_STABLE_FETCHを指定した場合、hmap_fetch()系の関数はリ
+ *   ハッシュの移行処理を行わず、オブジェクトを一切変更しない。このため読み
+ *   出し同士であれば複数スレッドから同時に呼び出すことができる(読み書きの
+ *   排他は呼び出し側で行うこと)。移行処理は更新系の関数でのみ進む。
+ *
+ * @remark
+ *   flagsにHMAP_FLAG_EXTERN_KEYを指定した場合、キーを複製せずに保存時に渡
+ *   されたアドレスをそのまま保持する。キーの領域はエントリの削除まで呼び出
+ *   し側で保持しておくこと。この場合、hmap_iter()等で返されるキーにNUL終端
+ *   は付加されない。HMAP_FLAG_ARENA_KEYとは同時に指定できない。
+ *
+ * @remark
+ *   拡張可能なハッシュマップでは、削除済みマークも負荷率に含めて判定し、エ
+ *   ントリ数自体が上限の半分以下の場合は同じサイズのテーブルへの再構築
+ *   (拡張と同様に少しずつ行う)により削除済みマークを一掃する。上限の半分
+ *   を超えている場合は拡張を行う。
+ *
+ * @remark
+ *   flagsに0を指定した場合はhmap_new()と同じ動作となる。
+ */
+extern int hmap_new2(size_t size, int flags, hmap_t** dst);
+
+/*
+ * @fn
+ *   int hmap_new3(size_t size, int flags, hmap_hash_t fn, hmap_t** dst);
+ *
+ * @brief  ハッシュマップオブジェクトの生成(ハッシュ関数指定付き)
+ *
+ * @param [in] size  ハッシュマップのサイズ(拡張可能な場合は初期サイズ)
+ * @param [in] flags  動作モードを指定するフラグ(HMAP_FLAG_*の論理和)
+ * @param [in] fn  ハッシュ関数(NULLの場合はhmap_hash_fnv1)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   戻り値及び引数size, flagsの扱いはhmap_new2()と同じ。
+ *
+ * @remark
+ *   ハッシュ関数には以下のものを用意している。
+ *
+ *     hmap_hash_fnv1  FNV1 64bit(1バイト単位)。シード値は使用せず、
+ *                     c-lang/hash/fnv1.cのfnv164()と同じ値を返す。
+ *                     hmap_new()/hmap_new2()で生成したハッシュマップはこ
+ *                     の関数を使用する。
+ *     hmap_hash_wy    wyhash(8バイト単位)。長いキーほど高速で、撹拌の質
+ *                     もFNV1より高い。
+ *
+ * @remark
+ *   hmap_hash_fnv1以外の関数を指定した場合、生成時にハッシュマップ毎のシー
+ *   ド値を乱数で決定して関数に渡す。このため同じキーでもハッシュマップ毎に
+ *   異なるハッシュ値となり、外部から与えられたキー(信頼できない入力)で意図
+ *   的に衝突を起こすことが困難になる。hmap_store_hashed()等に指定するハッシ
+ *   ュ値はhmap_hash()で求めること。
+ */
+extern int hmap_new3(size_t size, int flags, hmap_hash_t fn, hmap_t** dst);
+
+/*
+ * @fn
+ *   uint64_t hmap_hash_fnv1(void* data, size_t len, uint64_t seed);
+ *   uint64_t hmap_hash_wy(void* data, size_t len, uint64_t seed);
+ *
+ * @brief  組み込みのハッシュ関数
+ *
+ * @remark
+ *   hmap_new3()に指定するための関数。詳細はhmap_new3()の説明を参照のこと。
+ */
+extern uint64_t hmap_hash_fnv1(void* data, size_t len, uint64_t seed);
+extern uint64_t hmap_hash_wy(void* data, size_t len, uint64_t seed);
+
+/*
+ * @fn
+ *   int hmap_hash(hmap_t* ptr, void* key, size_t len, uint64_t* dst);
+ *
+ * @brief  キーに対するハッシュ値の算出
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  キー
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [out] dst  ハッシュ値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @remark
+ *   ハッシュマップが内部で使用するのと同じ値(ハッシュ関数及びシード値を適用
+ *   した値)を返す。hmap_store_hashed()等に指定する値の算出に使用する。
+ */
+extern int hmap_hash(hmap_t* ptr, void* key, size_t len, uint64_t* dst);
+
 /*
  * @fn
  *   int hmap_destroy(hmap_t** dst);
@@ -73,6 +251,31 @@ extern int hmap_new(size_t size, hmap_t** dst);
  */
 extern int hmap_destroy(hmap_t* dst);
 
+/*
+ * @fn
+ *   int hmap_set_max_load(hmap_t* ptr, double load);
+ *
+ * @brief  負荷率の上限の設定
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] load  負荷率の上限(0.25以上1.0以下)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_OUT_OF_RANGE
+ *   引数loadで指定された値が範囲外の場合に返す。
+ *
+ * @remark
+ *   拡張可能なハッシュマップでは、新規エントリの追加で負荷率が上限を超える
+ *   場合にテーブルの拡張を開始する。拡張を行わないハッシュマップでは、負荷
+ *   率が上限を超える追加をHMAP_ERROR_FULLで失敗させる(デフォルトの上限は
+ *   1.0で、満杯になるまで追加が可能)。
+ */
+extern int hmap_set_max_load(hmap_t* ptr, double load);
+
 /*
  * @fn
  *   int hmap_store(hmap_t* ptr, char* key, void* value);
@@ -89,10 +292,11 @@ extern int hmap_destroy(hmap_t* dst);
  *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
  *
  * @retval HMAP_ERROR_FULL
- *   ハッシュマップが満杯(空きがない場合)に返す。
+ *   ハッシュマップが満杯(空きがない場合)に返す。拡張可能なハッシュマップで
+ *   は返さない。
  *
  * @retval HMAP_ERROR_NO_MEMORY
- *   メモリ確保に失敗した場合に返す。
+ *   メモリ確保(テーブルの拡張を含む)に失敗した場合に返す。
  *
  * @remark
  *   引数 keyで指定する文字列は関数内部でコピーを作成する。このため、関数終了
@@ -105,6 +309,138 @@ extern int hmap_destroy(hmap_t* dst);
  */
 extern int hmap_store(hmap_t* ptr, char* key, void* value);
 
+/*
+ * @fn
+ *   int hmap_store_hashed(hmap_t* ptr,
+ *                         void* key,
+ *                         size_t len,
+ *                         uint64_t hash,
+ *                         void* value);
+ *
+ * @brief  ハッシュマップへの保存(算出済みハッシュ値の指定)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  データのキー
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [in] hash  キーのハッシュ値
+ * @param [in] value  データの値(任意のオブジェクトのポインタ, NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_FULL
+ *   ハッシュマップが満杯(空きがない場合)に返す。拡張可能なハッシュマップで
+ *   は返さない。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリ確保(テーブルの拡張を含む)に失敗した場合に返す。
+ *
+ * @remark
+ *   hmap_store()と同じ処理を、キーの長さの計測及びハッシュ値の算出を省略し
+ *   て行う。引数hashにはハッシュマップ内部で使用するハッシュ値と同じ値(
+ *   hmap_hash()の返す値。hmap_new()/hmap_new2()で生成したハッシュマップで
+ *   はキーに対するFNV1 64bitの値で、c-lang/hash/fnv1.cのfnv164()の返す値と
+ *   同じ)を指定すること。異なる値を指定した場合、同じキーでもhmap_fetch()
+ *   等で検索できなくなる。
+ */
+extern int hmap_store_hashed(hmap_t* ptr,
+                             void* key, size_t len, uint64_t hash, void* value);
+
+/*
+ * @fn
+ *   int hmap_store_bin(hmap_t* ptr, void* key, size_t len, void* value);
+ *
+ * @brief  ハッシュマップへの保存(バイナリキー)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  データのキー(任意のバイト列)
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [in] value  データの値(任意のオブジェクトのポインタ, NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_FULL
+ *   ハッシュマップが満杯(空きがない場合)に返す。拡張可能なハッシュマップで
+ *   は返さない。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリ確保(テーブルの拡張を含む)に失敗した場合に返す。
+ *
+ * @remark
+ *   キーをNUL終端文字列ではなく、アドレスとサイズで指定する以外は
+ *   hmap_store()と同じ。キーにはNULを含む任意のバイト列(IDや他のハッシュ値
+ *   など)を指定できる。NUL終端文字列のキーをstrlen()で得たサイズで指定した
+ *   場合はhmap_store()で保存したキーと同一のキーとして扱う。
+ */
+extern int hmap_store_bin(hmap_t* ptr, void* key, size_t len, void* value);
+
+/*
+ * @fn
+ *   int hmap_upsert(hmap_t* ptr, char* key, void*** dst, int* created);
+ *
+ * @brief  値の格納位置の取得(キーが未登録の場合はエントリを作成)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  データのキー(NUL終端文字列)
+ * @param [out] dst  値の格納位置(void*へのポインタ)の書き込み先
+ * @param [out] created  エントリを新規作成した場合は0以外、登録済みだった
+ *                       場合は0の書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_FULL
+ *   ハッシュマップが満杯(空きがない場合)に返す。拡張可能なハッシュマップで
+ *   は返さない。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリ確保(テーブルの拡張を含む)に失敗した場合に返す。
+ *
+ * @remark
+ *   一回の探査でエントリの検索と(必要であれば)作成を行い、値の格納位置を返
+ *   す。新規作成したエントリの値はNULLとなる。格納位置を通して値を直接書き
+ *   替えることで、hmap_fetch()とhmap_store()の組み合わせによる二重の探査
+ *   を避けられる(カウンタの加算など)。この場合、コールバック呼び出しは行わ
+ *   れない。
+ *
+ * @remark
+ *   返した格納位置は、次にハッシュマップに対する関数(hmap_fetch()を含む)を
+ *   呼び出すまでの間のみ有効。
+ */
+extern int hmap_upsert(hmap_t* ptr, char* key, void*** dst, int* created);
+
+/*
+ * @fn
+ *   int hmap_upsert_bin(hmap_t* ptr,
+ *                       void* key,
+ *                       size_t len,
+ *                       void*** dst,
+ *                       int* created);
+ *
+ * @brief  値の格納位置の取得(バイナリキー)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  データのキー(任意のバイト列)
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [out] dst  値の格納位置(void*へのポインタ)の書き込み先
+ * @param [out] created  エントリを新規作成した場合は0以外、登録済みだった
+ *                       場合は0の書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   キーの指定方法以外はhmap_upsert()と同じ。
+ */
+extern int hmap_upsert_bin(hmap_t* ptr,
+                           void* key, size_t len, void*** dst, int* created);
+
 /**
  * @fn
  *   int hmap_fetch(hmap_t* ptr, char* key, void** dst);
@@ -125,6 +461,132 @@ extern int hmap_store(hmap_t* ptr, char* key, void* value);
  */
 extern int hmap_fetch(hmap_t* ptr, char* key, void** dst);
 
+/**
+ * @fn
+ *   int hmap_fetch_hashed(hmap_t* ptr,
+ *                         void* key,
+ *                         size_t len,
+ *                         uint64_t hash,
+ *                         void** dst);
+ *
+ * @brief  ハッシュマップの読み出し(算出済みハッシュ値の指定)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  読み出し対象のキー
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [in] hash  キーのハッシュ値
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ *
+ * @remark
+ *   引数hashに指定する値についてはhmap_store_hashed()の説明を参照のこと。
+ */
+extern int hmap_fetch_hashed(hmap_t* ptr,
+                             void* key, size_t len, uint64_t hash, void** dst);
+
+/**
+ * @fn
+ *   int hmap_fetch_bin(hmap_t* ptr, void* key, size_t len, void** dst);
+ *
+ * @brief  ハッシュマップの読み出し(バイナリキー)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  読み出し対象のキー(任意のバイト列)
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ */
+extern int hmap_fetch_bin(hmap_t* ptr, void* key, size_t len, void** dst);
+
+/**
+ * @fn
+ *   int hmap_store_many(hmap_t* ptr,
+ *                       void* keys[],
+ *                       size_t lens[],
+ *                       size_t n,
+ *                       void* values[]);
+ *
+ * @brief  ハッシュマップへの一括保存
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] keys  キーの配列
+ * @param [in] lens  キーのサイズの配列(NULLの場合は全てのキーをNUL終端文字
+ *                   列として扱う)
+ * @param [in] n  保存するエントリの数
+ * @param [in] values  値の配列
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数(配列の要素を含む)にNULLが指定された場合
+ *   に返す。
+ *
+ * @retval HMAP_ERROR_FULL
+ *   ハッシュマップが満杯(空きがない場合)に返す。拡張可能なハッシュマップで
+ *   は返さない。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリ確保(テーブルの拡張を含む)に失敗した場合に返す。
+ *
+ * @remark
+ *   hmap_store_bin()をn回呼び出すのと同じ結果となるが、一定数のキーのハッ
+ *   シュ値をまとめて算出して探査開始位置のプリフェッチを先行させることで、
+ *   メモリアクセスの待ち時間を隠蔽する。途中でエラーが発生した場合は、そ
+ *   れ以前のエントリは保存された状態で処理を中断する。
+ */
+extern int hmap_store_many(hmap_t* ptr,
+                           void* keys[], size_t lens[], size_t n,
+                           void* values[]);
+
+/**
+ * @fn
+ *   int hmap_fetch_many(hmap_t* ptr,
+ *                       void* keys[],
+ *                       size_t lens[],
+ *                       size_t n,
+ *                       void* values[],
+ *                       int found[]);
+ *
+ * @brief  ハッシュマップの一括読み出し
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] keys  読み出し対象のキーの配列
+ * @param [in] lens  キーのサイズの配列(NULLの場合は全てのキーをNUL終端文字
+ *                   列として扱う)
+ * @param [in] n  読み出すキーの数
+ * @param [out] values  読み出した値の書き込み先(キーが見つからなかった要素
+ *                      にはNULLを書き込む)
+ * @param [out] found  キーが見つかったか否か(見つかった場合は1、見つからな
+ *                     かった場合は0)の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数(配列の要素を含む)にNULLが指定された場合
+ *   に返す。
+ *
+ * @remark
+ *   キーが見つからない場合もエラーとはせず、foundで通知する。処理の方式は
+ *   hmap_store_many()と同じ。
+ */
+extern int hmap_fetch_many(hmap_t* ptr,
+                           void* keys[], size_t lens[], size_t n,
+                           void* values[], int found[]);
+
 /**
  * @fn
  *   int hmap_remove(hmap_t* ptr, char* key);
@@ -154,6 +616,43 @@ extern int hmap_fetch(hmap_t* ptr, char* key, void** dst);
  */
 extern int hmap_remove(hmap_t* ptr, char* key);
 
+/**
+ * @fn
+ *   int hmap_remove_bin(hmap_t* ptr, void* key, size_t len);
+ *
+ * @brief  ハッシュマップからの削除(バイナリキー)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  削除対象のキー(任意のバイト列)
+ * @param [in] len  キーのサイズ(バイト数)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   戻り値及びコールバックの扱いはhmap_remove()と同じ。
+ */
+extern int hmap_remove_bin(hmap_t* ptr, void* key, size_t len);
+
+/**
+ * @fn
+ *   int hmap_remove_hashed(hmap_t* ptr, void* key, size_t len, uint64_t hash);
+ *
+ * @brief  ハッシュマップからの削除(算出済みハッシュ値の指定)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  削除対象のキー
+ * @param [in] len  キーのサイズ(バイト数)
+ * @param [in] hash  キーのハッシュ値
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   戻り値及びコールバックの扱いはhmap_remove()と同じ。引数hashに指定する
+ *   値についてはhmap_store_hashed()の説明を参照のこと。
+ */
+extern int hmap_remove_hashed(hmap_t* ptr,
+                              void* key, size_t len, uint64_t hash);
+
 /**
  * @fn
  *   int hmap_clear(hmap_t* ptr);
@@ -187,7 +686,28 @@ extern int hmap_clear(hmap_t* ptr);
  * @retval HMAP_ERROR_NULL_POINTER
  *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
  */
-extern int hmap_size(hmap_t* ptr, size_t** dst);
+extern int hmap_size(hmap_t* ptr, size_t* dst);
+
+/**
+ * @fn
+ *   int hmap_stats(hmap_t* ptr, hmap_stats_t* dst);
+ *
+ * @brief  探査長などの統計情報の取得
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [out] dst  統計情報の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @remark
+ *   探査長は登録済みの各エントリを検索する際に比較するバケットの数(本来の
+ *   位置にあれば1)。全バケットを走査するので、処理時間はハッシュマップの
+ *   サイズに比例する。
+ */
+extern int hmap_stats(hmap_t* ptr, hmap_stats_t* dst);
 
 /**
  * @fn
@@ -212,9 +732,253 @@ extern int hmap_size(hmap_t* ptr, size_t** dst);
  */
 extern int hmap_set_callback(hmap_t* ptr, void(*fn)(char*, void*));
 
+/**
+ * @fn
+ *   int hmap_iter(hmap_t* ptr, char** dsk, void** dsv);
+ *
+ * @brief  登録済みエントリの走査
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [out] dsk  キーの書き込み先(NULL可)
+ * @param [out] dsv  値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NOT_FOUND
+ *   走査が終端に達した場合に返す。
+ *
+ * @remark
+ *   拡張可能なハッシュマップでテーブルの拡張途中に呼び出された場合は、残り
+ *   のエントリの移行を完了させてから走査を行う。走査中にhmap_store()で新規
+ *   エントリの追加を行った場合の動作は保証しない。
+ */
 extern int hmap_iter(hmap_t* ptr, char** dsk, void** dsv);
+
+/**
+ * @fn
+ *   int hmap_iter_bin(hmap_t* ptr, void** dsk, size_t* dsz, void** dsv);
+ *
+ * @brief  登録済みエントリの走査(キーのサイズ付き)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [out] dsk  キーの書き込み先(NULL可)
+ * @param [out] dsz  キーのサイズの書き込み先(NULL可)
+ * @param [out] dsv  値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   バイナリキーで保存したエントリを走査する場合に使用する。走査位置は
+ *   hmap_iter()と共有する。
+ */
+extern int hmap_iter_bin(hmap_t* ptr, void** dsk, size_t* dsz, void** dsv);
 extern int hmap_rewind(hmap_t* ptr);
 
+/*
+ * @fn
+ *   int hmap_iter_r(hmap_t* ptr,
+ *                   size_t* pos, void** dsk, size_t* dsz, void** dsv);
+ *
+ * @brief  登録済みエントリの走査(走査位置を呼び出し側で保持)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in,out] pos  走査位置(走査開始時は0を設定しておくこと)
+ * @param [out] dsk  キーの書き込み先(NULL可)
+ * @param [out] dsz  キーのサイズの書き込み先(NULL可)
+ * @param [out] dsv  値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NOT_FOUND
+ *   走査が終端に達した場合に返す。
+ *
+ * @remark
+ *   hmap_iter()と異なりオブジェクト内の走査位置を使用せず、オブジェクトを
+ *   変更しない(リハッシュ中でも移行処理を行わない)ので、複数の走査を同時
+ *   に行うことができる。
+ *
+ * @remark
+ *   走査の途中でハッシュマップを変更した場合、エントリの重複・欠落が発生
+ *   する可能性がある。
+ */
+extern int hmap_iter_r(hmap_t* ptr,
+                       size_t* pos, void** dsk, size_t* dsz, void** dsv);
+
+/*
+ * @fn
+ *   int hmap_freeze(hmap_t* ptr,
+ *                   char* path,
+ *                   int (*fn)(void* val, void** data, size_t* size));
+ *
+ * @brief  ハッシュマップのスナップショットの書き出し
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] path  書き出し先のファイルのパス
+ * @param [in] fn  値のシリアライズ関数(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @retval HMAP_ERROR_IO
+ *   ファイルの書き込みに失敗した場合に返す。
+ *
+ * @remark
+ *   バケット配列とキー及び値の実体を、ファイル先頭からのオフセットで参照
+ *   する形式(アドレスに依存しない形式)で書き出す。書き出したファイルは
+ *   hmap_open_frozen()で読み込み無しに参照できる。
+ *
+ * @remark
+ *   値は引数fnで指定した関数でバイト列に変換して書き出す。関数は値毎に呼
+ *   び出され、dataとsizeに書き出すバイト列を設定して0を返すこと(0以外を返
+ *   した場合は書き出しを中止する)。fnにNULLを指定した場合は、値をNUL終端
+ *   文字列として扱いNUL終端まで含めて書き出す(NULLの値はNULLのまま)。
+ *
+ * @remark
+ *   fnが返したバイト列の領域はfnの所有のままとなる。hmap_freeze()はfnが戻
+ *   った時点でバイト列をファイルに書き出し、その領域を保持も開放もしない。
+ *   このため、fnは次の呼び出しで同じ領域を上書きして使い回してよく(静的な
+ *   バッファでも構わない)、fnが確保した領域はhmap_freeze()から戻った後に
+ *   呼び出し側で開放すること。
+ *
+ * @remark
+ *   一時ファイルに書き出した後にrename()で置き換えるので、書き出し中に他の
+ *   プロセスが古いファイルを参照していても問題ない。ファイルはホストのバイ
+ *   トオーダーで書き出す。ハッシュマップは変更しない。
+ */
+extern int hmap_freeze(hmap_t* ptr,
+                       char* path,
+                       int (*fn)(void* val, void** data, size_t* size));
+
+/*
+ * @fn
+ *   int hmap_open_frozen(char* path, hmap_frozen_t** dst);
+ *
+ * @brief  スナップショットのオープン
+ *
+ * @param [in] path  hmap_freeze()で書き出したファイルのパス
+ * @param [out] dst  オープンしたスナップショットの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @retval HMAP_ERROR_IO
+ *   ファイルのオープンまたはマッピングに失敗した場合に返す。
+ *
+ * @retval HMAP_ERROR_BROKEN
+ *   ファイルの形式が不正な場合(異なるバイトオーダーで書き出された場合を含
+ *   む)に返す。
+ *
+ * @remark
+ *   ファイルを読み出し専用でmmap()し、ヘッダの検証のみを行う。バケット及び
+ *   キー・値の読み込みはページフォルトにより参照時に行われ、同じファイル
+ *   をオープンした複数のプロセスはページキャッシュを共有する。スナップショ
+ *   ットは変更できないので、複数のスレッドから同時に参照できる。
+ */
+extern int hmap_open_frozen(char* path, hmap_frozen_t** dst);
+
+/*
+ * @fn
+ *   int hmap_close_frozen(hmap_frozen_t* ptr);
+ *
+ * @brief  スナップショットのクローズ
+ *
+ * @param [in] ptr  対象のスナップショット
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   クローズ後は、hmap_frozen_fetch()等で取得したキー及び値のアドレスは無効
+ *   となる。
+ */
+extern int hmap_close_frozen(hmap_frozen_t* ptr);
+
+/*
+ * @fn
+ *   int hmap_frozen_fetch(hmap_frozen_t* ptr, char* key, void** dst);
+ *
+ * @brief  スナップショットの読み出し
+ *
+ * @param [in] ptr  対象のスナップショット
+ * @param [in] key  読み出し対象のキー
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval HMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval HMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ *
+ * @remark
+ *   dstにはマッピングされた値のバイト列のアドレス(8バイト境界に整列済み)
+ *   が書き込まれる。この領域は読み出し専用である。メモリの確保は行わない。
+ */
+extern int hmap_frozen_fetch(hmap_frozen_t* ptr, char* key, void** dst);
+
+/*
+ * @fn
+ *   int hmap_frozen_fetch_bin(hmap_frozen_t* ptr,
+ *                             void* key,
+ *                             size_t len,
+ *                             void** dst,
+ *                             size_t* dsz);
+ *
+ * @brief  スナップショットの読み出し(バイナリキー)
+ *
+ * @param [out] dsz  値のサイズの書き込み先(NULL可)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定し、値のサイズも返す以外は
+ *   hmap_frozen_fetch()と同じ。
+ */
+extern int hmap_frozen_fetch_bin(hmap_frozen_t* ptr,
+                                 void* key, size_t len,
+                                 void** dst, size_t* dsz);
+
+/*
+ * @fn
+ *   int hmap_frozen_fetch_hashed(hmap_frozen_t* ptr,
+ *                                void* key,
+ *                                size_t len,
+ *                                uint64_t hash,
+ *                                void** dst,
+ *                                size_t* dsz);
+ *
+ * @brief  スナップショットの読み出し(算出済みハッシュ値の指定)
+ *
+ * @remark
+ *   スナップショットには書き出し時のハッシュマップが保持していたハッシュ値
+ *   がそのまま記録される。hmap_store_hashed()で独自のハッシュ値を指定して保
+ *   存したエントリは、本関数で同じハッシュ値を指定して読み出すこと。ただし
+ *   hmap_hash_fnv1以外のハッシュ関数を使用するハッシュマップを書き出した場
+ *   合は、全てのエントリについてFNV1のハッシュ値を算出し直して記録する。
+ */
+extern int hmap_frozen_fetch_hashed(hmap_frozen_t* ptr,
+                                    void* key, size_t len, uint64_t hash,
+                                    void** dst, size_t* dsz);
+
+/*
+ * @fn
+ *   int hmap_frozen_size(hmap_frozen_t* ptr, size_t* dst);
+ *
+ * @brief  スナップショットのエントリ数の取得
+ */
+extern int hmap_frozen_size(hmap_frozen_t* ptr, size_t* dst);
+
 #ifdef __cplusplus
 }
 #endif /* defined(__cplusplus) */
@@ -0,0 +1,858 @@
+﻿/*
+ * Benchmark for hash map container
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 使い方
+ *
+ *   hmap_bench [-s ORDER] [-l LOADS] [-k KLENS] [-H HITS]
+ *              [-f LAYOUTS] [-x HASHES] [-r SEED]
+ *
+ *     -s ORDER    テーブルサイズ(2^ORDER バケット, デフォルト16)
+ *     -l LOADS    負荷率(%)のリスト(デフォルト 25,50,75,90,95)
+ *     -k KLENS    キー長(バイト, 4〜256)のリスト(デフォルト 4,16,64,256)
+ *     -H HITS     読み出し時のヒット率(%)のリスト(デフォルト 100,50,0)
+ *     -f LAYOUTS  plain,group,backshift,arena,growable から選択(デフォルト全て)
+ *     -x HASHES   fnv1,wy から選択(デフォルト全て)
+ *     -r SEED     キー及びアクセス順の生成に使用する乱数の種
+ *
+ *  結果は一行一測定のCSVで標準出力に書き出す(先頭行はヘッダ)。各列の意味は
+ *  以下のとおり。時間は全てナノ秒。
+ *
+ *     hash,layout,size,load,klen  測定条件
+ *     op        操作の種類(下記)
+ *     hit       fetchのヒット率(%)。それ以外は空欄
+ *     ops       操作回数
+ *     ns_per_op 一操作あたりの時間
+ *     mops      毎秒の操作数(百万単位)
+ *     p50,p99,p999,max
+ *               一操作毎に計測した時間の分布(.lat行とtimer行のみ。それ以外
+ *               は空欄)
+ *
+ *  opの値は以下のとおり。
+ *
+ *     store         登録
+ *     fetch         読み出し(hit列のヒット率で)
+ *     iter          全エントリの走査(opsはエントリ数)
+ *     churn         無作為に選んだキーの削除と新しいキーの追加の対
+ *     churn.window  最も古いキーの削除と新しいキーの追加の対(スライディン
+ *                   グウィンドウ。キャッシュ等のFIFO的な入れ替え)
+ *     remove        削除
+ *     timer         空の区間の計測(計測誤差の目安)
+ *
+ *  上記にサフィックス".lat"の付いた行(store.lat, fetch.lat, churn.lat,
+ *  churn.window.lat, remove.lat)は同じ操作を一操作毎に計測したもので、
+ *  p50〜maxはこの行にのみ出力する。.lat行のns_per_op及びmopsは一操作毎の
+ *  計測値の合計から求めるので、計測誤差(timer行の値程度)を含み、連続実行
+ *  した行の値より大きくなる。サフィックスの無い行は操作全体を一度に計測し
+ *  たもので、スループットの比較にはこちらを使用すること。
+ *
+ *  store.lat及びremove.latは空のハッシュマップへの登録とその全削除を、別
+ *  のハッシュマップで計測する。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hmap.h"
+#include "cronog.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define NALLOC(t,n)         ((t*)malloc(sizeof(t) * (n)))
+
+#define DEFAULT_ORDER       16
+#define MAX_LIST            16
+#define MIN_KEY_LEN         4
+#define MAX_KEY_LEN         256
+
+/*
+ * 測定対象の定義
+ */
+struct layout {
+  const char* name;
+  int flags;
+};
+
+static struct layout layouts[] = {
+  {"plain",     0},
+  {"group",     HMAP_FLAG_GROUP_PROBE},
+  {"backshift", HMAP_FLAG_BACKSHIFT},
+  {"arena",     HMAP_FLAG_ARENA_KEY},
+  {"growable",  HMAP_FLAG_GROWABLE},
+  {NULL,        0},
+};
+
+struct hashfn {
+  const char* name;
+  hmap_hash_t fn;
+};
+
+static struct hashfn hashes[] = {
+  {"fnv1", hmap_hash_fnv1},
+  {"wy",   hmap_hash_wy},
+  {NULL,   NULL},
+};
+
+/*
+ * 測定条件及び作業領域
+ */
+struct config {
+  int order;
+  int loads[MAX_LIST];
+  int nload;
+  int klens[MAX_LIST];
+  int nklen;
+  int hits[MAX_LIST];
+  int nhit;
+  unsigned int layouts;   // 測定対象のlayouts[]のビットマスク
+  unsigned int hashes;    // 測定対象のhashes[]のビットマスク
+  uint64_t seed;
+};
+
+struct bench {
+  cronog_t* cr;
+  uint64_t rng;
+
+  const char* hash;
+  const char* layout;
+  int load;
+
+  /*
+   * キーは2n個を生成し、前半n個を登録用、後半n個を非登録(ミス用)とする。
+   * churnでは削除したキーを空き(free)に回して再利用する。
+   */
+  char* keys;
+  size_t klen;
+  size_t size;
+  size_t n;
+
+  uint32_t* live;     // 登録中のキーの番号(n個)
+  uint32_t* free;     // 未登録のキーの番号のリングバッファ(n個)
+  size_t fhead;
+  uint32_t* seq;      // アクセスするキーの番号の列(n個)
+  int64_t* lat;       // 一操作毎の計測値(n個)
+};
+
+/*
+ * 補助関数
+ */
+static uint64_t
+xorshift(uint64_t* s)
+{
+  uint64_t x;
+
+  x   = *s;
+  x  ^= x << 13;
+  x  ^= x >> 7;
+  x  ^= x << 17;
+  *s  = x;
+
+  return x;
+}
+
+static inline char*
+key_of(struct bench* b, uint32_t i)
+{
+  return b->keys + (size_t)i * b->klen;
+}
+
+/**
+ * @fn
+ *  static void make_keys(struct bench* b)
+ *
+ * @brief キーの生成
+ *
+ * @remark
+ *   先頭4バイトには番号を全単射で撹拌した値を置いて一意性を保証し、残りは
+ *   乱数で埋める。
+ */
+static void
+make_keys(struct bench* b)
+{
+  uint32_t i;
+  uint32_t h;
+  uint64_t s;
+  size_t j;
+  char* k;
+
+  for (i = 0; i < b->n * 2; i++) {
+    k  = key_of(b, i);
+
+    h  = i * 0x9e3779b1U;
+    h ^= h >> 16;
+    memcpy(k, &h, sizeof(h));
+
+    s = (uint64_t)i * 0x9e3779b97f4a7c15ULL + b->rng;
+    if (s == 0) s = 1;
+
+    for (j = sizeof(h); j < b->klen; j++) k[j] = (char)xorshift(&s);
+  }
+}
+
+static void
+shuffle(struct bench* b, uint32_t* a, size_t n)
+{
+  size_t i;
+  size_t j;
+  uint32_t t;
+
+  for (i = n; i > 1; i--) {
+    j        = xorshift(&b->rng) % i;
+    t        = a[i - 1];
+    a[i - 1] = a[j];
+    a[j]     = t;
+  }
+}
+
+static int
+cmp_lat(const void* a, const void* b)
+{
+  int64_t x = *(const int64_t*)a;
+  int64_t y = *(const int64_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+static int64_t
+lap(cronog_t* cr)
+{
+  int64_t ret;
+
+  cronog_stop(cr);
+  cronog_result_ns(cr, &ret);
+  cronog_reset(cr);
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static void report(struct bench* b,
+ *                     const char* op, int hit, size_t ops,
+ *                     int64_t total, int64_t* lat)
+ *
+ * @brief 測定結果の出力
+ *
+ * @remark
+ *   latがNULLでない場合はops個の計測値を整列して分布を出力する(latの内容
+ *   は破壊される)。hitが負の場合はヒット率の欄を空欄とする。
+ */
+static void
+report(struct bench* b,
+       const char* op, int hit, size_t ops, int64_t total, int64_t* lat)
+{
+  printf("%s,%s,%zu,%d,%zu,%s,", b->hash, b->layout, b->size, b->load,
+         b->klen, op);
+
+  if (hit >= 0) printf("%d", hit);
+
+  printf(",%zu,%.2f,%.3f,", ops,
+         (ops > 0)? (double)total / ops: 0.0,
+         (total > 0)? (double)ops * 1000.0 / total: 0.0);
+
+  if (lat != NULL && ops > 0) {
+    qsort(lat, ops, sizeof(*lat), cmp_lat);
+
+    printf("%lld,%lld,%lld,%lld\n",
+           (long long)lat[ops / 2],
+           (long long)lat[(ops - 1) * 99 / 100],
+           (long long)lat[(ops - 1) * 999 / 1000],
+           (long long)lat[ops - 1]);
+  } else {
+    printf(",,,\n");
+  }
+}
+
+/*
+ * 各操作の測定
+ *
+ *  いずれもlatがNULLの場合は全体の時間を、そうでない場合は一操作毎の時間を
+ *  計測する。戻り値は全体の時間(一操作毎の計測時は計測値の合計)。
+ */
+static int64_t
+run_store(struct bench* b, hmap_t* map, int64_t* lat)
+{
+  int64_t ret;
+  size_t i;
+  uint32_t k;
+
+  ret = 0;
+
+  if (lat == NULL) {
+    cronog_measure_ns(b->cr, &ret) {
+      for (i = 0; i < b->n; i++) {
+        k = b->live[i];
+        if (hmap_store_bin(map, key_of(b, k), b->klen, (void*)(uintptr_t)(k + 1))) {
+          fprintf(stderr, "store failed\n");
+          exit(1);
+        }
+      }
+    }
+
+  } else {
+    for (i = 0; i < b->n; i++) {
+      k = b->live[i];
+      cronog_start(b->cr);
+      hmap_store_bin(map, key_of(b, k), b->klen, (void*)(uintptr_t)(k + 1));
+      ret += (lat[i] = lap(b->cr));
+    }
+  }
+
+  return ret;
+}
+
+static int64_t
+run_fetch(struct bench* b, hmap_t* map, int64_t* lat, size_t* hit)
+{
+  int64_t ret;
+  size_t i;
+  void* val;
+
+  ret  = 0;
+  *hit = 0;
+
+  if (lat == NULL) {
+    cronog_measure_ns(b->cr, &ret) {
+      for (i = 0; i < b->n; i++) {
+        if (!hmap_fetch_bin(map, key_of(b, b->seq[i]), b->klen, &val)) (*hit)++;
+      }
+    }
+
+  } else {
+    for (i = 0; i < b->n; i++) {
+      cronog_start(b->cr);
+      if (!hmap_fetch_bin(map, key_of(b, b->seq[i]), b->klen, &val)) (*hit)++;
+      ret += (lat[i] = lap(b->cr));
+    }
+  }
+
+  return ret;
+}
+
+static int64_t
+run_iter(struct bench* b, hmap_t* map, size_t* cnt)
+{
+  int64_t ret;
+  size_t pos;
+  void* key;
+  size_t ksz;
+  void* val;
+
+  ret  = 0;
+  pos  = 0;
+  *cnt = 0;
+
+  cronog_measure_ns(b->cr, &ret) {
+    while (!hmap_iter_r(map, &pos, &key, &ksz, &val)) (*cnt)++;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int64_t run_churn(struct bench* b, hmap_t* map, int64_t* lat,
+ *                           int window)
+ *
+ * @brief 削除と追加の繰り返しの測定
+ *
+ * @remark
+ *   登録中のキーを一つ削除し、未登録のキーを一つ追加する操作をn回行う(エン
+ *   トリ数は一定に保たれる)。windowが0の場合は削除するキーを無作為に選ぶ。
+ *   0以外の場合は最も古いキーから順に削除する(liveは登録順に並んでおり、
+ *   追加したキーは削除したキーの位置に置くので、n回の操作の後も登録順に並
+ *   んだままとなる)。
+ */
+static int64_t
+run_churn(struct bench* b, hmap_t* map, int64_t* lat, int window)
+{
+  int64_t ret;
+  size_t i;
+  size_t j;
+  uint32_t k;
+  uint32_t* pick;
+
+  ret  = 0;
+  pick = b->seq;
+
+  // 削除対象の位置は計測前に決めておく
+  for (i = 0; i < b->n; i++) {
+    pick[i] = (window)? (uint32_t)i: (uint32_t)(xorshift(&b->rng) % b->n);
+  }
+
+#define CHURN_STEP() \
+  do { \
+    j = pick[i]; \
+    hmap_remove_bin(map, key_of(b, b->live[j]), b->klen); \
+    k = b->free[b->fhead]; \
+    b->free[b->fhead] = b->live[j]; \
+    b->fhead = (b->fhead + 1) % b->n; \
+    b->live[j] = k; \
+    if (hmap_store_bin(map, key_of(b, k), b->klen, (void*)(uintptr_t)(k + 1))) { \
+      fprintf(stderr, "store failed\n"); \
+      exit(1); \
+    } \
+  } while (0)
+
+  if (lat == NULL) {
+    cronog_measure_ns(b->cr, &ret) {
+      for (i = 0; i < b->n; i++) CHURN_STEP();
+    }
+
+  } else {
+    for (i = 0; i < b->n; i++) {
+      cronog_start(b->cr);
+      CHURN_STEP();
+      ret += (lat[i] = lap(b->cr));
+    }
+  }
+
+#undef CHURN_STEP
+
+  return ret;
+}
+
+static int64_t
+run_remove(struct bench* b, hmap_t* map, int64_t* lat)
+{
+  int64_t ret;
+  size_t i;
+
+  ret = 0;
+
+  if (lat == NULL) {
+    cronog_measure_ns(b->cr, &ret) {
+      for (i = 0; i < b->n; i++) {
+        hmap_remove_bin(map, key_of(b, b->live[i]), b->klen);
+      }
+    }
+
+  } else {
+    for (i = 0; i < b->n; i++) {
+      cronog_start(b->cr);
+      hmap_remove_bin(map, key_of(b, b->live[i]), b->klen);
+      ret += (lat[i] = lap(b->cr));
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static void make_fetch_seq(struct bench* b, int hit)
+ *
+ * @brief 読み出し順の生成
+ *
+ * @remark
+ *   hit%の確率で登録中のキーを、それ以外は未登録のキーを無作為に選ぶ。
+ */
+static void
+make_fetch_seq(struct bench* b, int hit)
+{
+  size_t i;
+
+  for (i = 0; i < b->n; i++) {
+    if ((int)(xorshift(&b->rng) % 100) < hit) {
+      b->seq[i] = b->live[xorshift(&b->rng) % b->n];
+    } else {
+      b->seq[i] = b->free[xorshift(&b->rng) % b->n];
+    }
+  }
+}
+
+static int
+new_map(struct bench* b, struct layout* ly, struct hashfn* hf, hmap_t** dst)
+{
+  int ret;
+
+  if (ly->flags & HMAP_FLAG_GROWABLE) {
+    ret = hmap_new3(16, ly->flags, hf->fn, dst);
+    if (!ret) ret = hmap_set_max_load(*dst, b->load / 100.0);
+
+  } else {
+    ret = hmap_new3(b->size, ly->flags, hf->fn, dst);
+  }
+
+  return ret;
+}
+
+static void
+reset_keys(struct bench* b)
+{
+  uint32_t i;
+
+  for (i = 0; i < b->n; i++) {
+    b->live[i] = i;
+    b->free[i] = b->n + i;
+  }
+
+  b->fhead = 0;
+  shuffle(b, b->live, b->n);
+}
+
+/**
+ * @fn
+ *  static int run_case(struct bench* b, struct config* cfg,
+ *                      struct layout* ly, struct hashfn* hf)
+ *
+ * @brief 一つの条件(ハッシュ関数、レイアウト、負荷率、キー長)の測定
+ */
+static int
+run_case(struct bench* b, struct config* cfg,
+         struct layout* ly, struct hashfn* hf)
+{
+  int ret;
+  int i;
+  hmap_t* map;
+  size_t cnt;
+  int64_t t;
+
+  /*
+   * initialize
+   */
+  ret       = 0;
+  map       = NULL;
+  b->hash   = hf->name;
+  b->layout = ly->name;
+
+  reset_keys(b);
+
+  /*
+   * 連続実行の測定(store, fetch, iter, churn.window, churn, remove)
+   */
+  if (!ret) ret = new_map(b, ly, hf, &map);
+
+  if (!ret) {
+    t = run_store(b, map, NULL);
+    report(b, "store", -1, b->n, t, NULL);
+
+    for (i = 0; i < cfg->nhit; i++) {
+      make_fetch_seq(b, cfg->hits[i]);
+
+      t = run_fetch(b, map, NULL, &cnt);
+      report(b, "fetch", cfg->hits[i], b->n, t, NULL);
+
+      t = run_fetch(b, map, b->lat, &cnt);
+      report(b, "fetch.lat", cfg->hits[i], b->n, t, b->lat);
+    }
+
+    t = run_iter(b, map, &cnt);
+    if (cnt != b->n) {
+      fprintf(stderr, "iterate count mismatch (%zu != %zu)\n", cnt, b->n);
+      ret = DEFAULT_ERROR;
+    }
+
+    report(b, "iter", -1, cnt, t, NULL);
+  }
+
+  /*
+   * churn.windowはliveが登録順に並んでいる間に行う
+   */
+  if (!ret) {
+    t = run_churn(b, map, NULL, !0);
+    report(b, "churn.window", -1, b->n, t, NULL);
+
+    t = run_churn(b, map, b->lat, !0);
+    report(b, "churn.window.lat", -1, b->n, t, b->lat);
+  }
+
+  if (!ret) {
+    t = run_churn(b, map, NULL, 0);
+    report(b, "churn", -1, b->n, t, NULL);
+
+    t = run_churn(b, map, b->lat, 0);
+    report(b, "churn.lat", -1, b->n, t, b->lat);
+
+    shuffle(b, b->live, b->n);
+    t = run_remove(b, map, NULL);
+    report(b, "remove", -1, b->n, t, NULL);
+  }
+
+  if (map != NULL) {
+    hmap_destroy(map);
+    map = NULL;
+  }
+
+  /*
+   * 一操作毎の計測(store, remove)は新しいハッシュマップで行う
+   */
+  if (!ret) {
+    reset_keys(b);
+    ret = new_map(b, ly, hf, &map);
+  }
+
+  if (!ret) {
+    t = run_store(b, map, b->lat);
+    report(b, "store.lat", -1, b->n, t, b->lat);
+
+    shuffle(b, b->live, b->n);
+    t = run_remove(b, map, b->lat);
+    report(b, "remove.lat", -1, b->n, t, b->lat);
+  }
+
+  if (map != NULL) hmap_destroy(map);
+
+  return ret;
+}
+
+static void
+run_timer(struct bench* b)
+{
+  size_t i;
+  int64_t t;
+
+  t = 0;
+
+  for (i = 0; i < b->n; i++) {
+    cronog_start(b->cr);
+    t += (b->lat[i] = lap(b->cr));
+  }
+
+  b->hash   = "-";
+  b->layout = "-";
+  b->load   = 0;
+  report(b, "timer", -1, b->n, t, b->lat);
+}
+
+/*
+ * 引数の解析
+ */
+static int
+parse_list(char* s, int* dst, int max, int lo, int hi)
+{
+  int ret;
+  char* tok;
+  char* sp;
+  long v;
+
+  ret = 0;
+
+  for (tok = strtok_r(s, ",", &sp); tok != NULL; tok = strtok_r(NULL, ",", &sp)) {
+    v = strtol(tok, NULL, 10);
+    if (ret >= max || v < lo || v > hi) return -1;
+
+    dst[ret++] = (int)v;
+  }
+
+  return ret;
+}
+
+static int
+parse_layouts(char* s, unsigned int* dst)
+{
+  char* tok;
+  char* sp;
+  int i;
+
+  *dst = 0;
+
+  for (tok = strtok_r(s, ",", &sp); tok != NULL; tok = strtok_r(NULL, ",", &sp)) {
+    for (i = 0; layouts[i].name != NULL; i++) {
+      if (!strcmp(tok, layouts[i].name)) break;
+    }
+
+    if (layouts[i].name == NULL) return -1;
+    *dst |= 1U << i;
+  }
+
+  return (*dst != 0)? 0: -1;
+}
+
+static int
+parse_hashes(char* s, unsigned int* dst)
+{
+  char* tok;
+  char* sp;
+  int i;
+
+  *dst = 0;
+
+  for (tok = strtok_r(s, ",", &sp); tok != NULL; tok = strtok_r(NULL, ",", &sp)) {
+    for (i = 0; hashes[i].name != NULL; i++) {
+      if (!strcmp(tok, hashes[i].name)) break;
+    }
+
+    if (hashes[i].name == NULL) return -1;
+    *dst |= 1U << i;
+  }
+
+  return (*dst != 0)? 0: -1;
+}
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr,
+          "usage: %s [-s ORDER] [-l LOADS] [-k KLENS] [-H HITS]"
+          " [-f LAYOUTS] [-x HASHES] [-r SEED]\n", prog);
+}
+
+int
+main(int argc, char* argv[])
+{
+  int ret;
+  int opt;
+  struct config cfg;
+  struct bench b;
+  size_t nmax;
+  int li;
+  int ki;
+  int i;
+  int j;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  memset(&b, 0, sizeof(b));
+
+  cfg.order    = DEFAULT_ORDER;
+  cfg.nload    = parse_list((char[]){"25,50,75,90,95"}, cfg.loads, MAX_LIST, 1, 100);
+  cfg.nklen    = parse_list((char[]){"4,16,64,256"}, cfg.klens, MAX_LIST,
+                            MIN_KEY_LEN, MAX_KEY_LEN);
+  cfg.nhit     = parse_list((char[]){"100,50,0"}, cfg.hits, MAX_LIST, 0, 100);
+  cfg.layouts  = (1U << (sizeof(layouts) / sizeof(layouts[0]) - 1)) - 1;
+  cfg.hashes   = (1U << (sizeof(hashes) / sizeof(hashes[0]) - 1)) - 1;
+  cfg.seed     = 0x2545f4914f6cdd1dULL;
+
+  /*
+   * parse arguments
+   */
+  while (!ret && (opt = getopt(argc, argv, "s:l:k:H:f:x:r:h")) != -1) {
+    switch (opt) {
+    case 's':
+      cfg.order = atoi(optarg);
+      if (cfg.order < 4 || cfg.order > 28) ret = DEFAULT_ERROR;
+      break;
+
+    case 'l':
+      cfg.nload = parse_list(optarg, cfg.loads, MAX_LIST, 1, 100);
+      if (cfg.nload <= 0) ret = DEFAULT_ERROR;
+      break;
+
+    case 'k':
+      cfg.nklen = parse_list(optarg, cfg.klens, MAX_LIST,
+                             MIN_KEY_LEN, MAX_KEY_LEN);
+      if (cfg.nklen <= 0) ret = DEFAULT_ERROR;
+      break;
+
+    case 'H':
+      cfg.nhit = parse_list(optarg, cfg.hits, MAX_LIST, 0, 100);
+      if (cfg.nhit <= 0) ret = DEFAULT_ERROR;
+      break;
+
+    case 'f':
+      if (parse_layouts(optarg, &cfg.layouts)) ret = DEFAULT_ERROR;
+      break;
+
+    case 'x':
+      if (parse_hashes(optarg, &cfg.hashes)) ret = DEFAULT_ERROR;
+      break;
+
+    case 'r':
+      cfg.seed = strtoull(optarg, NULL, 0);
+      if (cfg.seed == 0) cfg.seed = 1;
+      break;
+
+    default:
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  }
+
+  if (ret) usage(argv[0]);
+
+  /*
+   * memory allocate
+   *
+   *  作業領域は最大の負荷率及びキー長に合わせて確保する。
+   */
+  if (!ret) do {
+    b.size = (size_t)1 << cfg.order;
+    nmax   = 0;
+
+    for (i = 0; i < cfg.nload; i++) {
+      if (b.size * cfg.loads[i] / 100 > nmax) nmax = b.size * cfg.loads[i] / 100;
+    }
+
+    if (nmax == 0) nmax = 1;
+
+    b.klen = 0;
+    for (i = 0; i < cfg.nklen; i++) {
+      if ((size_t)cfg.klens[i] > b.klen) b.klen = cfg.klens[i];
+    }
+
+    b.keys = NALLOC(char, nmax * 2 * b.klen);
+    b.live = NALLOC(uint32_t, nmax);
+    b.free = NALLOC(uint32_t, nmax);
+    b.seq  = NALLOC(uint32_t, nmax);
+    b.lat  = NALLOC(int64_t, nmax);
+
+    if (!b.keys || !b.live || !b.free || !b.seq || !b.lat) {
+      fprintf(stderr, "memory allocation failed\n");
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (cronog_new(&b.cr)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * run benchmark
+   */
+  if (!ret) {
+    printf("hash,layout,size,load,klen,op,hit,ops,ns_per_op,mops,"
+           "p50,p99,p999,max\n");
+
+    b.rng  = cfg.seed;
+    b.n    = nmax;
+    b.klen = MIN_KEY_LEN;
+    run_timer(&b);
+  }
+
+  for (li = 0; !ret && li < cfg.nload; li++) {
+    for (ki = 0; !ret && ki < cfg.nklen; ki++) {
+      b.load = cfg.loads[li];
+      b.klen = cfg.klens[ki];
+      b.n    = b.size * b.load / 100;
+      b.rng  = cfg.seed;
+
+      if (b.n == 0) continue;
+
+      make_keys(&b);
+
+      for (i = 0; !ret && hashes[i].name != NULL; i++) {
+        if (!(cfg.hashes & (1U << i))) continue;
+
+        for (j = 0; !ret && layouts[j].name != NULL; j++) {
+          if (!(cfg.layouts & (1U << j))) continue;
+
+          ret = run_case(&b, &cfg, layouts + j, hashes + i);
+          fflush(stdout);
+        }
+      }
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (b.cr != NULL) cronog_destroy(b.cr);
+  if (b.keys != NULL) free(b.keys);
+  if (b.live != NULL) free(b.live);
+  if (b.free != NULL) free(b.free);
+  if (b.seq != NULL) free(b.seq);
+  if (b.lat != NULL) free(b.lat);
+
+  return (ret)? 1: 0;
+}
@@ -0,0 +1,567 @@
+﻿/*
+ * String interning table
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hmap.h"
+#include "intern.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define ALLOC(t)            ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)         ((t*)malloc(sizeof(t) * (n)))
+
+#define CHUNK_SIZE          (64 * 1024)
+#define MIN_MAP_SIZE        64
+#define MIN_TABLE_SIZE      64
+#define MAX_ID              (UINT32_MAX - 1)
+#define ALIGN(n)            (((n) + 7) & ~((size_t)7))
+
+/*
+ * 構造体の定義
+ *
+ *  文字列の実体はチャンク単位で確保するアリーナに詰めて配置する。各実体の
+ *  直前にはヘッダ(IDとサイズ)を置き、実体のアドレスからIDを引けるように
+ *  する。ハッシュマップはHMAP_FLAG_EXTERN_KEYでアリーナ上の実体をそのまま
+ *  キーとして参照し、値にIDを格納する。
+ */
+struct chunk {
+  struct chunk* next;
+  size_t used;
+  size_t size;
+  char data[] __attribute__((aligned(8)));
+};
+
+struct entry {
+  uint32_t id;
+  uint32_t len;
+  char str[];
+};
+
+struct __intern_t__ {
+  hmap_t* map;
+  struct chunk* chunk;      // 現在割り当て中のチャンク(リストの先頭)
+
+  struct entry** tbl;       // ID→実体の表
+  size_t used;
+  size_t capa;
+};
+
+/*
+ * 内部処理用の非公開関数の定義
+ */
+/**
+ * @fn
+ *  static struct entry* arena_alloc(intern_t* ptr, size_t len)
+ *
+ * @brief アリーナからのエントリ領域の確保
+ *
+ * @remark
+ *   現在のチャンクに収まらない場合は新しいチャンクを確保する。チャンクサイ
+ *   ズを超える大きさの要求は専用のチャンクで確保する(この場合でも現在の
+ *   チャンクの残りは以後の要求で引き続き使用する)。
+ */
+static struct entry*
+arena_alloc(intern_t* ptr, size_t len)
+{
+  struct entry* ret;
+  struct chunk* ck;
+  size_t need;
+
+  need = ALIGN(sizeof(struct entry) + len + 1);
+  ck   = ptr->chunk;
+
+  if (ck == NULL || ck->size - ck->used < need) {
+    size_t size;
+
+    size = (need > CHUNK_SIZE)? need: CHUNK_SIZE;
+    ck   = (struct chunk*)malloc(sizeof(struct chunk) + size);
+    if (ck == NULL) return NULL;
+
+    ck->used = 0;
+    ck->size = size;
+
+    if (need > CHUNK_SIZE && ptr->chunk != NULL) {
+      ck->next         = ptr->chunk->next;
+      ptr->chunk->next = ck;
+    } else {
+      ck->next   = ptr->chunk;
+      ptr->chunk = ck;
+    }
+  }
+
+  ret       = (struct entry*)(ck->data + ck->used);
+  ck->used += need;
+
+  return ret;
+}
+
+static int
+grow_table(intern_t* ptr)
+{
+  struct entry** tbl;
+  size_t capa;
+
+  capa = (ptr->capa > 0)? ptr->capa * 2: MIN_TABLE_SIZE;
+  tbl  = (struct entry**)realloc(ptr->tbl, sizeof(struct entry*) * capa);
+  if (tbl == NULL) return INTERN_ERROR_NO_MEMORY;
+
+  ptr->tbl  = tbl;
+  ptr->capa = capa;
+
+  return 0;
+}
+
+/**
+ * @fn
+ *  static int intern_entry(intern_t* ptr,
+ *                          void* data, size_t len, struct entry** dst)
+ *
+ * @brief 実体の検索及び登録
+ *
+ * @remark
+ *   ハッシュ値は一度だけ計算し、検索と登録の双方で使い回す。未登録の場合は
+ *   アリーナに複製を作成してから、その複製をキーとしてハッシュマップに登録
+ *   する。
+ */
+static int
+intern_entry(intern_t* ptr, void* data, size_t len, struct entry** dst)
+{
+  int ret;
+  int err;
+  uint64_t hv;
+  void* val;
+  struct entry* ent;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ent = NULL;
+
+  hmap_hash(ptr->map, data, len, &hv);
+
+  /*
+   * search entry
+   */
+  err = hmap_fetch_hashed(ptr->map, data, len, hv, &val);
+  if (!err) {
+    ent = ptr->tbl[(uintptr_t)val];
+
+  } else if (err != HMAP_ERROR_NOT_FOUND) {
+    ret = INTERN_ERROR_NO_MEMORY;
+
+  } else do {
+    /*
+     * 未登録の場合は新規に登録
+     */
+    if (ptr->used > MAX_ID) {
+      ret = INTERN_ERROR_OUT_OF_RANGE;
+      break;
+    }
+
+    if (ptr->used == ptr->capa) {
+      ret = grow_table(ptr);
+      if (ret) break;
+    }
+
+    ent = arena_alloc(ptr, len);
+    if (ent == NULL) {
+      ret = INTERN_ERROR_NO_MEMORY;
+      break;
+    }
+
+    ent->id  = (uint32_t)ptr->used;
+    ent->len = (uint32_t)len;
+    memcpy(ent->str, data, len);
+    ent->str[len] = '\0';
+
+    err = hmap_store_hashed(ptr->map,
+                            ent->str, len, hv, (void*)(uintptr_t)ent->id);
+    if (err) {
+      /*
+       * アリーナ上の領域は回収しない(IDも発行しないので参照されることは
+       * ない)
+       */
+      ret = INTERN_ERROR_NO_MEMORY;
+      break;
+    }
+
+    ptr->tbl[ptr->used++] = ent;
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = ent;
+
+  return ret;
+}
+
+/*
+ * 公開関数の定義
+ */
+int
+intern_new(intern_t** dst)
+{
+  int ret;
+  intern_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = INTERN_ERROR_NULL_POINTER;
+
+  /*
+   * memory allocate
+   */
+  if (!ret) do {
+    obj = ALLOC(intern_t);
+    if (obj == NULL) {
+      ret = INTERN_ERROR_NO_MEMORY;
+      break;
+    }
+
+    if (hmap_new3(MIN_MAP_SIZE, HMAP_FLAG_GROWABLE|HMAP_FLAG_EXTERN_KEY,
+                  hmap_hash_wy, &obj->map)) {
+      ret = INTERN_ERROR_NO_MEMORY;
+      break;
+    }
+  } while (0);
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->chunk = NULL;
+    obj->tbl   = NULL;
+    obj->used  = 0;
+    obj->capa  = 0;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+intern_destroy(intern_t* ptr)
+{
+  int ret;
+  struct chunk* ck;
+  struct chunk* next;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = INTERN_ERROR_NULL_POINTER;
+
+  /*
+   * release resources
+   *
+   *  ハッシュマップのキーはアリーナ上にあるので、ハッシュマップを先に破棄
+   *  する。
+   */
+  if (!ret) {
+    hmap_destroy(ptr->map);
+
+    for (ck = ptr->chunk; ck != NULL; ck = next) {
+      next = ck->next;
+      free(ck);
+    }
+
+    if (ptr->tbl != NULL) free(ptr->tbl);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+intern_string(intern_t* ptr, char* str, const char** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (str == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * intern string
+   */
+  if (!ret) ret = intern_bin(ptr, str, strlen(str), NULL, dst);
+
+  return ret;
+}
+
+int
+intern_bin(intern_t* ptr,
+           void* data, size_t len, uint32_t* dsi, const char** dst)
+{
+  int ret;
+  struct entry* ent;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (data == NULL && len > 0) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (len > UINT32_MAX) {
+      ret = INTERN_ERROR_OUT_OF_RANGE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * intern data
+   */
+  if (!ret) ret = intern_entry(ptr, (data != NULL)? data: "", len, &ent);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsi != NULL) *dsi = ent->id;
+    if (dst != NULL) *dst = ent->str;
+  }
+
+  return ret;
+}
+
+int
+intern_lookup(intern_t* ptr, void* data, size_t len, uint32_t* dst)
+{
+  int ret;
+  int err;
+  void* val;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (data == NULL && len > 0) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * search entry
+   */
+  if (!ret) {
+    if (data == NULL) data = "";
+
+    err = hmap_fetch_bin(ptr->map, data, len, &val);
+    if (err) ret = INTERN_ERROR_NOT_FOUND;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = (uint32_t)(uintptr_t)val;
+
+  return ret;
+}
+
+int
+intern_name(intern_t* ptr, uint32_t id, const char** dst, size_t* dsz)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (id >= ptr->used) {
+      ret = INTERN_ERROR_OUT_OF_RANGE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr->tbl[id]->str;
+    if (dsz != NULL) *dsz = ptr->tbl[id]->len;
+  }
+
+  return ret;
+}
+
+int
+intern_id_of(intern_t* ptr, const char* str, uint32_t* dst)
+{
+  int ret;
+  struct entry* ent;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (str == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * read header
+   *
+   *  ヘッダのIDで引いた表の内容が一致することを確認し、明らかに無関係な
+   *  アドレスが渡された場合は検出する。
+   */
+  if (!ret) {
+    ent = (struct entry*)(str - offsetof(struct entry, str));
+
+    if (ent->id >= ptr->used || ptr->tbl[ent->id] != ent) {
+      ret = INTERN_ERROR_NOT_FOUND;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = ent->id;
+
+  return ret;
+}
+
+int
+intern_size(intern_t* ptr, size_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = INTERN_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = ptr->used;
+
+  return ret;
+}
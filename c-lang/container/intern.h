@@ -0,0 +1,197 @@
+﻿/*
+ * String interning table
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __STRING_INTERN_H__
+#define __STRING_INTERN_H__
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct __intern_t__ intern_t;
+
+#define INTERN_ERROR_OUT_OF_RANGE   (-1)
+#define INTERN_ERROR_NULL_POINTER   (-3)
+#define INTERN_ERROR_NO_MEMORY      (-4)
+#define INTERN_ERROR_NOT_FOUND      (-7)
+
+/*
+ * @fn
+ *   int intern_new(intern_t** dst);
+ *
+ * @brief  インターンテーブルの生成
+ *
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval INTERN_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @remark
+ *   本オブジェクトは同じ内容の文字列(バイト列)を一つの実体にまとめ、実体の
+ *   アドレスと登録順に振られる32bitのID(0から始まる連番)を返す。同じ内容で
+ *   あれば常に同じアドレス及びIDが返るので、登録済み文字列同士の比較はアド
+ *   レスまたはIDの比較で行える。
+ *
+ * @remark
+ *   実体はオブジェクト内部のアリーナにまとめて確保し、個別の開放は行わない。
+ *   返したアドレスはintern_destroy()を呼び出すまで有効であり、以後の登録で
+ *   移動することはない。
+ */
+extern int intern_new(intern_t** dst);
+
+/*
+ * @fn
+ *   int intern_destroy(intern_t* ptr);
+ *
+ * @brief  インターンテーブルの破棄
+ *
+ * @param [in] ptr  破棄対象のオブジェクト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   登録済みの全ての文字列の実体も開放される。
+ */
+extern int intern_destroy(intern_t* ptr);
+
+/*
+ * @fn
+ *   int intern_string(intern_t* ptr, char* str, const char** dst);
+ *
+ * @brief  文字列の登録
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] str  登録する文字列(NUL終端文字列)
+ * @param [out] dst  登録された実体のアドレスの書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval INTERN_ERROR_NO_MEMORY
+ *   メモリ確保に失敗した場合に返す。
+ *
+ * @retval INTERN_ERROR_OUT_OF_RANGE
+ *   登録数がIDの上限に達した場合に返す。
+ *
+ * @remark
+ *   登録済みの文字列であれば、既存の実体のアドレスを返す。
+ */
+extern int intern_string(intern_t* ptr, char* str, const char** dst);
+
+/*
+ * @fn
+ *   int intern_bin(intern_t* ptr,
+ *                  void* data, size_t len, uint32_t* dsi, const char** dst);
+ *
+ * @brief  バイト列の登録
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] data  登録するバイト列
+ * @param [in] len  登録するバイト列のサイズ
+ * @param [out] dsi  IDの書き込み先(NULL可)
+ * @param [out] dst  登録された実体のアドレスの書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_OUT_OF_RANGE
+ *   引数lenが32bitで表現できない場合、または登録数がIDの上限に達した場合に
+ *   返す。
+ *
+ * @remark
+ *   バイト列をアドレスとサイズで指定し、IDも返す以外はintern_string()と同
+ *   じ。実体の末尾には常にNULが付加されるので、NULを含まないバイト列であれ
+ *   ばそのままNUL終端文字列として扱える。
+ */
+extern int intern_bin(intern_t* ptr,
+                      void* data, size_t len, uint32_t* dsi, const char** dst);
+
+/*
+ * @fn
+ *   int intern_lookup(intern_t* ptr, void* data, size_t len, uint32_t* dst);
+ *
+ * @brief  登録済みバイト列のIDの検索
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] data  検索するバイト列
+ * @param [in] len  検索するバイト列のサイズ
+ * @param [out] dst  IDの書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_NOT_FOUND
+ *   指定されたバイト列が登録されていない場合に返す。
+ *
+ * @remark
+ *   intern_bin()と異なり、未登録の場合に登録は行わない。
+ */
+extern int intern_lookup(intern_t* ptr, void* data, size_t len, uint32_t* dst);
+
+/*
+ * @fn
+ *   int intern_name(intern_t* ptr, uint32_t id, const char** dst, size_t* dsz);
+ *
+ * @brief  IDに対応する実体の取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] id  対象のID
+ * @param [out] dst  実体のアドレスの書き込み先
+ * @param [out] dsz  実体のサイズ(末尾のNULを含まない)の書き込み先(NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_OUT_OF_RANGE
+ *   未発行のIDを指定した場合に返す。
+ */
+extern int intern_name(intern_t* ptr,
+                       uint32_t id, const char** dst, size_t* dsz);
+
+/*
+ * @fn
+ *   int intern_id_of(intern_t* ptr, const char* str, uint32_t* dst);
+ *
+ * @brief  実体のアドレスからのIDの取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] str  intern_string()等で取得した実体のアドレス
+ * @param [out] dst  IDの書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval INTERN_ERROR_NOT_FOUND
+ *   引数strが本オブジェクトの返した実体のアドレスではない場合に返す。
+ *
+ * @remark
+ *   ハッシュ計算や検索は行わず、実体の直前に置かれたIDを読み出す。このた
+ *   め引数strには本オブジェクトが返したアドレスのみを指定すること(他のオブ
+ *   ジェクトのアドレスを指定した場合の動作は保証しない)。
+ */
+extern int intern_id_of(intern_t* ptr, const char* str, uint32_t* dst);
+
+/*
+ * @fn
+ *   int intern_size(intern_t* ptr, size_t* dst);
+ *
+ * @brief  登録済み文字列数の取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [out] dst  登録されている文字列の数の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ */
+extern int intern_size(intern_t* ptr, size_t* dst);
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+#endif /* !defined(__STRING_INTERN_H__) */
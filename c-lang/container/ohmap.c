@@ -0,0 +1,1030 @@
+﻿/*
+ * Ordered hash map container (compact layout)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ohmap.h"
+#include "hmap.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define ALLOC(t)            ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)         ((t*)malloc(sizeof(t)*(n)))
+
+#define MIN_INDEX_SIZE      8
+#define PERTURB_SHIFT       5
+
+/*
+ * インデックステーブルの値
+ *
+ *  0以上の値はエントリ配列の添字を表す。
+ */
+#define IX_EMPTY            (-1)
+#define IX_REMOVED          (-2)
+
+/*
+ * エントリ配列の容量(インデックステーブルのサイズの2/3)
+ */
+#define USABLE(n)           (((n) * 2) / 3)
+
+/*
+ * 構造体の定義
+ */
+struct entry {
+  uint64_t hash;
+  char* key;          // 削除済みのエントリはNULL
+  size_t ksz;
+  void* val;
+};
+
+struct __ohmap_t__ {
+  void* index;        // インデックステーブル(要素はwidthバイトの符号付整数)
+  int width;
+  size_t isize;
+  size_t mask;
+
+  struct entry* entry;
+  size_t ecapa;
+  size_t nentry;      // エントリ配列の使用済み要素数(削除済みを含む)
+
+  size_t used;
+  size_t pos;
+
+  void (*fn)(char*, void*);
+};
+
+/*
+ * 内部処理用の非公開関数の定義
+ */
+/**
+ * @fn
+ *  static int index_width(size_t size)
+ *
+ * @brief インデックステーブルの要素サイズの決定
+ *
+ * @param [in] size  インデックステーブルのサイズ
+ *
+ * @return 要素のバイト数
+ */
+static int
+index_width(size_t size)
+{
+  int ret;
+
+  if (size <= 128) {
+    ret = 1;
+
+  } else if (size <= ((size_t)1 << 15)) {
+    ret = 2;
+
+  } else if (size <= ((size_t)1 << 31)) {
+    ret = 4;
+
+  } else {
+    ret = 8;
+  }
+
+  return ret;
+}
+
+static inline int64_t
+index_get(ohmap_t* ptr, size_t i)
+{
+  int64_t ret;
+
+  switch (ptr->width) {
+  case 1:
+    ret = ((int8_t*)ptr->index)[i];
+    break;
+
+  case 2:
+    ret = ((int16_t*)ptr->index)[i];
+    break;
+
+  case 4:
+    ret = ((int32_t*)ptr->index)[i];
+    break;
+
+  default:
+    ret = ((int64_t*)ptr->index)[i];
+    break;
+  }
+
+  return ret;
+}
+
+static inline void
+index_set(ohmap_t* ptr, size_t i, int64_t ix)
+{
+  switch (ptr->width) {
+  case 1:
+    ((int8_t*)ptr->index)[i] = (int8_t)ix;
+    break;
+
+  case 2:
+    ((int16_t*)ptr->index)[i] = (int16_t)ix;
+    break;
+
+  case 4:
+    ((int32_t*)ptr->index)[i] = (int32_t)ix;
+    break;
+
+  default:
+    ((int64_t*)ptr->index)[i] = ix;
+    break;
+  }
+}
+
+/**
+ * @fn
+ *  static int lookup(ohmap_t* ptr,
+ *                    void* key,
+ *                    size_t size,
+ *                    uint64_t hv,
+ *                    size_t* dsi,
+ *                    int64_t* dsx)
+ *
+ * @brief キーに対応するインデックステーブル上の位置の探索
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] key  探索するキー
+ * @param [in] size  キーのサイズ
+ * @param [in] hv  キーのハッシュ値
+ * @param [out] dsi  インデックステーブル上の位置の書き込み先
+ * @param [out] dsx  エントリ配列の添字の書き込み先
+ *
+ * @return キーが見つかった場合は0、見つからなかった場合はそれ以外の値を返
+ *         す。
+ *
+ * @remark
+ *   キーが見つからなかった場合、dsiには新規エントリを登録すべき位置(最初
+ *   に見つかった削除済みの位置、無ければ空きの位置)が書き込まれる。
+ *
+ * @remark
+ *   ハッシュ値の下位bitの偏りを避けるため、探索はCPythonのdictと同様にハッ
+ *   シュ値の上位bitを順次混ぜ込む方式(perturbation)で行う。インデックステー
+ *   ブルは常に1/3以上が空いているので、探索は必ず終了する。
+ */
+static int
+lookup(ohmap_t* ptr, void* key, size_t size, uint64_t hv,
+       size_t* dsi, int64_t* dsx)
+{
+  int ret;
+  size_t i;
+  size_t avail;
+  uint64_t perturb;
+  int64_t ix;
+  struct entry* ent;
+
+  ret     = !0;
+  i       = (size_t)hv & ptr->mask;
+  avail   = (size_t)-1;
+  perturb = hv;
+
+  while (1) {
+    ix = index_get(ptr, i);
+
+    if (ix == IX_EMPTY) {
+      if (avail == (size_t)-1) avail = i;
+      break;
+    }
+
+    if (ix == IX_REMOVED) {
+      if (avail == (size_t)-1) avail = i;
+
+    } else {
+      ent = ptr->entry + ix;
+
+      if (ent->hash == hv && ent->ksz == size &&
+          memcmp(ent->key, key, size) == 0) {
+        ret  = 0;
+        *dsx = ix;
+        break;
+      }
+    }
+
+    perturb >>= PERTURB_SHIFT;
+    i = (i * 5 + (size_t)perturb + 1) & ptr->mask;
+  }
+
+  *dsi = (ret)? avail: i;
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static size_t find_empty(ohmap_t* ptr, uint64_t hv)
+ *
+ * @brief インデックステーブル上の空き位置の探索(再構築時用)
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] hv  キーのハッシュ値
+ *
+ * @return 空き位置
+ */
+static size_t
+find_empty(ohmap_t* ptr, uint64_t hv)
+{
+  size_t ret;
+  uint64_t perturb;
+
+  ret     = (size_t)hv & ptr->mask;
+  perturb = hv;
+
+  while (index_get(ptr, ret) != IX_EMPTY) {
+    perturb >>= PERTURB_SHIFT;
+    ret = (ret * 5 + (size_t)perturb + 1) & ptr->mask;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int rebuild(ohmap_t* ptr, size_t isize)
+ *
+ * @brief エントリ配列の詰め直しとインデックステーブルの再構築
+ *
+ * @param [in] ptr  対象のハッシュマップオブジェクト
+ * @param [in] isize  再構築後のインデックステーブルのサイズ(二の冪乗)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   削除済みのエントリを取り除いてエントリ配列を前に詰める。走査位置も詰
+ *   めた後の位置に合わせて補正する。
+ */
+static int
+rebuild(ohmap_t* ptr, size_t isize)
+{
+  int ret;
+  void* index;
+  struct entry* entry;
+  int width;
+  size_t ecapa;
+  size_t pos;
+  size_t i;
+  size_t j;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  index = NULL;
+  entry = NULL;
+  width = index_width(isize);
+  ecapa = USABLE(isize);
+  pos   = 0;
+
+  /*
+   * memory allocate
+   */
+  do {
+    index = malloc(isize * width);
+    if (index == NULL) {
+      ret = OHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    if (ecapa != ptr->ecapa) {
+      entry = NALLOC(struct entry, ecapa);
+      if (entry == NULL) {
+        ret = OHMAP_ERROR_NO_MEMORY;
+        break;
+      }
+
+    } else {
+      entry = ptr->entry;
+    }
+  } while (0);
+
+  /*
+   * compact entries
+   *
+   *  entryがptr->entryと同じ場合も、添字は常にj <= iなので前から順に詰めれ
+   *  ば上書きは発生しない。
+   */
+  if (!ret) {
+    for (i = 0, j = 0; i < ptr->nentry; i++) {
+      if (i == ptr->pos) pos = j;
+      if (ptr->entry[i].key == NULL) continue;
+
+      entry[j++] = ptr->entry[i];
+    }
+
+    if (ptr->pos >= ptr->nentry) pos = j;
+
+    if (entry != ptr->entry) free(ptr->entry);
+    free(ptr->index);
+
+    memset(index, 0xff, isize * width);
+
+    ptr->index  = index;
+    ptr->width  = width;
+    ptr->isize  = isize;
+    ptr->mask   = isize - 1;
+    ptr->entry  = entry;
+    ptr->ecapa  = ecapa;
+    ptr->nentry = j;
+    ptr->pos    = pos;
+
+    /*
+     * rebuild index table
+     */
+    for (i = 0; i < ptr->nentry; i++) {
+      index_set(ptr, find_empty(ptr, entry[i].hash), i);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (index != NULL) free(index);
+    if (entry != NULL && entry != ptr->entry) free(entry);
+  }
+
+  return ret;
+}
+
+static void
+release_entry(ohmap_t* ptr, struct entry* ent)
+{
+  if (ptr->fn != NULL) ptr->fn(ent->key, ent->val);
+
+  free(ent->key);
+  ent->key = NULL;
+}
+
+static int
+store_entry(ohmap_t* ptr, void* key, size_t len, uint64_t hv, void* val)
+{
+  int ret;
+  int err;
+  size_t i;
+  int64_t ix;
+  struct entry* ent;
+  char* kcp;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  kcp = NULL;
+
+  /*
+   * lookup
+   */
+  err = lookup(ptr, key, len, hv, &i, &ix);
+
+  if (!err) {
+    /*
+     * overwrite
+     */
+    ent = ptr->entry + ix;
+
+    if (ptr->fn != NULL) ptr->fn(ent->key, ent->val);
+    ent->val = val;
+
+  } else {
+    /*
+     * append
+     *
+     *  エントリ配列が埋まっている場合は再構築を行う。削除済みのエントリが半
+     *  数以上ある場合は同じサイズで詰め直すのみとし、そうでない場合はサイズ
+     *  を倍にする。
+     */
+    if (ptr->nentry == ptr->ecapa) {
+      ret = rebuild(ptr, (ptr->used < ptr->nentry / 2)?
+                         ptr->isize: ptr->isize * 2);
+
+      if (!ret) i = find_empty(ptr, hv);
+    }
+
+    if (!ret) {
+      kcp = NALLOC(char, len + 1);
+      if (kcp == NULL) ret = OHMAP_ERROR_NO_MEMORY;
+    }
+
+    if (!ret) {
+      memcpy(kcp, key, len);
+      kcp[len] = '\0';
+
+      ent       = ptr->entry + ptr->nentry;
+      ent->hash = hv;
+      ent->key  = kcp;
+      ent->ksz  = len;
+      ent->val  = val;
+
+      index_set(ptr, i, ptr->nentry);
+
+      ptr->nentry++;
+      ptr->used++;
+    }
+  }
+
+  return ret;
+}
+
+static int
+fetch_entry(ohmap_t* ptr, void* key, size_t len, uint64_t hv, void** dst)
+{
+  int ret;
+  size_t i;
+  int64_t ix;
+
+  ret = 0;
+
+  if (lookup(ptr, key, len, hv, &i, &ix)) ret = OHMAP_ERROR_NOT_FOUND;
+
+  if (!ret) *dst = ptr->entry[ix].val;
+
+  return ret;
+}
+
+static int
+remove_entry(ohmap_t* ptr, void* key, size_t len, uint64_t hv)
+{
+  int ret;
+  size_t i;
+  int64_t ix;
+
+  ret = 0;
+
+  if (ptr->used == 0) ret = OHMAP_ERROR_EMPTY;
+
+  if (!ret) {
+    if (lookup(ptr, key, len, hv, &i, &ix)) ret = OHMAP_ERROR_NOT_FOUND;
+  }
+
+  if (!ret) {
+    release_entry(ptr, ptr->entry + ix);
+    index_set(ptr, i, IX_REMOVED);
+
+    ptr->used--;
+  }
+
+  return ret;
+}
+
+static int
+iter_next(ohmap_t* ptr, struct entry** dst)
+{
+  int ret;
+
+  ret = OHMAP_ERROR_NOT_FOUND;
+
+  while (ptr->pos < ptr->nentry) {
+    if (ptr->entry[ptr->pos++].key != NULL) {
+      *dst = ptr->entry + (ptr->pos - 1);
+      ret  = 0;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * 外部公開関数の定義
+ */
+
+int
+ohmap_new(size_t size, ohmap_t** dst)
+{
+  int ret;
+  ohmap_t* obj;
+  size_t isize;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  obj   = NULL;
+  isize = MIN_INDEX_SIZE;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = OHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * memory allocate
+   */
+  if (!ret) do {
+    while (USABLE(isize) < size) isize <<= 1;
+
+    obj = ALLOC(ohmap_t);
+    if (obj == NULL) {
+      ret = OHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    memset(obj, 0, sizeof(*obj));
+
+    obj->width = index_width(isize);
+
+    obj->index = malloc(isize * obj->width);
+    if (obj->index == NULL) {
+      ret = OHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    obj->entry = NALLOC(struct entry, USABLE(isize));
+    if (obj->entry == NULL) {
+      ret = OHMAP_ERROR_NO_MEMORY;
+      break;
+    }
+  } while (0);
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    memset(obj->index, 0xff, isize * obj->width);
+
+    obj->isize  = isize;
+    obj->mask   = isize - 1;
+    obj->ecapa  = USABLE(isize);
+    obj->nentry = 0;
+    obj->used   = 0;
+    obj->pos    = 0;
+    obj->fn     = NULL;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) {
+      if (obj->index != NULL) free(obj->index);
+      if (obj->entry != NULL) free(obj->entry);
+      free(obj);
+    }
+  }
+
+  return ret;
+}
+
+int
+ohmap_destroy(ohmap_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = OHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * clear hashmap
+   */
+  if (!ret) ret = ohmap_clear(ptr);
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    free(ptr->index);
+    free(ptr->entry);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+ohmap_store(ohmap_t* ptr, char* key, void* val)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = store_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0), val);
+  }
+
+  return ret;
+}
+
+int
+ohmap_store_bin(ohmap_t* ptr, void* key, size_t len, void* val)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * store entry
+   */
+  if (!ret) ret = store_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0), val);
+
+  return ret;
+}
+
+int
+ohmap_fetch(ohmap_t* ptr, char* key, void** dst)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = fetch_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0), dst);
+  }
+
+  return ret;
+}
+
+int
+ohmap_fetch_bin(ohmap_t* ptr, void* key, size_t len, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch entry
+   */
+  if (!ret) ret = fetch_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0), dst);
+
+  return ret;
+}
+
+int
+ohmap_remove(ohmap_t* ptr, char* key)
+{
+  int ret;
+  size_t len;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) {
+    len = strlen(key);
+    ret = remove_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0));
+  }
+
+  return ret;
+}
+
+int
+ohmap_remove_bin(ohmap_t* ptr, void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * remove entry
+   */
+  if (!ret) ret = remove_entry(ptr, key, len, hmap_hash_fnv1(key, len, 0));
+
+  return ret;
+}
+
+int
+ohmap_clear(ohmap_t* ptr)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = OHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * clear entries
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->nentry; i++) {
+      if (ptr->entry[i].key != NULL) release_entry(ptr, ptr->entry + i);
+    }
+
+    memset(ptr->index, 0xff, ptr->isize * ptr->width);
+
+    ptr->nentry = 0;
+    ptr->used   = 0;
+    ptr->pos    = 0;
+  }
+
+  return ret;
+}
+
+int
+ohmap_size(ohmap_t* ptr, size_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = ptr->used;
+
+  return ret;
+}
+
+int
+ohmap_set_callback(ohmap_t* ptr, void (*fn)(char*, void*))
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = OHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * object update
+   */
+  if (!ret) ptr->fn = fn;
+
+  return ret;
+}
+
+int
+ohmap_iter(ohmap_t* ptr, char** dsk, void** dsv)
+{
+  int ret;
+  struct entry* ent;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ent = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   */
+  if (!ret) ret = iter_next(ptr, &ent);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsk != NULL) *dsk = ent->key;
+    *dsv = ent->val;
+  }
+
+  return ret;
+}
+
+int
+ohmap_iter_bin(ohmap_t* ptr, void** dsk, size_t* dsz, void** dsv)
+{
+  int ret;
+  struct entry* ent;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ent = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsv == NULL) {
+      ret = OHMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * find next
+   */
+  if (!ret) ret = iter_next(ptr, &ent);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dsk != NULL) *dsk = ent->key;
+    if (dsz != NULL) *dsz = ent->ksz;
+    *dsv = ent->val;
+  }
+
+  return ret;
+}
+
+int
+ohmap_rewind(ohmap_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = OHMAP_ERROR_NULL_POINTER;
+
+  /*
+   * rewind find position
+   */
+  if (!ret) ptr->pos = 0;
+
+  return ret;
+}
@@ -0,0 +1,250 @@
+﻿/*
+ * Ordered hash map container (compact layout)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __ORDERED_HASH_MAP_H__
+#define __ORDERED_HASH_MAP_H__
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct __ohmap_t__ ohmap_t;
+
+#define OHMAP_ERROR_NULL_POINTER    (-3)
+#define OHMAP_ERROR_NO_MEMORY       (-4)
+#define OHMAP_ERROR_EMPTY           (-6)
+#define OHMAP_ERROR_NOT_FOUND       (-7)
+
+/*
+ * @fn
+ *   int ohmap_new(size_t size, ohmap_t** dst);
+ *
+ * @brief  順序付きハッシュマップオブジェクトの生成
+ *
+ * @param [in] size  格納するエントリ数の見込み(0可)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval OHMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval OHMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @remark
+ *   本オブジェクトはhmap_tと同様のハッシュマップだが、エントリを追加順に密
+ *   な配列に格納し、ハッシュテーブルにはその配列の添字のみ(テーブルサイズに
+ *   応じて1〜8バイト)を格納する。このため走査はエントリ配列の線形走査とな
+ *   り(空きバケットを辿らない)、走査順は常に追加順となる。また、エントリ
+ *   あたりのメモリ使用量もhmap_tより少ない。
+ *
+ * @remark
+ *   エントリ配列が埋まった時点で自動的に拡張(削除済みエントリが多い場合は
+ *   詰め直し)を行う。拡張時の処理時間はエントリ数に比例する。
+ */
+extern int ohmap_new(size_t size, ohmap_t** dst);
+
+/*
+ * @fn
+ *   int ohmap_destroy(ohmap_t* ptr);
+ *
+ * @brief  順序付きハッシュマップオブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象のオブジェクト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   コールバック関数が登録済みの場合、残っているエントリについてコールバッ
+ *   ク呼び出しを行う。
+ */
+extern int ohmap_destroy(ohmap_t* ptr);
+
+/*
+ * @fn
+ *   int ohmap_store(ohmap_t* ptr, char* key, void* value);
+ *
+ * @brief  順序付きハッシュマップへの保存
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  データのキー(NUL終端文字列)
+ * @param [in] value  データの値(任意のオブジェクトのポインタ, NULL可)
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval OHMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval OHMAP_ERROR_NO_MEMORY
+ *   メモリ確保に失敗した場合に返す。
+ *
+ * @remark
+ *   キーがすでに保存済みの場合は値の上書きを行う(走査順は変わらない)。コー
+ *   ルバック関数の登録を行っている場合は、上書き発生時にコールバック呼び出
+ *   しが行われる。
+ */
+extern int ohmap_store(ohmap_t* ptr, char* key, void* value);
+
+/*
+ * @fn
+ *   int ohmap_store_bin(ohmap_t* ptr, void* key, size_t len, void* value);
+ *
+ * @brief  順序付きハッシュマップへの保存(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はohmap_store()と同じ。
+ */
+extern int ohmap_store_bin(ohmap_t* ptr, void* key, size_t len, void* value);
+
+/*
+ * @fn
+ *   int ohmap_fetch(ohmap_t* ptr, char* key, void** dst);
+ *
+ * @brief  順序付きハッシュマップの読み出し
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  読み出し対象のキー
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval OHMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval OHMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ */
+extern int ohmap_fetch(ohmap_t* ptr, char* key, void** dst);
+
+/*
+ * @fn
+ *   int ohmap_fetch_bin(ohmap_t* ptr, void* key, size_t len, void** dst);
+ *
+ * @brief  順序付きハッシュマップの読み出し(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はohmap_fetch()と同じ。
+ */
+extern int ohmap_fetch_bin(ohmap_t* ptr, void* key, size_t len, void** dst);
+
+/*
+ * @fn
+ *   int ohmap_remove(ohmap_t* ptr, char* key);
+ *
+ * @brief  順序付きハッシュマップからの削除
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  削除対象のキー
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval OHMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval OHMAP_ERROR_EMPTY
+ *   空のオブジェクトに対して呼び出した場合に返す。
+ *
+ * @retval OHMAP_ERROR_NOT_FOUND
+ *   キーに対応するエントリが見つからなかった場合に返す。
+ *
+ * @remark
+ *   コールバック関数の登録が行われていればコールバック呼び出しが行われる。
+ *   削除はエントリ配列を詰めずに行うので、ohmap_iter()での走査中に走査済み
+ *   のエントリを削除しても問題ない。
+ */
+extern int ohmap_remove(ohmap_t* ptr, char* key);
+
+/*
+ * @fn
+ *   int ohmap_remove_bin(ohmap_t* ptr, void* key, size_t len);
+ *
+ * @brief  順序付きハッシュマップからの削除(バイナリキー)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定する以外はohmap_remove()と同じ。
+ */
+extern int ohmap_remove_bin(ohmap_t* ptr, void* key, size_t len);
+
+/*
+ * @fn
+ *   int ohmap_clear(ohmap_t* ptr);
+ *
+ * @brief  順序付きハッシュマップのクリア
+ *
+ * @param [in] ptr  クリア対象のオブジェクト
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   コールバック関数の登録が行われていれば、削除する各エントリについてコー
+ *   ルバック呼び出しが行われる。
+ */
+extern int ohmap_clear(ohmap_t* ptr);
+
+/*
+ * @fn
+ *   int ohmap_size(ohmap_t* ptr, size_t* dst);
+ *
+ * @brief  登録済みエントリ数の取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [out] dst  登録されているエントリの数の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ */
+extern int ohmap_size(ohmap_t* ptr, size_t* dst);
+
+/*
+ * @fn
+ *   int ohmap_set_callback(ohmap_t* ptr, void(*fn)(char*, void*));
+ *
+ * @brief  コールバック関数の登録
+ *
+ * @remark
+ *   hmap_set_callback()と同じ。
+ */
+extern int ohmap_set_callback(ohmap_t* ptr, void(*fn)(char*, void*));
+
+/*
+ * @fn
+ *   int ohmap_iter(ohmap_t* ptr, char** dsk, void** dsv);
+ *
+ * @brief  登録済みエントリの走査(追加順)
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [out] dsk  キーの書き込み先(NULL可)
+ * @param [out] dsv  値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval OHMAP_ERROR_NOT_FOUND
+ *   走査が終端に達した場合に返す。
+ *
+ * @remark
+ *   走査中にohmap_store()で新規エントリの追加を行った場合の動作は保証しな
+ *   い。
+ */
+extern int ohmap_iter(ohmap_t* ptr, char** dsk, void** dsv);
+
+/*
+ * @fn
+ *   int ohmap_iter_bin(ohmap_t* ptr, void** dsk, size_t* dsz, void** dsv);
+ *
+ * @brief  登録済みエントリの走査(キーのサイズ付き)
+ *
+ * @remark
+ *   キーのサイズも返す以外はohmap_iter()と同じ。走査位置は共有する。
+ */
+extern int ohmap_iter_bin(ohmap_t* ptr, void** dsk, size_t* dsz, void** dsv);
+
+extern int ohmap_rewind(ohmap_t* ptr);
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+#endif /* !defined(__ORDERED_HASH_MAP_H__) */
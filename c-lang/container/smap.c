@@ -0,0 +1,1247 @@
+﻿/*
+ * Static map container (minimal perfect hash)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smap.h"
+
+#define DEFAULT_ERROR       (__LINE__)
+#define ALLOC(t)            ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)         ((t*)malloc(sizeof(t)*(n)))
+
+/*
+ * 構築パラメータ
+ *
+ *  BUCKET_LOADはバケットあたりの平均キー数。大きくすると変位表は小さくな
+ *  るが構築時間が伸びる。スロット数はキー数の約1.01倍とし、キー数以上の位
+ *  置に割り当てられたキーは再配置表でキー数未満の空き位置に付け替える(こ
+ *  れにより最小完全ハッシュとなる)。
+ */
+#define BUCKET_LOAD         6
+#define SLOT_MARGIN(n)      ((n) / 100 + 1)
+#define MAX_PILOT           (1 << 20)
+#define MAX_SEED            16
+
+#define IMAGE_MAGIC         "SMAPIMG1"
+#define IMAGE_ORDER         0x01020304
+#define IMAGE_ALIGN         8
+#define ALIGN_UP(n,a)       (((n) + ((a) - 1)) & ~((uint64_t)(a) - 1))
+
+#define IMAGE_HEAP          0
+#define IMAGE_MMAP          1
+#define IMAGE_EXTERN        2
+
+/*
+ * 構造体の定義
+ *
+ *  イメージはヘッダ、変位表、再配置表、スロット配列、キー及び値の実体の
+ *  順に並ぶ。ヘッダ以外の参照は全てイメージ先頭からのオフセットで行う。
+ */
+struct image_header {
+  char magic[8];
+  uint32_t order;     // バイトオーダーの確認用(IMAGE_ORDER)
+  uint32_t reserved;
+  uint32_t dwidth;    // 変位表の要素のバイト数(1, 2, 4)
+  uint32_t rwidth;    // 再配置表の要素のバイト数(4, 8)
+  uint64_t seed;
+  uint64_t n;         // キーの数
+  uint64_t m;         // スロットの数(n以上)
+  uint64_t r;         // バケットの数
+  uint64_t length;    // イメージ全体のサイズ
+  uint64_t disp;
+  uint64_t remap;
+  uint64_t slot;
+};
+
+struct image_slot {
+  uint64_t koff;
+  uint64_t ksz;
+  uint64_t voff;      // 値がNULLの場合は0
+  uint64_t vsz;
+};
+
+struct __smap_t__ {
+  uint8_t* image;
+  size_t length;
+  int type;           // IMAGE_HEAP, IMAGE_MMAP, IMAGE_EXTERN
+
+  struct image_header* hdr;
+  struct image_slot* slot;
+};
+
+/*
+ * 構築時の作業用
+ */
+struct key_info {
+  uint64_t g;
+  uint64_t b;
+  uint64_t pos;
+  size_t idx;
+};
+
+/*
+ * 内部処理用の非公開関数の定義
+ */
+/*
+ * FNV1の値の各bitを全体に拡散させる(MurmurHash3のfmix64)
+ */
+static inline uint64_t
+mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+/*
+ * キーのバケットへの分配
+ *
+ *  キーの60%をバケットの先頭30%に集める偏った分配とする。キー数の多いバ
+ *  ケットがスロットの空きが多いうちに配置され、終盤に配置されるバケット
+ *  はほぼキー数1となるので、変位値が小さく抑えられる。
+ */
+static inline uint64_t
+bucket_of(uint64_t g, uint64_t r)
+{
+  uint64_t r1;
+  uint64_t x;
+
+  r1 = (r * 3) / 10;
+  x  = g >> 32;
+
+  return ((g & 0xffffffff) < 0x9999999aULL)?
+         (x * r1) >> 32: r1 + ((x * (r - r1)) >> 32);
+}
+
+/*
+ * 変位値によるスロット位置の決定
+ *
+ *  変位値をxorした後に再度攪拌する。xorのみでは、スロット数が小さい場合
+ *  に下位bitの一致するキー同士がどの変位値でも衝突したままとなる。
+ */
+static inline uint64_t
+slot_of(uint64_t g, uint64_t pilot, uint64_t m)
+{
+  return mix(g ^ (pilot * 0x9e3779b97f4a7c15ULL)) % m;
+}
+
+static inline uint64_t
+load_uint(uint8_t* p, uint64_t i, int width)
+{
+  uint64_t ret;
+
+  switch (width) {
+  case 1:
+    ret = p[i];
+    break;
+
+  case 2:
+    ret = ((uint16_t*)p)[i];
+    break;
+
+  case 4:
+    ret = ((uint32_t*)p)[i];
+    break;
+
+  default:
+    ret = ((uint64_t*)p)[i];
+    break;
+  }
+
+  return ret;
+}
+
+static inline void
+store_uint(uint8_t* p, uint64_t i, int width, uint64_t val)
+{
+  switch (width) {
+  case 1:
+    p[i] = (uint8_t)val;
+    break;
+
+  case 2:
+    ((uint16_t*)p)[i] = (uint16_t)val;
+    break;
+
+  case 4:
+    ((uint32_t*)p)[i] = (uint32_t)val;
+    break;
+
+  default:
+    ((uint64_t*)p)[i] = val;
+    break;
+  }
+}
+
+static int
+compare_info(const void* _a, const void* _b)
+{
+  const struct key_info* a = (const struct key_info*)_a;
+  const struct key_info* b = (const struct key_info*)_b;
+
+  if (a->b != b->b) return (a->b < b->b)? -1: 1;
+  if (a->g != b->g) return (a->g < b->g)? -1: 1;
+
+  return 0;
+}
+
+/**
+ * @fn
+ *  static int place(struct key_info* info,
+ *                   size_t n,
+ *                   uint64_t m,
+ *                   uint64_t r,
+ *                   uint32_t* pilot,
+ *                   uint32_t* dmax)
+ *
+ * @brief 各バケットの変位値の探索
+ *
+ * @param [in,out] info  キー情報の配列(b,gでソート済み、posを設定する)
+ * @param [in] n  キーの数
+ * @param [in] m  スロットの数
+ * @param [in] r  バケットの数
+ * @param [out] pilot  変位値の書き込み先(r要素)
+ * @param [out] dmax  変位値の最大値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   キー数の多いバケットから順に、バケット内の全てのキーが未使用かつ互い
+ *   に異なるスロットに入る変位値を0から順に探す。変位値がMAX_PILOTに達し
+ *   た場合はSMAP_ERROR_CONSTRAINTを返す(呼び出し側でシードを変えて再試行
+ *   する)。
+ */
+static int
+place(struct key_info* info, size_t n, uint64_t m, uint64_t r,
+      uint32_t* pilot, uint32_t* dmax)
+{
+  int ret;
+  size_t* start;
+  size_t* order;
+  size_t* count;
+  uint8_t* taken;
+  uint64_t* pos;
+  size_t smax;
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t b;
+  size_t s;
+  uint64_t d;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  start = NALLOC(size_t, r + 1);
+  order = NALLOC(size_t, r);
+  taken = (uint8_t*)calloc(m, sizeof(uint8_t));
+  count = NULL;
+  pos   = NULL;
+  smax  = 0;
+
+  if (start == NULL || order == NULL || taken == NULL) {
+    ret = SMAP_ERROR_NO_MEMORY;
+  }
+
+  /*
+   * bucket ranges
+   */
+  if (!ret) {
+    for (b = 0, i = 0; b < r; b++) {
+      start[b] = i;
+      while (i < n && info[i].b == b) i++;
+      if (i - start[b] > smax) smax = i - start[b];
+    }
+
+    start[r] = n;
+
+    count = (size_t*)calloc(smax + 2, sizeof(size_t));
+    pos   = NALLOC(uint64_t, smax + 1);
+
+    if (count == NULL || pos == NULL) ret = SMAP_ERROR_NO_MEMORY;
+  }
+
+  /*
+   * sort buckets by size (descending, counting sort)
+   */
+  if (!ret) {
+    for (b = 0; b < r; b++) count[smax - (start[b + 1] - start[b]) + 1]++;
+    for (s = 1; s <= smax + 1; s++) count[s] += count[s - 1];
+    for (b = 0; b < r; b++) {
+      order[count[smax - (start[b + 1] - start[b])]++] = b;
+    }
+  }
+
+  /*
+   * search pilots
+   */
+  if (!ret) {
+    *dmax = 0;
+
+    for (i = 0; i < r && !ret; i++) {
+      b = order[i];
+      s = start[b + 1] - start[b];
+
+      pilot[b] = 0;
+      if (s == 0) continue;
+
+      for (d = 0; d < MAX_PILOT; d++) {
+        for (j = 0; j < s; j++) {
+          pos[j] = slot_of(info[start[b] + j].g, d, m);
+          if (taken[pos[j]]) break;
+
+          for (k = 0; k < j; k++) {
+            if (pos[k] == pos[j]) break;
+          }
+          if (k < j) break;
+        }
+
+        if (j == s) break;
+      }
+
+      if (d == MAX_PILOT) {
+        ret = SMAP_ERROR_CONSTRAINT;
+        break;
+      }
+
+      for (j = 0; j < s; j++) {
+        taken[pos[j]]            = !0;
+        info[start[b] + j].pos   = pos[j];
+      }
+
+      pilot[b] = (uint32_t)d;
+      if (d > *dmax) *dmax = (uint32_t)d;
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (start != NULL) free(start);
+  if (order != NULL) free(order);
+  if (taken != NULL) free(taken);
+  if (count != NULL) free(count);
+  if (pos != NULL) free(pos);
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int validate(uint8_t* image, size_t length)
+ *
+ * @brief イメージのヘッダの検証
+ *
+ * @return 正常なイメージの場合は0、それ以外の場合はSMAP_ERROR_BROKENを返す。
+ *
+ * @remark
+ *   ヘッダ及び各表の範囲のみを検証する。スロットが指すキー及び値の範囲は
+ *   参照時に検証する。
+ */
+static int
+validate(uint8_t* image, size_t length)
+{
+  int ret;
+  struct image_header* hdr;
+
+  ret = 0;
+  hdr = (struct image_header*)image;
+
+  do {
+    if (length < sizeof(*hdr)) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+
+    if (memcmp(hdr->magic, IMAGE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->order != IMAGE_ORDER || hdr->length != length) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+
+    if ((hdr->dwidth != 1 && hdr->dwidth != 2 && hdr->dwidth != 4) ||
+        (hdr->rwidth != 4 && hdr->rwidth != 8)) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+
+    if (hdr->m < hdr->n || (hdr->n > 0 && (hdr->r == 0 || hdr->m == 0))) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+
+    if (hdr->disp > length ||
+        hdr->r > (length - hdr->disp) / hdr->dwidth ||
+        hdr->remap > length ||
+        hdr->m - hdr->n > (length - hdr->remap) / hdr->rwidth ||
+        hdr->slot > length ||
+        hdr->n > (length - hdr->slot) / sizeof(struct image_slot) ||
+        hdr->slot % IMAGE_ALIGN != 0 ||
+        hdr->disp % IMAGE_ALIGN != 0 ||
+        hdr->remap % IMAGE_ALIGN != 0) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+  } while (0);
+
+  return ret;
+}
+
+static int
+open_image(uint8_t* image, size_t length, int type, smap_t** dst)
+{
+  int ret;
+  smap_t* obj;
+
+  ret = validate(image, length);
+  obj = NULL;
+
+  if (!ret) {
+    obj = ALLOC(smap_t);
+    if (obj == NULL) ret = SMAP_ERROR_NO_MEMORY;
+  }
+
+  if (!ret) {
+    obj->image  = image;
+    obj->length = length;
+    obj->type   = type;
+    obj->hdr    = (struct image_header*)image;
+    obj->slot   = (struct image_slot*)(image + obj->hdr->slot);
+
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int lookup(smap_t* ptr,
+ *                    void* key,
+ *                    size_t len,
+ *                    struct image_slot** dst,
+ *                    uint64_t* dsi)
+ *
+ * @brief キーに対応するスロットの取得
+ *
+ * @remark
+ *   ハッシュ値の算出、変位表の読み出し(スロット位置がキー数以上の場合は
+ *   再配置表の読み出し)、キーの比較を各一回行う。
+ */
+static int
+lookup(smap_t* ptr, void* key, size_t len,
+       struct image_slot** dst, uint64_t* dsi)
+{
+  int ret;
+  struct image_header* hdr;
+  struct image_slot* slot;
+  uint64_t g;
+  uint64_t p;
+
+  ret = 0;
+  hdr = ptr->hdr;
+
+  if (hdr->n == 0) ret = SMAP_ERROR_NOT_FOUND;
+
+  if (!ret) {
+    g = mix(hmap_hash_fnv1(key, len, 0) ^ hdr->seed);
+    p = slot_of(g, load_uint(ptr->image + hdr->disp,
+                             bucket_of(g, hdr->r), hdr->dwidth), hdr->m);
+
+    if (p >= hdr->n) {
+      p = load_uint(ptr->image + hdr->remap, p - hdr->n, hdr->rwidth);
+      if (p >= hdr->n) ret = SMAP_ERROR_BROKEN;
+    }
+  }
+
+  if (!ret) {
+    slot = ptr->slot + p;
+
+    if (slot->koff > ptr->length || slot->ksz > ptr->length - slot->koff ||
+        slot->voff > ptr->length || slot->vsz > ptr->length - slot->voff) {
+      ret = SMAP_ERROR_BROKEN;
+
+    } else if (slot->ksz != len ||
+               memcmp(ptr->image + slot->koff, key, len) != 0) {
+      ret = SMAP_ERROR_NOT_FOUND;
+    }
+  }
+
+  if (!ret) {
+    if (dst != NULL) *dst = slot;
+    if (dsi != NULL) *dsi = p;
+  }
+
+  return ret;
+}
+
+/**
+ * @fn
+ *  static int build(void* keys[],
+ *                   size_t lens[],
+ *                   size_t n,
+ *                   void* vals[],
+ *                   int (*fn)(void*, void**, size_t*),
+ *                   smap_t** dst)
+ *
+ * @brief 静的マップの構築(smap_build()の本体)
+ */
+static int
+build(void* keys[], size_t lens[], size_t n, void* vals[],
+      int (*fn)(void*, void**, size_t*), smap_t** dst)
+{
+  int ret;
+  uint64_t m;
+  uint64_t r;
+  uint64_t seed;
+  uint32_t dmax;
+  int dwidth;
+  int rwidth;
+  size_t i;
+  uint64_t p;
+  uint64_t q;
+  uint64_t off;
+  uint64_t* hv;
+  size_t* ksz;
+  void** vdat;
+  size_t* vsz;
+  struct key_info* info;
+  uint32_t* pilot;
+  uint8_t* taken;
+  uint8_t* image;
+  struct image_header* hdr;
+  struct image_slot* slot;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  m     = (n > 0)? n + SLOT_MARGIN(n): 0;
+  r     = (n + BUCKET_LOAD - 1) / BUCKET_LOAD;
+  seed  = 0;
+  dmax  = 0;
+  off   = 0;
+  hv    = NALLOC(uint64_t, n + 1);
+  ksz   = NALLOC(size_t, n + 1);
+  vdat  = NALLOC(void*, n + 1);
+  vsz   = NALLOC(size_t, n + 1);
+  info  = NALLOC(struct key_info, n + 1);
+  pilot = NALLOC(uint32_t, r + 1);
+  taken = (uint8_t*)calloc(m + 1, sizeof(uint8_t));
+  image = NULL;
+
+  if (hv == NULL || ksz == NULL || vdat == NULL || vsz == NULL ||
+      info == NULL || pilot == NULL || taken == NULL) {
+    ret = SMAP_ERROR_NO_MEMORY;
+  }
+
+  /*
+   * hash keys
+   */
+  if (!ret) {
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL) {
+        ret = SMAP_ERROR_NULL_POINTER;
+        break;
+      }
+
+      ksz[i] = (lens != NULL)? lens[i]: strlen((char*)keys[i]);
+      hv[i]  = hmap_hash_fnv1(keys[i], ksz[i], 0);
+    }
+  }
+
+  /*
+   * build hash function
+   *
+   *  変位値の探索に失敗した場合はシードを変えて再試行する。ハッシュ値が完
+   *  全に一致するキーの組はシードによらず分離できないので、その時点でエラ
+   *  ーとする(キーの重複もここで検出される)。
+   */
+  if (!ret && n > 0) {
+    for (seed = 0; seed < MAX_SEED; seed++) {
+      ret = 0;
+
+      for (i = 0; i < n; i++) {
+        info[i].g   = mix(hv[i] ^ (seed * 0x9e3779b97f4a7c15ULL));
+        info[i].b   = bucket_of(info[i].g, r);
+        info[i].pos = 0;
+        info[i].idx = i;
+      }
+
+      qsort(info, n, sizeof(*info), compare_info);
+
+      for (i = 1; i < n; i++) {
+        if (info[i].g == info[i - 1].g) {
+          ret = SMAP_ERROR_CONSTRAINT;
+          break;
+        }
+      }
+      if (ret) break;
+
+      ret = place(info, n, m, r, pilot, &dmax);
+      if (ret != SMAP_ERROR_CONSTRAINT) break;
+    }
+
+    seed *= 0x9e3779b97f4a7c15ULL;
+  }
+
+  /*
+   * serialize values
+   */
+  if (!ret) {
+    for (i = 0; i < n; i++) {
+      vdat[i] = NULL;
+      vsz[i]  = 0;
+
+      if (vals == NULL) continue;
+
+      if (fn != NULL) {
+        if (fn(vals[i], vdat + i, vsz + i)) {
+          ret = SMAP_ERROR_IO;
+          break;
+        }
+
+      } else {
+        vdat[i] = vals[i];
+        vsz[i]  = (vals[i] != NULL)? strlen((char*)vals[i]) + 1: 0;
+      }
+
+      if (vdat[i] == NULL) vsz[i] = 0;
+    }
+  }
+
+  /*
+   * layout
+   */
+  if (!ret) {
+    dwidth = (dmax < 0x100)? 1: (dmax < 0x10000)? 2: 4;
+    rwidth = (n <= UINT32_MAX)? 4: 8;
+
+    off  = sizeof(struct image_header);
+    off += ALIGN_UP(r * dwidth, IMAGE_ALIGN);
+    off += ALIGN_UP((m - n) * rwidth, IMAGE_ALIGN);
+    off += sizeof(struct image_slot) * n;
+
+    for (i = 0; i < n; i++) {
+      off = ALIGN_UP(off + ksz[i] + 1, IMAGE_ALIGN);
+      off = ALIGN_UP(off + vsz[i], IMAGE_ALIGN);
+    }
+
+    image = (uint8_t*)calloc(off, sizeof(uint8_t));
+    if (image == NULL) ret = SMAP_ERROR_NO_MEMORY;
+  }
+
+  /*
+   * fill image
+   */
+  if (!ret) {
+    hdr = (struct image_header*)image;
+
+    memcpy(hdr->magic, IMAGE_MAGIC, sizeof(hdr->magic));
+    hdr->order  = IMAGE_ORDER;
+    hdr->dwidth = dwidth;
+    hdr->rwidth = rwidth;
+    hdr->seed   = seed;
+    hdr->n      = n;
+    hdr->m      = m;
+    hdr->r      = r;
+    hdr->length = off;
+    hdr->disp   = sizeof(struct image_header);
+    hdr->remap  = hdr->disp + ALIGN_UP(r * dwidth, IMAGE_ALIGN);
+    hdr->slot   = hdr->remap + ALIGN_UP((m - n) * rwidth, IMAGE_ALIGN);
+
+    for (i = 0; i < r; i++) store_uint(image + hdr->disp, i, dwidth, pilot[i]);
+
+    // キー数以上の位置のスロットをキー数未満の空きスロットに対応付ける
+    for (i = 0; i < n; i++) taken[info[i].pos] = !0;
+
+    for (p = n, q = 0; p < m; p++) {
+      if (!taken[p]) continue;
+
+      while (taken[q]) q++;
+      store_uint(image + hdr->remap, p - n, rwidth, q++);
+    }
+
+    // スロットの設定(キー及び値はスロット順に配置する)
+    slot = (struct image_slot*)(image + hdr->slot);
+    off  = hdr->slot + sizeof(struct image_slot) * n;
+
+    for (i = 0; i < n; i++) {
+      p = info[i].pos;
+      if (p >= n) p = load_uint(image + hdr->remap, p - n, rwidth);
+
+      slot[p].koff = info[i].idx;
+    }
+
+    for (p = 0; p < n; p++) {
+      i = slot[p].koff;
+
+      slot[p].koff = off;
+      slot[p].ksz  = ksz[i];
+      memcpy(image + off, keys[i], ksz[i]);
+      off = ALIGN_UP(off + ksz[i] + 1, IMAGE_ALIGN);
+
+      if (vdat[i] != NULL) {
+        slot[p].voff = off;
+        slot[p].vsz  = vsz[i];
+        memcpy(image + off, vdat[i], vsz[i]);
+        off = ALIGN_UP(off + vsz[i], IMAGE_ALIGN);
+      }
+    }
+
+    ret = open_image(image, hdr->length, IMAGE_HEAP, dst);
+  }
+
+  /*
+   * post process
+   */
+  if (ret && image != NULL) free(image);
+
+  if (hv != NULL) free(hv);
+  if (ksz != NULL) free(ksz);
+  if (vdat != NULL) free(vdat);
+  if (vsz != NULL) free(vsz);
+  if (info != NULL) free(info);
+  if (pilot != NULL) free(pilot);
+  if (taken != NULL) free(taken);
+
+  return ret;
+}
+
+/*
+ * 外部公開関数の定義
+ */
+
+int
+smap_build(void* keys[], size_t lens[], size_t n, void* vals[],
+           int (*fn)(void*, void**, size_t*), smap_t** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (keys == NULL && n > 0) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * build
+   */
+  if (!ret) ret = build(keys, lens, n, vals, fn, dst);
+
+  return ret;
+}
+
+int
+smap_build_from_hmap(hmap_t* src, int (*fn)(void*, void**, size_t*),
+                     smap_t** dst)
+{
+  int ret;
+  size_t n;
+  size_t i;
+  size_t pos;
+  void** keys;
+  size_t* lens;
+  void** vals;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  n    = 0;
+  keys = NULL;
+  lens = NULL;
+  vals = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (src == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * collect entries
+   */
+  if (!ret) do {
+    hmap_size(src, &n);
+
+    keys = NALLOC(void*, n + 1);
+    lens = NALLOC(size_t, n + 1);
+    vals = NALLOC(void*, n + 1);
+
+    if (keys == NULL || lens == NULL || vals == NULL) {
+      ret = SMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    for (i = 0, pos = 0; i < n; i++) {
+      if (hmap_iter_r(src, &pos, keys + i, lens + i, vals + i)) break;
+    }
+
+    n = i;
+  } while (0);
+
+  /*
+   * build
+   */
+  if (!ret) ret = build(keys, lens, n, vals, fn, dst);
+
+  /*
+   * post process
+   */
+  if (keys != NULL) free(keys);
+  if (lens != NULL) free(lens);
+  if (vals != NULL) free(vals);
+
+  return ret;
+}
+
+int
+smap_destroy(smap_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = SMAP_ERROR_NULL_POINTER;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    switch (ptr->type) {
+    case IMAGE_HEAP:
+      free(ptr->image);
+      break;
+
+    case IMAGE_MMAP:
+      munmap(ptr->image, ptr->length);
+      break;
+
+    default:
+      break;
+    }
+
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+smap_fetch(smap_t* ptr, char* key, void** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fetch
+   */
+  if (!ret) ret = smap_fetch_bin(ptr, key, strlen(key), dst, NULL);
+
+  return ret;
+}
+
+int
+smap_fetch_bin(smap_t* ptr, void* key, size_t len, void** dst, size_t* dsz)
+{
+  int ret;
+  struct image_slot* slot;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  slot = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * lookup
+   */
+  if (!ret) ret = lookup(ptr, key, len, &slot, NULL);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = (slot->voff != 0)? ptr->image + slot->voff: NULL;
+    if (dsz != NULL) *dsz = slot->vsz;
+  }
+
+  return ret;
+}
+
+int
+smap_index(smap_t* ptr, void* key, size_t len, size_t* dst)
+{
+  int ret;
+  uint64_t idx;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (key == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * lookup
+   */
+  if (!ret) ret = lookup(ptr, key, len, NULL, &idx);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = (size_t)idx;
+
+  return ret;
+}
+
+int
+smap_size(smap_t* ptr, size_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = (size_t)ptr->hdr->n;
+
+  return ret;
+}
+
+int
+smap_save(smap_t* ptr, char* path)
+{
+  int ret;
+  char* tmp;
+  FILE* fp;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  tmp = NULL;
+  fp  = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (path == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * write file
+   */
+  if (!ret) do {
+    tmp = NALLOC(char, strlen(path) + 5);
+    if (tmp == NULL) {
+      ret = SMAP_ERROR_NO_MEMORY;
+      break;
+    }
+
+    sprintf(tmp, "%s.tmp", path);
+
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+      ret = SMAP_ERROR_IO;
+      break;
+    }
+
+    if (fwrite(ptr->image, ptr->length, 1, fp) != 1) {
+      ret = SMAP_ERROR_IO;
+      break;
+    }
+
+    ret = (fclose(fp) == 0)? 0: SMAP_ERROR_IO;
+    fp  = NULL;
+    if (ret) break;
+
+    if (rename(tmp, path)) ret = SMAP_ERROR_IO;
+  } while (0);
+
+  /*
+   * post process
+   */
+  if (fp != NULL) fclose(fp);
+  if (ret && tmp != NULL) unlink(tmp);
+  if (tmp != NULL) free(tmp);
+
+  return ret;
+}
+
+int
+smap_open(char* path, smap_t** dst)
+{
+  int ret;
+  int fd;
+  void* addr;
+  struct stat st;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  fd   = -1;
+  addr = MAP_FAILED;
+
+  /*
+   * argument check
+   */
+  do {
+    if (path == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * map file
+   */
+  if (!ret) do {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      ret = SMAP_ERROR_IO;
+      break;
+    }
+
+    if (fstat(fd, &st)) {
+      ret = SMAP_ERROR_IO;
+      break;
+    }
+
+    if ((size_t)st.st_size < sizeof(struct image_header)) {
+      ret = SMAP_ERROR_BROKEN;
+      break;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ret = SMAP_ERROR_IO;
+      break;
+    }
+
+    ret = open_image((uint8_t*)addr, st.st_size, IMAGE_MMAP, dst);
+  } while (0);
+
+  /*
+   * post process
+   */
+  if (fd >= 0) close(fd);
+  if (ret && addr != MAP_FAILED) munmap(addr, st.st_size);
+
+  return ret;
+}
+
+int
+smap_image(smap_t* ptr, void** dst, size_t* dsz)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dsz == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr->image;
+    *dsz = ptr->length;
+  }
+
+  return ret;
+}
+
+int
+smap_open_image(void* data, size_t size, smap_t** dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (data == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = SMAP_ERROR_NULL_POINTER;
+      break;
+    }
+  } while (0);
+
+  /*
+   * open
+   */
+  if (!ret) ret = open_image((uint8_t*)data, size, IMAGE_EXTERN, dst);
+
+  return ret;
+}
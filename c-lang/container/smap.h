@@ -0,0 +1,267 @@
+﻿/*
+ * Static map container (minimal perfect hash)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __STATIC_MAP_H__
+#define __STATIC_MAP_H__
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hmap.h"
+
+typedef struct __smap_t__ smap_t;
+
+#define SMAP_ERROR_CONSTRAINT       (-2)
+#define SMAP_ERROR_NULL_POINTER     (-3)
+#define SMAP_ERROR_NO_MEMORY        (-4)
+#define SMAP_ERROR_NOT_FOUND        (-7)
+#define SMAP_ERROR_IO               (-8)
+#define SMAP_ERROR_BROKEN           (-9)
+
+/*
+ * @fn
+ *   int smap_build(void* keys[],
+ *                  size_t lens[],
+ *                  size_t n,
+ *                  void* vals[],
+ *                  int (*fn)(void* val, void** data, size_t* size),
+ *                  smap_t** dst);
+ *
+ * @brief  静的マップの構築
+ *
+ * @param [in] keys  キーの配列
+ * @param [in] lens  キーのサイズの配列(NULLの場合はNUL終端文字列として扱う)
+ * @param [in] n  キーの数
+ * @param [in] vals  値の配列(NULLの場合は値を持たない)
+ * @param [in] fn  値のシリアライズ関数(NULL可)
+ * @param [out] dst  構築したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_CONSTRAINT
+ *   キーに重複がある場合に返す。
+ *
+ * @retval SMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval SMAP_ERROR_NO_MEMORY
+ *   メモリの確保に失敗した場合に返す。
+ *
+ * @remark
+ *   キーの集合に対する最小完全ハッシュ関数(CHD方式: キーをバケットに分配
+ *   し、バケット毎に衝突しない変位値を探索する)を構築し、キーと値をその
+ *   ハッシュ値の位置に格納する。参照は一回のハッシュ計算、変位表の一回の
+ *   読み出し、一回のキー比較で完了し、探査は行わない。変位表はキーあたり
+ *   3bit程度となる。
+ *
+ * @remark
+ *   値の扱いはhmap_freeze()と同じ(fnにNULLを指定した場合はNUL終端文字列と
+ *   して複製する)。キー及び値は全て複製するので、呼び出し後に開放して問題
+ *   ない。
+ *
+ * @remark
+ *   構築した静的マップは単一の連続したメモリ領域(イメージ)で表現され、内
+ *   部の参照は全てオフセットで行う。smap_save()でファイルに書き出して
+ *   smap_open()でmmap()するか、smap_image()で取得したイメージを
+ *   smap_open_image()で直接参照することができる。
+ */
+extern int smap_build(void* keys[], size_t lens[], size_t n, void* vals[],
+                      int (*fn)(void* val, void** data, size_t* size),
+                      smap_t** dst);
+
+/*
+ * @fn
+ *   int smap_build_from_hmap(hmap_t* src,
+ *                            int (*fn)(void* val, void** data, size_t* size),
+ *                            smap_t** dst);
+ *
+ * @brief  ハッシュマップからの静的マップの構築
+ *
+ * @param [in] src  元となるハッシュマップオブジェクト
+ * @param [in] fn  値のシリアライズ関数(NULL可)
+ * @param [out] dst  構築したオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   srcに登録されている全エントリを対象にsmap_build()を行う。srcは変更しな
+ *   い。
+ */
+extern int smap_build_from_hmap(hmap_t* src,
+                                int (*fn)(void* val, void** data, size_t* size),
+                                smap_t** dst);
+
+/*
+ * @fn
+ *   int smap_destroy(smap_t* ptr);
+ *
+ * @brief  静的マップオブジェクトの破棄
+ *
+ * @remark
+ *   smap_open()でオープンした場合はマッピングを解除する。smap_open_image()
+ *   でオープンした場合、イメージの領域は開放しない。
+ */
+extern int smap_destroy(smap_t* ptr);
+
+/*
+ * @fn
+ *   int smap_fetch(smap_t* ptr, char* key, void** dst);
+ *
+ * @brief  静的マップの読み出し
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  読み出し対象のキー
+ * @param [out] dst  読み出した値の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_NULL_POINTER
+ *   NULLが許容されないポインタ引数にNULLが指定された場合に返す。
+ *
+ * @retval SMAP_ERROR_NOT_FOUND
+ *   キーに対応するデータが見つからなかった場合に返す。
+ *
+ * @remark
+ *   dstにはイメージ内の値のバイト列のアドレス(8バイト境界に整列済み)が書
+ *   き込まれる。この領域を変更してはならない。
+ */
+extern int smap_fetch(smap_t* ptr, char* key, void** dst);
+
+/*
+ * @fn
+ *   int smap_fetch_bin(smap_t* ptr,
+ *                      void* key, size_t len, void** dst, size_t* dsz);
+ *
+ * @brief  静的マップの読み出し(バイナリキー)
+ *
+ * @param [out] dsz  値のサイズの書き込み先(NULL可)
+ *
+ * @remark
+ *   キーをアドレスとサイズで指定し、値のサイズも返す以外はsmap_fetch()と
+ *   同じ。
+ */
+extern int smap_fetch_bin(smap_t* ptr,
+                          void* key, size_t len, void** dst, size_t* dsz);
+
+/*
+ * @fn
+ *   int smap_index(smap_t* ptr, void* key, size_t len, size_t* dst);
+ *
+ * @brief  キーの番号の取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] key  対象のキー
+ * @param [in] len  キーのサイズ
+ * @param [out] dst  キーの番号(0〜エントリ数-1)の書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_NOT_FOUND
+ *   キーが登録されていない場合に返す。
+ *
+ * @remark
+ *   最小完全ハッシュ関数の値そのものを返す。登録済みのキーにはそれぞれ異
+ *   なる番号が割り当てられるので、呼び出し側で用意した配列の添字として使
+ *   用できる。
+ */
+extern int smap_index(smap_t* ptr, void* key, size_t len, size_t* dst);
+
+/*
+ * @fn
+ *   int smap_size(smap_t* ptr, size_t* dst);
+ *
+ * @brief  登録済みエントリ数の取得
+ */
+extern int smap_size(smap_t* ptr, size_t* dst);
+
+/*
+ * @fn
+ *   int smap_save(smap_t* ptr, char* path);
+ *
+ * @brief  静的マップのファイルへの書き出し
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [in] path  書き出し先のファイルのパス
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_IO
+ *   ファイルの書き込みに失敗した場合に返す。
+ *
+ * @remark
+ *   イメージをそのまま書き出す。書き出しはhmap_freeze()と同様に一時ファイ
+ *   ル経由で行う。
+ */
+extern int smap_save(smap_t* ptr, char* path);
+
+/*
+ * @fn
+ *   int smap_open(char* path, smap_t** dst);
+ *
+ * @brief  ファイルに書き出した静的マップのオープン
+ *
+ * @param [in] path  smap_save()で書き出したファイルのパス
+ * @param [out] dst  オープンしたオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_IO
+ *   ファイルのオープンまたはマッピングに失敗した場合に返す。
+ *
+ * @retval SMAP_ERROR_BROKEN
+ *   ファイルの形式が不正な場合に返す。
+ *
+ * @remark
+ *   ファイルを読み出し専用でmmap()する。内容の読み込みは参照時にページフォ
+ *   ルトにより行われる。
+ */
+extern int smap_open(char* path, smap_t** dst);
+
+/*
+ * @fn
+ *   int smap_image(smap_t* ptr, void** dst, size_t* dsz);
+ *
+ * @brief  イメージの取得
+ *
+ * @param [in] ptr  対象のオブジェクト
+ * @param [out] dst  イメージの先頭アドレスの書き込み先
+ * @param [out] dsz  イメージのサイズの書き込み先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @remark
+ *   イメージはptrが破棄されるまで有効。ソースコードへの埋め込み等でイメー
+ *   ジを保存する場合は複製すること。
+ */
+extern int smap_image(smap_t* ptr, void** dst, size_t* dsz);
+
+/*
+ * @fn
+ *   int smap_open_image(void* data, size_t size, smap_t** dst);
+ *
+ * @brief  メモリ上のイメージのオープン
+ *
+ * @param [in] data  イメージの先頭アドレス(8バイト境界に整列していること)
+ * @param [in] size  イメージのサイズ
+ * @param [out] dst  オープンしたオブジェクトの格納先
+ *
+ * @return 正常に処理できた場合は0、失敗した場合はそれ以外の値を返す。
+ *
+ * @retval SMAP_ERROR_BROKEN
+ *   イメージの形式が不正な場合に返す。
+ *
+ * @remark
+ *   イメージは複製せずに直接参照するので、オブジェクトの破棄まで開放しない
+ *   こと。
+ */
+extern int smap_open_image(void* data, size_t size, smap_t** dst);
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+#endif /* !defined(__STATIC_MAP_H__) */
@@ -0,0 +1,825 @@
+﻿/*
+ * Bloom filter (standard / cache-line blocked)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fnv1.h"
+#include "bloom.h"
+
+#define DEFAULT_ERROR   (__LINE__)
+#define ALLOC(t)        ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)     ((t*)malloc(sizeof(t) * (n)))
+
+#define LINE_BITS       512         // キャッシュライン一本分のビット数
+#define LINE_WORDS      (LINE_BITS / 64)
+#define BATCH           16          // 一括処理でまとめて先読みするキーの数
+
+#define IMAGE_MAGIC     "BLMF"
+#define IMAGE_VERSION   1
+
+/**
+ * @brief
+ *  イメージのヘッダ(ビット列はこの直後に続く)
+ */
+struct header {
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t k;                   // プローブ数
+  uint64_t nbits;               // ビット数(LINE_BITSの倍数)
+  uint8_t reserved[40];
+};
+
+_Static_assert(sizeof(struct header) == 64, "invalid header size");
+
+/**
+ * @brief
+ *  bloom_tの実体
+ */
+struct __bloom_t__ {
+  struct header* hdr;           // イメージの先頭
+  uint64_t* bits;
+  uint64_t nbits;
+  uint64_t nline;               // キャッシュラインの数
+  int k;
+  int blocked;
+  int readonly;
+
+  int owned;                    // hdrを自前で確保した場合は真
+  void* map;                    // bloom_load()でマップした領域
+  size_t mapsz;
+};
+
+/*
+ * declar internal functions
+ */
+
+/**
+ * @brief
+ *  [0, n)への写像(剰余の代わりに乗算の上位ワードを使用する)
+ */
+static inline uint64_t
+range(uint64_t x, uint64_t n)
+{
+  return (uint64_t)(((unsigned __int128)x * n) >> 64);
+}
+
+/*
+ * 標準形式
+ *
+ *  a + i*b (bは毎回iずつ増やす、enhanced double hashing)でk個の位置を導出
+ *  する。
+ */
+#define STD_PROBES(ptr, h, stmt) \
+  do { \
+    uint64_t __a = (h); \
+    uint64_t __b = ((h) >> 32 | (h) << 32) | 1; \
+    uint64_t pos; \
+    int __i; \
+    for (__i = 0; __i < (ptr)->k; __i++) { \
+      pos  = range(__a, (ptr)->nbits); \
+      stmt; \
+      __a += __b; \
+      __b += __i; \
+    } \
+  } while (0)
+
+/*
+ * ブロック形式
+ *
+ *  上位ビットでキャッシュラインを選び、ライン内の位置は下位ビットから
+ *  x + i*y (yは奇数なのでk <= 512であれば位置は重複しない)で導出する。
+ */
+#define BLK_LINE(ptr, h)  ((ptr)->bits + (range((h), (ptr)->nline) * LINE_WORDS))
+
+#define BLK_PROBES(ptr, h, stmt) \
+  do { \
+    uint32_t __x = (uint32_t)(h); \
+    uint32_t __y = (uint32_t)((h) >> 16) | 1; \
+    uint32_t pos; \
+    int __i; \
+    for (__i = 0; __i < (ptr)->k; __i++) { \
+      pos  = __x & (LINE_BITS - 1); \
+      stmt; \
+      __x += __y; \
+    } \
+  } while (0)
+
+#define BIT_SET(w, i)     ((w)[(i) >> 6] |= (1ULL << ((i) & 63)))
+#define BIT_TEST(w, i)    ((w)[(i) >> 6] & (1ULL << ((i) & 63)))
+
+static void
+add_hash(bloom_t* ptr, uint64_t h)
+{
+  uint64_t* w;
+
+  if (ptr->blocked) {
+    w = BLK_LINE(ptr, h);
+    BLK_PROBES(ptr, h, BIT_SET(w, pos));
+
+  } else {
+    w = ptr->bits;
+    STD_PROBES(ptr, h, BIT_SET(w, pos));
+  }
+}
+
+static int
+check_hash(bloom_t* ptr, uint64_t h)
+{
+  uint64_t* w;
+
+  if (ptr->blocked) {
+    w = BLK_LINE(ptr, h);
+    BLK_PROBES(ptr, h, if (!BIT_TEST(w, pos)) return 0);
+
+  } else {
+    w = ptr->bits;
+    STD_PROBES(ptr, h, if (!BIT_TEST(w, pos)) return 0);
+  }
+
+  return !0;
+}
+
+static void
+prefetch(bloom_t* ptr, uint64_t h, int rw)
+{
+  if (ptr->blocked) {
+    if (rw) {
+      __builtin_prefetch(BLK_LINE(ptr, h), 1);
+    } else {
+      __builtin_prefetch(BLK_LINE(ptr, h), 0);
+    }
+
+  } else {
+    if (rw) {
+      STD_PROBES(ptr, h, __builtin_prefetch(ptr->bits + (pos >> 6), 1));
+    } else {
+      STD_PROBES(ptr, h, __builtin_prefetch(ptr->bits + (pos >> 6), 0));
+    }
+  }
+}
+
+/**
+ * @brief
+ *  複数キーのハッシュ値の算出
+ */
+static void
+hash_batch(const void* keys[], const size_t lens[], size_t n, uint64_t dst[])
+{
+  size_t i;
+
+  fnv164_many((void**)keys, (size_t*)lens, n, dst);
+  for (i = 0; i < n; i++) dst[i] = fnv1_mix64(dst[i]);
+}
+
+/**
+ * @brief
+ *  イメージの検証とオブジェクトへの設定
+ */
+static int
+setup(bloom_t* ptr, struct header* hdr, size_t size)
+{
+  int ret;
+
+  ret = 0;
+
+  do {
+    if (size < sizeof(struct header)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (memcmp(hdr->magic, IMAGE_MAGIC, 4) || hdr->version != IMAGE_VERSION) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (hdr->k < 1 || hdr->k > BLOOM_MAX_PROBES) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (hdr->nbits == 0 || hdr->nbits % LINE_BITS != 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if ((size - sizeof(struct header)) / 8 < hdr->nbits / 64) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  if (!ret) {
+    ptr->hdr     = hdr;
+    ptr->bits    = (uint64_t*)(hdr + 1);
+    ptr->nbits   = hdr->nbits;
+    ptr->nline   = hdr->nbits / LINE_BITS;
+    ptr->k       = (int)hdr->k;
+    ptr->blocked = !!(hdr->flags & BLOOM_FLAG_BLOCKED);
+  }
+
+  return ret;
+}
+
+/*
+ * declar global functions
+ */
+
+int
+bloom_new(size_t n, double fpp, int flags, bloom_t** dst)
+{
+  int ret;
+  bloom_t* obj;
+  struct header* hdr;
+  double m;
+  uint64_t nbits;
+  int k;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+  hdr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (n == 0 || !(fpp > 0.0 && fpp < 1.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (flags & ~BLOOM_FLAG_BLOCKED) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * decide parameters
+   */
+  if (!ret) {
+    m     = ceil(-(double)n * log(fpp) / (M_LN2 * M_LN2));
+    k     = (int)lround((m / n) * M_LN2);
+    nbits = (((uint64_t)m + LINE_BITS - 1) / LINE_BITS) * LINE_BITS;
+
+    if (k < 1) k = 1;
+    if (k > BLOOM_MAX_PROBES) k = BLOOM_MAX_PROBES;
+  }
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(bloom_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    hdr = (struct header*)aligned_alloc(64, sizeof(struct header) + nbits / 8);
+    if (hdr == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    memset(hdr, 0, sizeof(struct header) + nbits / 8);
+    memcpy(hdr->magic, IMAGE_MAGIC, 4);
+    hdr->version = IMAGE_VERSION;
+    hdr->flags   = flags;
+    hdr->k       = k;
+    hdr->nbits   = nbits;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->owned = !0;
+
+    ret = setup(obj, hdr, sizeof(struct header) + nbits / 8);
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (hdr != NULL) free(hdr);
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+bloom_destroy(bloom_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    if (ptr->owned) free(ptr->hdr);
+    if (ptr->map != NULL) munmap(ptr->map, ptr->mapsz);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+bloom_add(bloom_t* ptr, const void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || (key == NULL && len > 0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->readonly) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update bits
+   */
+  if (!ret) add_hash(ptr, fnv1_mix64(fnv164((void*)key, len)));
+
+  return ret;
+}
+
+int
+bloom_check(bloom_t* ptr, const void* key, size_t len, int* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || (key == NULL && len > 0) || dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * test bits
+   */
+  if (!ret) *dst = check_hash(ptr, fnv1_mix64(fnv164((void*)key, len)));
+
+  return ret;
+}
+
+int
+bloom_add_hash(bloom_t* ptr, uint64_t hv)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->readonly) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update bits
+   */
+  if (!ret) add_hash(ptr, fnv1_mix64(hv));
+
+  return ret;
+}
+
+int
+bloom_check_hash(bloom_t* ptr, uint64_t hv, int* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * test bits
+   */
+  if (!ret) *dst = check_hash(ptr, fnv1_mix64(hv));
+
+  return ret;
+}
+
+int
+bloom_add_many(bloom_t* ptr, const void* keys[], const size_t lens[],
+               size_t n)
+{
+  int ret;
+  uint64_t hv[BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || (n > 0 && (keys == NULL || lens == NULL))) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->readonly) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL && lens[i] > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * update bits
+   *
+   *  BATCH個ずつハッシュ値を求めて先読みを発行し、その後でビットを操作する
+   *  (メモリアクセスの待ちを重ね合わせる)。
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = (n - i < BATCH)? n - i: BATCH;
+
+      hash_batch(keys + i, lens + i, m, hv);
+      for (j = 0; j < m; j++) prefetch(ptr, hv[j], 1);
+      for (j = 0; j < m; j++) add_hash(ptr, hv[j]);
+    }
+  }
+
+  return ret;
+}
+
+int
+bloom_check_many(bloom_t* ptr, const void* keys[], const size_t lens[],
+                 size_t n, uint8_t dst[])
+{
+  int ret;
+  uint64_t hv[BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (n > 0 && (keys == NULL || lens == NULL || dst == NULL)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL && lens[i] > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * test bits
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = (n - i < BATCH)? n - i: BATCH;
+
+      hash_batch(keys + i, lens + i, m, hv);
+      for (j = 0; j < m; j++) prefetch(ptr, hv[j], 0);
+      for (j = 0; j < m; j++) dst[i + j] = (uint8_t)check_hash(ptr, hv[j]);
+    }
+  }
+
+  return ret;
+}
+
+int
+bloom_image(bloom_t* ptr, const void** dst, size_t* dsz)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || dst == NULL || dsz == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr->hdr;
+    *dsz = sizeof(struct header) + (ptr->nbits / 8);
+  }
+
+  return ret;
+}
+
+int
+bloom_attach(const void* img, size_t size, bloom_t** dst)
+{
+  int ret;
+  bloom_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (img == NULL || dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if ((uintptr_t)img % 8 != 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(bloom_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    memset(obj, 0, sizeof(*obj));
+    obj->readonly = !0;
+
+    ret = setup(obj, (struct header*)img, size);
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+bloom_save(bloom_t* ptr, const char* path)
+{
+  int ret;
+  int fd;
+  char* tmp;
+  const uint8_t* p;
+  size_t size;
+  ssize_t n;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  fd  = -1;
+  tmp = NULL;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || path == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * write image
+   *
+   *  既存のファイルをbloom_load()でマップしている読み手がいても壊さないよう
+   *  に、一時ファイルに書き出してからrename()で置き換える(既存のファイルを
+   *  切り詰めると、読み手はSIGBUSで停止する)。
+   */
+  if (!ret) {
+    tmp = NALLOC(char, strlen(path) + 5);
+    if (tmp == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    sprintf(tmp, "%s.tmp", path);
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    p    = (const uint8_t*)ptr->hdr;
+    size = sizeof(struct header) + (ptr->nbits / 8);
+
+    while (size > 0) {
+      n = write(fd, p, size);
+
+      if (n > 0) {
+        p    += n;
+        size -= n;
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  }
+
+  if (!ret) {
+    if (fsync(fd)) ret = DEFAULT_ERROR;
+  }
+
+  if (fd >= 0) {
+    if (close(fd) && !ret) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    if (rename(tmp, path)) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && fd >= 0) unlink(tmp);
+  if (tmp != NULL) free(tmp);
+
+  return ret;
+}
+
+int
+bloom_load(const char* path, bloom_t** dst)
+{
+  int ret;
+  int err;
+  int fd;
+  struct stat st;
+  void* map;
+  bloom_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  fd  = -1;
+  map = MAP_FAILED;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (path == NULL || dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * map file
+   */
+  if (!ret) {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    err = fstat(fd, &st);
+    if (err || st.st_size < (off_t)sizeof(struct header)) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * create object
+   */
+  if (!ret) {
+    err = bloom_attach(map, st.st_size, &obj);
+    if (err) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    obj->map   = map;
+    obj->mapsz = st.st_size;
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (fd >= 0) close(fd);
+
+  if (ret) {
+    if (map != MAP_FAILED) munmap(map, st.st_size);
+  }
+
+  return ret;
+}
@@ -0,0 +1,220 @@
+﻿/*
+ * Bloom filter (standard / cache-line blocked)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __BLOOM_H__
+#define __BLOOM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLOOM_FLAG_BLOCKED  0x0001    // 全てのプローブを一つのキャッシュライン
+                                      // 内に置く
+
+#define BLOOM_MAX_PROBES    32
+
+/**
+ * @brief
+ *  ブルームフィルタを抽象化した型
+ *
+ * @see
+ *  struct __bloom_t__
+ */
+typedef struct __bloom_t__ bloom_t;
+
+/**
+ * @brief
+ *  ブルームフィルタの生成
+ *
+ * @param [in] n  登録するキーの数の見込み
+ * @param [in] fpp  許容する偽陽性率(0 < fpp < 1)
+ * @param [in] flags  BLOOM_FLAG_*の論理和
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  nとfppからビット数 m = -n ln(fpp) / (ln 2)^2 とプローブ数
+ *  k = (m / n) ln 2 を決定する。各キーのk個のプローブ位置は、一回の
+ *  fnv164()の結果をfnv1_mix64()で攪拌した値からダブルハッシングで導出
+ *  する。
+ *
+ * @remark
+ *  BLOOM_FLAG_BLOCKEDを指定した場合は、キー毎に64バイトのブロックを一つ選
+ *  び、k個のビットを全てそのブロック内に置く。検索時のメモリアクセスがキャ
+ *  ッシュライン一本で済む代わりに、同じビット数での偽陽性率はやや悪くなる。
+ */
+int bloom_new(size_t n, double fpp, int flags, bloom_t** dst);
+
+/**
+ * @brief
+ *  ブルームフィルタの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int bloom_destroy(bloom_t* ptr);
+
+/**
+ * @brief
+ *  キーの登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] key  キーへのポインタ
+ * @param [in] len  キーのサイズ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。読み出し専用の
+ *  オブジェクト(bloom_attach()、bloom_load()で生成したもの)に対して呼び出
+ *  した場合もエラーとなる。
+ */
+int bloom_add(bloom_t* ptr, const void* key, size_t len);
+
+/**
+ * @brief
+ *  キーの検査
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] key  キーへのポインタ
+ * @param [in] len  キーのサイズ
+ * @param [out] dst  結果の格納先(登録されている可能性があれば真、登録され
+ *                   ていなければ偽)
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int bloom_check(bloom_t* ptr, const void* key, size_t len, int* dst);
+
+/**
+ * @brief
+ *  ハッシュ値を指定したキーの登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] hv  キーのfnv164()の値
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  既にキーのFNV1ハッシュを算出済みの場合(FNV1を使用するhmap_tの
+ *  hmap_hash()の結果等)に、ハッシュの再計算を省くために使用する。
+ */
+int bloom_add_hash(bloom_t* ptr, uint64_t hv);
+
+/**
+ * @brief
+ *  ハッシュ値を指定したキーの検査
+ *
+ * @remark
+ *  キーの代わりにfnv164()の値を指定する以外はbloom_check()と同じ。
+ */
+int bloom_check_hash(bloom_t* ptr, uint64_t hv, int* dst);
+
+/**
+ * @brief
+ *  複数キーの一括登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] keys  キーへのポインタの配列
+ * @param [in] lens  キーのサイズの配列
+ * @param [in] n  キーの数
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ハッシュ値をfnv164_many()でまとめて算出し、アクセスするキャッシュライン
+ *  を先読みしてからビットを操作する。
+ */
+int bloom_add_many(bloom_t* ptr, const void* keys[], const size_t lens[],
+                   size_t n);
+
+/**
+ * @brief
+ *  複数キーの一括検査
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] keys  キーへのポインタの配列
+ * @param [in] lens  キーのサイズの配列
+ * @param [in] n  キーの数
+ * @param [out] dst  結果の格納先の配列(bloom_check()と同じ意味の値を格納)
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int bloom_check_many(bloom_t* ptr, const void* keys[], const size_t lens[],
+                     size_t n, uint8_t dst[]);
+
+/**
+ * @brief
+ *  シリアライズ形式のイメージの取得
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [out] dst  イメージの先頭アドレスの格納先
+ * @param [out] dsz  イメージのサイズの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  オブジェクトはヘッダ(64バイト)とビット列を連続した領域に保持しており、
+ *  その領域をそのまま返す(複写は行わない)。イメージはエンディアンが同じ環
+ *  境でのみ読み込める。
+ */
+int bloom_image(bloom_t* ptr, const void** dst, size_t* dsz);
+
+/**
+ * @brief
+ *  イメージを参照するオブジェクトの生成
+ *
+ * @param [in] img  イメージの先頭アドレス(8バイト境界に配置されていること)
+ * @param [in] size  イメージのサイズ
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合(イメージが不正な場合を含む)は0以
+ *  外の値を返す。
+ *
+ * @remark
+ *  イメージは複写せずに直接参照する(読み出し専用)。イメージの領域はオブジ
+ *  ェクトの破棄まで解放しないこと。
+ */
+int bloom_attach(const void* img, size_t size, bloom_t** dst);
+
+/**
+ * @brief
+ *  イメージのファイルへの書き出し
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] path  書き出し先のパス
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  path.tmpに書き出してfsync()した後にrename()で置き換えるので、
+ *  bloom_load()で同じファイルを参照している読み手には影響しない。
+ */
+int bloom_save(bloom_t* ptr, const char* path);
+
+/**
+ * @brief
+ *  ファイルからのオブジェクトの生成
+ *
+ * @param [in] path  bloom_save()で書き出したファイルのパス
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ファイルをmmap()でマップして参照する(読み出し専用、読み込み処理は行わ
+ *  ない)。マップはbloom_destroy()で解除する。
+ */
+int bloom_load(const char* path, bloom_t** dst);
+
+#endif /* !defined(__BLOOM_H__) */
@@ -0,0 +1,757 @@
+﻿/*
+ * Content-defined chunking (gear rolling hash)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENABLE_X86_ACCEL
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
+#include "sha1.h"
+#include "chunker.h"
+
+#define DEFAULT_ERROR   (__LINE__)
+#define ALLOC(t)        ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)     ((t*)malloc(sizeof(t) * (n)))
+
+#define WINDOW          64          // gearハッシュの窓の長さ(64bit分)
+#define NSLOT           2           // バッファの数(探索と算出で交互に使用)
+#define SLOT_MIN        (4 * 1024 * 1024)
+#define GEAR_SEED       0x6368756e6b657221ULL
+
+#define BIT_SET(m,i)    ((m)[(i) >> 6] |= (1ULL << ((i) & 63)))
+
+/**
+ * @brief
+ *  バッファ
+ *
+ * @remark
+ *  呼び出し元のスレッドでデータを詰めて境界を確定させた後、算出用のスレッ
+ *  ドに引き渡す(busyが立っている間は算出用のスレッドが所有する)。
+ */
+struct slot {
+  uint8_t* data;
+  size_t len;
+  uint64_t off;                 // ストリーム上でのdata[0]の位置
+
+  size_t n;                     // 確定したチャンクの数
+  const void** ptr;             // 各チャンクの先頭
+  size_t* size;                 // 各チャンクのサイズ
+  sha1_output_t* dig;           // 各チャンクのSHA1
+
+  int busy;
+};
+
+/**
+ * @brief
+ *  chunker_tの実体
+ */
+struct __chunker_t__ {
+  size_t min;
+  size_t avg;
+  size_t max;
+  uint64_t mask_s;              // 平均サイズ未満で使用する条件(厳しい方)
+  uint64_t mask_l;              // 平均サイズ以降で使用する条件(緩い方)
+
+  chunker_cb_t fn;
+  void* arg;
+
+  size_t cap;                   // バッファの容量
+  struct slot slot[NSLOT];
+  int cur;                      // データを詰めているバッファ
+  int head;                     // 算出用スレッドが次に処理するバッファ
+
+  uint64_t* map_l;              // mask_lを満たす位置のビットマップ
+  uint64_t* map_s;              // mask_sを満たす位置のビットマップ
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int stop;
+  int err;
+};
+
+static uint64_t gear[256];
+
+static void (*scan)(const chunker_t*, const uint8_t*, size_t, size_t);
+
+/*
+ * declar internal functions
+ */
+
+/**
+ * @brief
+ *  1バイト分のハッシュ値の更新と境界候補の記録
+ */
+static inline uint64_t
+roll(const chunker_t* ptr, uint64_t h, const uint8_t* data, size_t i)
+{
+  h = (h << 1) + gear[data[i]];
+
+  if (!(h & ptr->mask_l)) {
+    BIT_SET(ptr->map_l, i);
+    if (!(h & ptr->mask_s)) BIT_SET(ptr->map_s, i);
+  }
+
+  return h;
+}
+
+/**
+ * @brief
+ *  位置iの直前63バイト分のハッシュ値の算出
+ *
+ * @remark
+ *  64バイトより前のバイトは左シフトで消えるので、窓の先頭から算出した値は
+ *  ストリームの先頭から転がしてきた値と一致する。
+ */
+static inline uint64_t
+warmup(const uint8_t* data, size_t i)
+{
+  uint64_t ret;
+  size_t j;
+
+  ret = 0;
+  for (j = i - (WINDOW - 1); j < i; j++) ret = (ret << 1) + gear[data[j]];
+
+  return ret;
+}
+
+/**
+ * @brief
+ *  境界候補の探索(4区間インタリーブ)
+ *
+ * @remark
+ *  [from, to)を4つの区間に分け、各区間のハッシュ値を並べて更新する。ハッ
+ *  シュ値の更新は直前の値に依存するので、独立した区間を交互に処理すること
+ *  で依存関係による待ちを隠す。
+ */
+static void
+scan_x4(const chunker_t* ptr, const uint8_t* data, size_t from, size_t to)
+{
+  size_t seg;
+  size_t p0, p1, p2, p3;
+  uint64_t h0, h1, h2, h3;
+  size_t i;
+
+  seg = (to - from) / 4;
+
+  p0  = from;
+  p1  = p0 + seg;
+  p2  = p1 + seg;
+  p3  = p2 + seg;
+
+  if (seg > 0) {
+    h0 = warmup(data, p0);
+    h1 = warmup(data, p1);
+    h2 = warmup(data, p2);
+    h3 = warmup(data, p3);
+
+    for (i = 0; i < seg; i++) {
+      h0 = roll(ptr, h0, data, p0 + i);
+      h1 = roll(ptr, h1, data, p1 + i);
+      h2 = roll(ptr, h2, data, p2 + i);
+      h3 = roll(ptr, h3, data, p3 + i);
+    }
+  }
+
+  if (p3 + seg < to) {
+    h0 = warmup(data, p3 + seg);
+    for (i = p3 + seg; i < to; i++) h0 = roll(ptr, h0, data, i);
+  }
+}
+
+#ifdef ENABLE_X86_ACCEL
+/**
+ * @brief
+ *  境界候補の探索(AVX2)
+ *
+ * @remark
+ *  scan_x4()と同じ区間分割で、4区間のハッシュ値を一つのYMMレジスタに載せ
+ *  て更新と判定を行う。条件を満たすレーンがあった場合(まれ)のみスカラで記
+ *  録する。
+ */
+__attribute__((target("avx2")))
+static void
+scan_avx2(const chunker_t* ptr, const uint8_t* data, size_t from, size_t to)
+{
+  size_t seg;
+  size_t p[4];
+  uint64_t h0;
+  __m256i h;
+  __m256i g;
+  __m256i ml;
+  __m256i ms;
+  __m256i zero;
+  int ll;
+  int ls;
+  size_t i;
+  int j;
+
+  seg = (to - from) / 4;
+
+  for (j = 0; j < 4; j++) p[j] = from + (seg * j);
+
+  if (seg > 0) {
+    h    = _mm256_set_epi64x(warmup(data, p[3]), warmup(data, p[2]),
+                             warmup(data, p[1]), warmup(data, p[0]));
+    ml   = _mm256_set1_epi64x(ptr->mask_l);
+    ms   = _mm256_set1_epi64x(ptr->mask_s);
+    zero = _mm256_setzero_si256();
+
+    for (i = 0; i < seg; i++) {
+      g  = _mm256_set_epi64x(gear[data[p[3] + i]], gear[data[p[2] + i]],
+                             gear[data[p[1] + i]], gear[data[p[0] + i]]);
+      h  = _mm256_add_epi64(_mm256_slli_epi64(h, 1), g);
+
+      ll = _mm256_movemask_pd(_mm256_castsi256_pd(
+                      _mm256_cmpeq_epi64(_mm256_and_si256(h, ml), zero)));
+
+      if (ll) {
+        ls = _mm256_movemask_pd(_mm256_castsi256_pd(
+                      _mm256_cmpeq_epi64(_mm256_and_si256(h, ms), zero)));
+
+        for (j = 0; j < 4; j++) {
+          if (ll & (1 << j)) BIT_SET(ptr->map_l, p[j] + i);
+          if (ls & (1 << j)) BIT_SET(ptr->map_s, p[j] + i);
+        }
+      }
+    }
+  }
+
+  if (p[3] + seg < to) {
+    h0 = warmup(data, p[3] + seg);
+    for (i = p[3] + seg; i < to; i++) h0 = roll(ptr, h0, data, i);
+  }
+}
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+/**
+ * @brief
+ *  gearテーブルの生成と探索処理の選択
+ *
+ * @remark
+ *  テーブルは固定のシードからsplitmix64で生成する(境界の位置を実行環境に
+ *  依存させないため)。
+ */
+__attribute__((constructor))
+static void
+init_chunker(void)
+{
+  uint64_t x;
+  uint64_t z;
+  int i;
+
+  x = GEAR_SEED;
+
+  for (i = 0; i < 256; i++) {
+    z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    gear[i] = z ^ (z >> 31);
+  }
+
+  scan = scan_x4;
+
+#ifdef ENABLE_X86_ACCEL
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) scan = scan_avx2;
+#endif /* defined(ENABLE_X86_ACCEL) */
+}
+
+/**
+ * @brief
+ *  ビットマップ上の[lo, hi)の範囲で最初に立っているビットの探索
+ *
+ * @return
+ *  見つかった位置(見つからなかった場合はhi)
+ */
+static size_t
+find_bit(const uint64_t* map, size_t lo, size_t hi)
+{
+  uint64_t w;
+  size_t i;
+
+  if (lo >= hi) return hi;
+
+  i = lo >> 6;
+  w = map[i] & (~0ULL << (lo & 63));
+
+  while (!w) {
+    if (++i > ((hi - 1) >> 6)) return hi;
+    w = map[i];
+  }
+
+  i = (i << 6) + __builtin_ctzll(w);
+
+  return (i < hi)? i: hi;
+}
+
+/**
+ * @brief
+ *  バッファ上のチャンク境界の確定
+ *
+ * @param [in] final  ストリームの終端であれば真
+ *
+ * @return
+ *  確定したチャンクの末尾の位置(以降のデータは次のバッファに持ち越す)
+ */
+static size_t
+split(chunker_t* ptr, struct slot* sl, int final)
+{
+  size_t start;
+  size_t end;
+  size_t mid;
+  size_t hi;
+  size_t i;
+
+  memset(ptr->map_l, 0, ((sl->len >> 6) + 1) * sizeof(uint64_t));
+  memset(ptr->map_s, 0, ((sl->len >> 6) + 1) * sizeof(uint64_t));
+
+  if (sl->len >= WINDOW) scan(ptr, sl->data, WINDOW - 1, sl->len);
+
+  start = 0;
+  sl->n = 0;
+
+  while (start < sl->len) {
+    mid = start + ptr->avg - 1;
+    hi  = start + ptr->max - 1;
+
+    /* 最小サイズから平均サイズまでは厳しい条件で探す */
+    end = (mid < sl->len)? mid: sl->len;
+    i   = find_bit(ptr->map_s, start + ptr->min - 1, end);
+
+    /* 平均サイズから最大サイズまでは緩い条件で探す */
+    if (i == end && mid < sl->len) {
+      end = (hi < sl->len)? hi: sl->len;
+      i   = find_bit(ptr->map_l, mid, end);
+    }
+
+    if (i < end) {
+      end = i + 1;
+    } else if (start + ptr->max <= sl->len) {
+      end = start + ptr->max;
+    } else if (final) {
+      end = sl->len;
+    } else {
+      break;
+    }
+
+    sl->ptr[sl->n]  = sl->data + start;
+    sl->size[sl->n] = end - start;
+    sl->n++;
+
+    start = end;
+  }
+
+  return start;
+}
+
+/**
+ * @brief
+ *  算出用スレッド
+ *
+ * @remark
+ *  引き渡されたバッファを順に処理し、チャンクのSHA1を算出してコールバック
+ *  関数を呼び出す。
+ */
+static void*
+hasher(void* arg)
+{
+  chunker_t* ptr;
+  struct slot* sl;
+  int busy;
+  int err;
+  int stop;
+  size_t i;
+
+  ptr = (chunker_t*)arg;
+
+  while (1) {
+    pthread_mutex_lock(&ptr->lock);
+
+    sl = ptr->slot + ptr->head;
+    while (!sl->busy && !ptr->stop) pthread_cond_wait(&ptr->cond, &ptr->lock);
+
+    busy = sl->busy;
+    err  = ptr->err;
+    stop = ptr->stop;
+
+    pthread_mutex_unlock(&ptr->lock);
+
+    if (!busy) break;
+
+    if (!err && !stop) {
+      sha1_many(sl->ptr, sl->size, sl->n, sl->dig);
+
+      for (i = 0; i < sl->n; i++) {
+        if (ptr->fn(ptr->arg, sl->off + ((const uint8_t*)sl->ptr[i] - sl->data),
+                    sl->ptr[i], sl->size[i], sl->dig[i])) {
+          err = DEFAULT_ERROR;
+          break;
+        }
+      }
+    }
+
+    pthread_mutex_lock(&ptr->lock);
+
+    if (err) ptr->err = err;
+    sl->busy  = 0;
+    ptr->head = (ptr->head + 1) % NSLOT;
+    pthread_cond_broadcast(&ptr->cond);
+
+    pthread_mutex_unlock(&ptr->lock);
+  }
+
+  return NULL;
+}
+
+static int
+wait_slot(chunker_t* ptr, struct slot* sl)
+{
+  int ret;
+
+  pthread_mutex_lock(&ptr->lock);
+  while (sl->busy) pthread_cond_wait(&ptr->cond, &ptr->lock);
+  ret = ptr->err;
+  pthread_mutex_unlock(&ptr->lock);
+
+  return ret;
+}
+
+/**
+ * @brief
+ *  現在のバッファの境界を確定させて算出用スレッドに引き渡す
+ *
+ * @remark
+ *  確定できなかった末尾のデータは次のバッファの先頭に持ち越す。
+ *
+ * @remark
+ *  算出用スレッドはスロットを順番に待つので、チャンクが一つも確定しなかっ
+ *  た場合(空のストリームの終端等)はスロットを引き渡さず、curも進めない。
+ */
+static int
+flush(chunker_t* ptr, int final)
+{
+  int ret;
+  struct slot* sl;
+  struct slot* next;
+  size_t used;
+
+  ret  = 0;
+  sl   = ptr->slot + ptr->cur;
+  next = ptr->slot + ((ptr->cur + 1) % NSLOT);
+  used = split(ptr, sl, final);
+
+  if (sl->n > 0) {
+    ret = wait_slot(ptr, next);
+
+    if (!ret) {
+      memcpy(next->data, sl->data + used, sl->len - used);
+      next->len = sl->len - used;
+      next->off = sl->off + used;
+
+      pthread_mutex_lock(&ptr->lock);
+      sl->busy = !0;
+      pthread_cond_broadcast(&ptr->cond);
+      pthread_mutex_unlock(&ptr->lock);
+
+      sl->len  = 0;
+      ptr->cur = (ptr->cur + 1) % NSLOT;
+    }
+  }
+
+  return ret;
+}
+
+static void
+free_slots(chunker_t* ptr)
+{
+  int i;
+
+  for (i = 0; i < NSLOT; i++) {
+    if (ptr->slot[i].data != NULL) free(ptr->slot[i].data);
+    if (ptr->slot[i].ptr != NULL) free(ptr->slot[i].ptr);
+    if (ptr->slot[i].size != NULL) free(ptr->slot[i].size);
+    if (ptr->slot[i].dig != NULL) free(ptr->slot[i].dig);
+  }
+
+  if (ptr->map_l != NULL) free(ptr->map_l);
+  if (ptr->map_s != NULL) free(ptr->map_s);
+}
+
+/*
+ * declar global functions
+ */
+
+int
+chunker_new(size_t min, size_t avg, size_t max, chunker_cb_t fn, void* arg,
+            chunker_t** dst)
+{
+  int ret;
+  chunker_t* obj;
+  size_t nchunk;
+  int bits;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (fn == NULL || dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (min < CHUNKER_MIN_SIZE || max > CHUNKER_MAX_SIZE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (!(min < avg && avg < max) || (avg & (avg - 1))) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(chunker_t);
+    if (obj == NULL) {
+      ret = DEFAULT_ERROR;
+    } else {
+      memset(obj, 0, sizeof(*obj));
+    }
+  }
+
+  if (!ret) {
+    obj->cap = (max * 4 > SLOT_MIN)? max * 4: SLOT_MIN;
+    nchunk   = (obj->cap / min) + 1;
+
+    for (i = 0; i < NSLOT && !ret; i++) {
+      obj->slot[i].data = NALLOC(uint8_t, obj->cap);
+      obj->slot[i].ptr  = NALLOC(const void*, nchunk);
+      obj->slot[i].size = NALLOC(size_t, nchunk);
+      obj->slot[i].dig  = NALLOC(sha1_output_t, nchunk);
+
+      if (obj->slot[i].data == NULL || obj->slot[i].ptr == NULL ||
+          obj->slot[i].size == NULL || obj->slot[i].dig == NULL) {
+        ret = DEFAULT_ERROR;
+      }
+    }
+
+    if (!ret) {
+      obj->map_l = NALLOC(uint64_t, (obj->cap >> 6) + 1);
+      obj->map_s = NALLOC(uint64_t, (obj->cap >> 6) + 1);
+
+      if (obj->map_l == NULL || obj->map_s == NULL) ret = DEFAULT_ERROR;
+    }
+  }
+
+  /*
+   * setup object
+   *
+   *  条件はハッシュ値の上位ビットで判定する(gearハッシュの下位ビットは直近
+   *  の数バイトにしか依存しないため)。平均サイズをavg = 2^bitsとして、前半
+   *  はbits + 1ビット、後半はbits - 1ビットが0であることを条件とする。
+   */
+  if (!ret) {
+    bits        = __builtin_ctzll(avg);
+    obj->min    = min;
+    obj->avg    = avg;
+    obj->max    = max;
+    obj->mask_s = ~0ULL << (64 - (bits + 1));
+    obj->mask_l = ~0ULL << (64 - (bits - 1));
+    obj->fn     = fn;
+    obj->arg    = arg;
+
+    if (pthread_mutex_init(&obj->lock, NULL)) {
+      ret = DEFAULT_ERROR;
+    } else if (pthread_cond_init(&obj->cond, NULL)) {
+      pthread_mutex_destroy(&obj->lock);
+      ret = DEFAULT_ERROR;
+    } else if (pthread_create(&obj->thread, NULL, hasher, obj)) {
+      pthread_cond_destroy(&obj->cond);
+      pthread_mutex_destroy(&obj->lock);
+      ret = DEFAULT_ERROR;
+    }
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) {
+      free_slots(obj);
+      free(obj);
+    }
+  }
+
+  return ret;
+}
+
+int
+chunker_destroy(chunker_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * stop thread
+   */
+  if (!ret) {
+    pthread_mutex_lock(&ptr->lock);
+    ptr->stop = !0;
+    pthread_cond_broadcast(&ptr->cond);
+    pthread_mutex_unlock(&ptr->lock);
+
+    pthread_join(ptr->thread, NULL);
+  }
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    pthread_cond_destroy(&ptr->cond);
+    pthread_mutex_destroy(&ptr->lock);
+
+    free_slots(ptr);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+chunker_feed(chunker_t* ptr, const void* data, size_t size)
+{
+  int ret;
+  struct slot* sl;
+  const uint8_t* p;
+  size_t n;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  p   = (const uint8_t*)data;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (data == NULL && size > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check previous error
+   */
+  if (!ret) {
+    pthread_mutex_lock(&ptr->lock);
+    if (ptr->err) ret = DEFAULT_ERROR;
+    pthread_mutex_unlock(&ptr->lock);
+  }
+
+  /*
+   * fill buffer
+   */
+  while (!ret && size > 0) {
+    sl = ptr->slot + ptr->cur;
+    n  = ptr->cap - sl->len;
+    if (n > size) n = size;
+
+    memcpy(sl->data + sl->len, p, n);
+    sl->len += n;
+    p       += n;
+    size    -= n;
+
+    if (sl->len == ptr->cap) {
+      if (flush(ptr, 0)) ret = DEFAULT_ERROR;
+    }
+  }
+
+  return ret;
+}
+
+int
+chunker_finish(chunker_t* ptr)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * flush remaining data
+   */
+  if (!ret) {
+    if (flush(ptr, !0)) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * wait for all chunks
+   */
+  if (ptr != NULL) {
+    for (i = 0; i < NSLOT; i++) {
+      if (wait_slot(ptr, ptr->slot + i)) ret = DEFAULT_ERROR;
+    }
+  }
+
+  /*
+   * post process (新しいストリームのために状態を戻す)
+   */
+  if (ptr != NULL) {
+    for (i = 0; i < NSLOT; i++) {
+      ptr->slot[i].len = 0;
+      ptr->slot[i].off = 0;
+    }
+
+    ptr->err = 0;
+  }
+
+  return ret;
+}
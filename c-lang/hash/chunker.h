@@ -0,0 +1,124 @@
+﻿/*
+ * Content-defined chunking (gear rolling hash)
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __CHUNKER_H__
+#define __CHUNKER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha1.h"
+
+#define CHUNKER_MIN_SIZE  64                  // 最小チャンクサイズの下限
+#define CHUNKER_MAX_SIZE  (64 * 1024 * 1024)  // 最大チャンクサイズの上限
+
+/**
+ * @brief
+ *  チャンカーのコンテキストを抽象化した型
+ *
+ * @see
+ *  struct __chunker_t__
+ */
+typedef struct __chunker_t__ chunker_t;
+
+/**
+ * @brief
+ *  チャンクの通知を受けるコールバック関数の型
+ *
+ * @param [in] arg  chunker_new()で指定した任意のポインタ
+ * @param [in] off  ストリーム先頭からのチャンクの位置
+ * @param [in] data  チャンクのデータ(コールバックから戻るまで有効)
+ * @param [in] size  チャンクのサイズ
+ * @param [in] digest  チャンクのSHA1
+ *
+ * @return
+ *  処理を続ける場合は0を、中断する場合は0以外の値を返す。
+ */
+typedef int (*chunker_cb_t)(void* arg, uint64_t off, const void* data,
+                            size_t size, const sha1_output_t digest);
+
+/**
+ * @brief
+ *  チャンカーの生成
+ *
+ * @param [in] min  最小チャンクサイズ(CHUNKER_MIN_SIZE以上)
+ * @param [in] avg  平均チャンクサイズ(2の冪乗)
+ * @param [in] max  最大チャンクサイズ(CHUNKER_MAX_SIZE以下)
+ * @param [in] fn  チャンクの通知を受けるコールバック関数
+ * @param [in] arg  コールバック関数に渡す任意のポインタ(NULL可)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  チャンクの境界は直前64バイトのgearハッシュ(h = (h << 1) + G[byte])で決
+ *  定する。境界はデータの内容のみで決まるので、データの挿入や削除でずれが
+ *  生じても以降の境界は元の位置に戻る。最小サイズの手前では境界を置かず、平
+ *  均サイズまでは厳しい条件、平均サイズ以降は緩い条件で判定し(正規化チャン
+ *  キング)、最大サイズに達した場合は強制的に境界を置く。gearテーブルは固定
+ *  の値から生成するので、同じパラメータであれば実行環境によらず同じ境界と
+ *  なる。
+ *
+ * @remark
+ *  min < avg < max であること。
+ */
+int chunker_new(size_t min, size_t avg, size_t max, chunker_cb_t fn,
+                void* arg, chunker_t** dst);
+
+/**
+ * @brief
+ *  チャンカーの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  chunker_finish()を呼ばずに破棄した場合、未通知のチャンクは破棄される。
+ */
+int chunker_destroy(chunker_t* ptr);
+
+/**
+ * @brief
+ *  ストリームデータの投入
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] data  入力データへのポインタ
+ * @param [in] size  入力データのサイズ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合(コールバック関数が処理の中断を要
+ *  求した場合を含む)は0以外の値を返す。
+ *
+ * @remark
+ *  入力データは内部のバッファに複写するので、呼び出し後に再利用してよい。
+ *  境界の探索は呼び出し元のスレッドで、チャンクのSHA1算出とコールバック呼
+ *  び出しは内部のスレッドで行う(二つのバッファを交互に使用し、探索と算出を
+ *  並行して行う)。コールバック関数はストリーム上の順序で呼び出される。
+ *
+ * @remark
+ *  コールバック関数の中から同じオブジェクトに対する操作を行ってはならない。
+ */
+int chunker_feed(chunker_t* ptr, const void* data, size_t size);
+
+/**
+ * @brief
+ *  ストリームの終端処理
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  残りのデータを最後のチャンク(最小サイズ未満の場合もある)として確定させ、
+ *  全てのチャンクの通知が終わるまで待つ。処理後は新しいストリームの入力を
+ *  受け付ける状態に戻る。
+ */
+int chunker_finish(chunker_t* ptr);
+
+#endif /* !defined(__CHUNKER_H__) */
@@ -0,0 +1,553 @@
+﻿/*
+ * Count-Min sketch
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif /* defined(__SSE2__) || defined(__AVX2__) */
+
+#include "fnv1.h"
+#include "cms.h"
+
+#define DEFAULT_ERROR   (__LINE__)
+#define ALLOC(t)        ((t*)malloc(sizeof(t)))
+
+#define BATCH           16          // 一括処理でまとめて先読みするキーの数
+
+/**
+ * @brief
+ *  cms_tの実体
+ */
+struct __cms_t__ {
+  size_t width;
+  int depth;
+  int conservative;
+
+  uint32_t* cnt;                // depth行 x width列のカウンタ
+  uint64_t total;
+};
+
+/*
+ * declar internal functions
+ */
+
+/**
+ * @brief
+ *  [0, n)への写像(剰余の代わりに乗算の上位ワードを使用する)
+ */
+static inline uint64_t
+range(uint64_t x, uint64_t n)
+{
+  return (uint64_t)(((unsigned __int128)x * n) >> 64);
+}
+
+static inline uint32_t
+sat_add(uint32_t a, uint32_t b)
+{
+  uint32_t s;
+
+  s = a + b;
+
+  return (s < a)? UINT32_MAX: s;
+}
+
+/**
+ * @brief
+ *  各行のカウンタの位置の算出
+ *
+ * @remark
+ *  a + i*b (bは毎回iずつ増やす)で各行の列を導出する。
+ */
+static void
+cells(const cms_t* ptr, uint64_t h, uint32_t* dst[])
+{
+  uint64_t a;
+  uint64_t b;
+  int i;
+
+  a = h;
+  b = (h >> 32 | h << 32) | 1;
+
+  for (i = 0; i < ptr->depth; i++) {
+    dst[i] = ptr->cnt + (ptr->width * i) + range(a, ptr->width);
+    a += b;
+    b += i;
+  }
+}
+
+static void
+add_hash(cms_t* ptr, uint64_t h, uint32_t count)
+{
+  uint32_t* c[CMS_MAX_DEPTH];
+  uint32_t v;
+  int i;
+
+  cells(ptr, h, c);
+
+  if (ptr->conservative) {
+    v = UINT32_MAX;
+    for (i = 0; i < ptr->depth; i++) if (*c[i] < v) v = *c[i];
+
+    v = sat_add(v, count);
+    for (i = 0; i < ptr->depth; i++) if (*c[i] < v) *c[i] = v;
+
+  } else {
+    for (i = 0; i < ptr->depth; i++) *c[i] = sat_add(*c[i], count);
+  }
+
+  ptr->total += count;
+}
+
+static uint32_t
+query_hash(const cms_t* ptr, uint64_t h)
+{
+  uint32_t* c[CMS_MAX_DEPTH];
+  uint32_t ret;
+  int i;
+
+  cells(ptr, h, c);
+
+  ret = UINT32_MAX;
+  for (i = 0; i < ptr->depth; i++) if (*c[i] < ret) ret = *c[i];
+
+  return ret;
+}
+
+static void
+prefetch(const cms_t* ptr, uint64_t h, int rw)
+{
+  uint32_t* c[CMS_MAX_DEPTH];
+  int i;
+
+  cells(ptr, h, c);
+
+  for (i = 0; i < ptr->depth; i++) {
+    if (rw) {
+      __builtin_prefetch(c[i], 1);
+    } else {
+      __builtin_prefetch(c[i], 0);
+    }
+  }
+}
+
+static int
+check_keys(const void* keys[], const size_t lens[], size_t n)
+{
+  size_t i;
+
+  if (n > 0 && (keys == NULL || lens == NULL)) return DEFAULT_ERROR;
+
+  for (i = 0; i < n; i++) {
+    if (keys[i] == NULL && lens[i] > 0) return DEFAULT_ERROR;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief
+ *  カウンタ毎の飽和加算 (dst[i] = min(dst[i] + src[i], UINT32_MAX))
+ *
+ * @remark
+ *  符号なしの比較命令が無いので、符号ビットを反転させて符号付きで比較し、
+ *  桁あふれしたレーン(和が元の値より小さいレーン)を全ビット1にする。
+ */
+static void
+cnt_add(uint32_t* dst, const uint32_t* src, size_t n)
+{
+  size_t i;
+
+  i = 0;
+
+#if defined(__AVX2__)
+  {
+    __m256i bias = _mm256_set1_epi32((int)0x80000000);
+    __m256i a;
+    __m256i s;
+
+    for (; i + 8 <= n; i += 8) {
+      a = _mm256_loadu_si256((const __m256i*)(dst + i));
+      s = _mm256_add_epi32(a, _mm256_loadu_si256((const __m256i*)(src + i)));
+      s = _mm256_or_si256(s, _mm256_cmpgt_epi32(_mm256_xor_si256(a, bias),
+                                                _mm256_xor_si256(s, bias)));
+      _mm256_storeu_si256((__m256i*)(dst + i), s);
+    }
+  }
+#endif /* defined(__AVX2__) */
+
+#if defined(__SSE2__)
+  {
+    __m128i bias = _mm_set1_epi32((int)0x80000000);
+    __m128i a;
+    __m128i s;
+
+    for (; i + 4 <= n; i += 4) {
+      a = _mm_loadu_si128((const __m128i*)(dst + i));
+      s = _mm_add_epi32(a, _mm_loadu_si128((const __m128i*)(src + i)));
+      s = _mm_or_si128(s, _mm_cmpgt_epi32(_mm_xor_si128(a, bias),
+                                          _mm_xor_si128(s, bias)));
+      _mm_storeu_si128((__m128i*)(dst + i), s);
+    }
+  }
+#endif /* defined(__SSE2__) */
+
+  for (; i < n; i++) dst[i] = sat_add(dst[i], src[i]);
+}
+
+/*
+ * declar global functions
+ */
+
+int
+cms_new(size_t width, int depth, int flags, cms_t** dst)
+{
+  int ret;
+  cms_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (width == 0 || depth < 1 || depth > CMS_MAX_DEPTH) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (width > SIZE_MAX / sizeof(uint32_t) / depth) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (flags & ~CMS_FLAG_CONSERVATIVE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(cms_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    obj->cnt = (uint32_t*)calloc(width * depth, sizeof(uint32_t));
+    if (obj->cnt == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->width        = width;
+    obj->depth        = depth;
+    obj->conservative = !!(flags & CMS_FLAG_CONSERVATIVE);
+    obj->total        = 0;
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+cms_destroy(cms_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    free(ptr->cnt);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cms_add(cms_t* ptr, const void* key, size_t len, uint32_t count)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || (key == NULL && len > 0)) ret = DEFAULT_ERROR;
+
+  /*
+   * update counters
+   */
+  if (!ret) add_hash(ptr, fnv1_mix64(fnv164((void*)key, len)), count);
+
+  return ret;
+}
+
+int
+cms_add_hash(cms_t* ptr, uint64_t hv, uint32_t count)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * update counters
+   */
+  if (!ret) add_hash(ptr, fnv1_mix64(hv), count);
+
+  return ret;
+}
+
+int
+cms_add_many(cms_t* ptr, const void* keys[], const size_t lens[],
+             const uint32_t counts[], size_t n)
+{
+  int ret;
+  uint64_t hv[BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  } else {
+    ret = check_keys(keys, lens, n);
+  }
+
+  /*
+   * update counters
+   *
+   *  BATCH個ずつハッシュ値を求めて先読みを発行し、その後で更新する。
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = (n - i < BATCH)? n - i: BATCH;
+
+      fnv164_many((void**)keys + i, (size_t*)lens + i, m, hv);
+
+      for (j = 0; j < m; j++) {
+        hv[j] = fnv1_mix64(hv[j]);
+        prefetch(ptr, hv[j], 1);
+      }
+
+      for (j = 0; j < m; j++) {
+        add_hash(ptr, hv[j], (counts != NULL)? counts[i + j]: 1);
+      }
+    }
+  }
+
+  return ret;
+}
+
+int
+cms_query(cms_t* ptr, const void* key, size_t len, uint32_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || (key == NULL && len > 0) || dst == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * estimate
+   */
+  if (!ret) *dst = query_hash(ptr, fnv1_mix64(fnv164((void*)key, len)));
+
+  return ret;
+}
+
+int
+cms_query_hash(cms_t* ptr, uint64_t hv, uint32_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * estimate
+   */
+  if (!ret) *dst = query_hash(ptr, fnv1_mix64(hv));
+
+  return ret;
+}
+
+int
+cms_query_many(cms_t* ptr, const void* keys[], const size_t lens[],
+               size_t n, uint32_t dst[])
+{
+  int ret;
+  uint64_t hv[BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || (n > 0 && dst == NULL)) {
+    ret = DEFAULT_ERROR;
+  } else {
+    ret = check_keys(keys, lens, n);
+  }
+
+  /*
+   * estimate
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = (n - i < BATCH)? n - i: BATCH;
+
+      fnv164_many((void**)keys + i, (size_t*)lens + i, m, hv);
+
+      for (j = 0; j < m; j++) {
+        hv[j] = fnv1_mix64(hv[j]);
+        prefetch(ptr, hv[j], 0);
+      }
+
+      for (j = 0; j < m; j++) dst[i + j] = query_hash(ptr, hv[j]);
+    }
+  }
+
+  return ret;
+}
+
+int
+cms_total(cms_t* ptr, uint64_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * put return parameter
+   */
+  if (!ret) *dst = ptr->total;
+
+  return ret;
+}
+
+int
+cms_merge(cms_t* ptr, cms_t* src)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || src == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->width != src->width || ptr->depth != src->depth) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * merge
+   */
+  if (!ret) {
+    cnt_add(ptr->cnt, src->cnt, ptr->width * ptr->depth);
+    ptr->total += src->total;
+  }
+
+  return ret;
+}
@@ -0,0 +1,172 @@
+﻿/*
+ * Count-Min sketch
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __CMS_H__
+#define __CMS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CMS_FLAG_CONSERVATIVE   0x0001    // 保守的更新を行う
+
+#define CMS_MAX_DEPTH           16
+
+/**
+ * @brief
+ *  Count-Minスケッチのコンテキストを抽象化した型
+ *
+ * @see
+ *  struct __cms_t__
+ */
+typedef struct __cms_t__ cms_t;
+
+/**
+ * @brief
+ *  Count-Minスケッチオブジェクトの生成
+ *
+ * @param [in] width  各行のカウンタ数
+ * @param [in] depth  行数(1〜CMS_MAX_DEPTH)
+ * @param [in] flags  CMS_FLAG_*の論理和
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  推定値は真の値以上となり、確率 1 - e^-depth で「真の値 + 総数 * e /
+ *  width」以下となる。各行の列はfnv164()の値をfnv1_mix64()で攪拌した値か
+ *  らダブルハッシングで導出する(キー一つにつきハッシュ計算は一回)。カウン
+ *  タは32ビットで、上限で飽和する。
+ *
+ * @remark
+ *  CMS_FLAG_CONSERVATIVEを指定した場合は、最小値を更新後の推定値まで引き上
+ *  げるのに必要なカウンタのみを更新する(頻出キー以外の過大評価が減る)。
+ */
+int cms_new(size_t width, int depth, int flags, cms_t** dst);
+
+/**
+ * @brief
+ *  Count-Minスケッチオブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int cms_destroy(cms_t* ptr);
+
+/**
+ * @brief
+ *  キーの出現の登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] key  キーへのポインタ
+ * @param [in] len  キーのサイズ
+ * @param [in] count  出現回数
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int cms_add(cms_t* ptr, const void* key, size_t len, uint32_t count);
+
+/**
+ * @brief
+ *  ハッシュ値を指定したキーの出現の登録
+ *
+ * @remark
+ *  キーの代わりにfnv164()の値を指定する以外はcms_add()と同じ。
+ */
+int cms_add_hash(cms_t* ptr, uint64_t hv, uint32_t count);
+
+/**
+ * @brief
+ *  複数キーの出現の一括登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] keys  キーへのポインタの配列
+ * @param [in] lens  キーのサイズの配列
+ * @param [in] counts  出現回数の配列(NULLの場合は全て1)
+ * @param [in] n  キーの数
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ハッシュ値をfnv164_many()でまとめて算出し、更新するカウンタを先読みし
+ *  てから更新する。
+ */
+int cms_add_many(cms_t* ptr, const void* keys[], const size_t lens[],
+                 const uint32_t counts[], size_t n);
+
+/**
+ * @brief
+ *  キーの出現回数の推定
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] key  キーへのポインタ
+ * @param [in] len  キーのサイズ
+ * @param [out] dst  推定値の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int cms_query(cms_t* ptr, const void* key, size_t len, uint32_t* dst);
+
+/**
+ * @brief
+ *  ハッシュ値を指定したキーの出現回数の推定
+ *
+ * @remark
+ *  キーの代わりにfnv164()の値を指定する以外はcms_query()と同じ。
+ */
+int cms_query_hash(cms_t* ptr, uint64_t hv, uint32_t* dst);
+
+/**
+ * @brief
+ *  複数キーの出現回数の一括推定
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] keys  キーへのポインタの配列
+ * @param [in] lens  キーのサイズの配列
+ * @param [in] n  キーの数
+ * @param [out] dst  推定値の格納先の配列
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int cms_query_many(cms_t* ptr, const void* keys[], const size_t lens[],
+                   size_t n, uint32_t dst[]);
+
+/**
+ * @brief
+ *  登録された出現回数の総数の取得
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [out] dst  総数の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int cms_total(cms_t* ptr, uint64_t* dst);
+
+/**
+ * @brief
+ *  他のオブジェクトの内容の併合
+ *
+ * @param [in] ptr  併合先のオブジェクトのポインタ
+ * @param [in] src  併合元のオブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合(widthまたはdepthが異なる場合を含
+ *  む)は0以外の値を返す。
+ *
+ * @remark
+ *  カウンタ毎の(飽和)加算をSIMD命令(SSE2/AVX2)でまとめて行う。スレッド毎
+ *  に集計したオブジェクトをまとめる場合に使用する。保守的更新を行ったオブ
+ *  ジェクト同士の併合結果も真の値の上界となる。
+ */
+int cms_merge(cms_t* ptr, cms_t* src);
+
+#endif /* !defined(__CMS_H__) */
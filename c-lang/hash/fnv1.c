@@ -1,26 +1,61 @@
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include "fnv1.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENABLE_X86_ACCEL
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
 #define FNV132_INIT       0x811c9dc5L
 #define FNV164_INIT       0xcbf29ce484222325LL
 
 // 以下のマジックナンバーを使えば5個のシフト結果の加算を
 // 1個の乗算に置き換えられる
-#define FNV132_PRIME      0x01000193;
+#define FNV132_PRIME      0x01000193
+
+// 64bit版FNVの本来の係数(2^40 + 0x1b3)
+#define FNV164_PRIME      0x00000100000001b3ULL
+
+// fnv1_fast64()のレーン数(一回の反復で処理するワード数)
+#define FAST_LANES        4
+
+// fnv164_many()のAVX2版で一組として処理するキーの数(4キー×4ベクタ)
+#define MANY_KEYS         16
+#define MANY_MIN          16
+
+// リトルエンディアンでの8バイトの読み出し
+static inline uint64_t
+read64(const uint8_t* p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof(v));
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  v = __builtin_bswap64(v);
+#endif /* __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ */
+
+  return v;
+}
 
 static uint64_t
 fnv(uint8_t* src, size_t size, uint64_t seed)
 {
-  int i;
+  size_t i;
 
-  for (i = 0; i < (int)size; i++) {
-    seed += (seed <<  1) +
-            (seed <<  4) +
-            (seed <<  7) +
-            (seed <<  8) +
-            (seed << 24);
-    // seed *= FNV132_PRIME;
+  for (i = 0; i < size; i++) {
+    /*
+     * 以下の乗算は次の処理と同じ(64bitの剰余系では同じ値になる)
+     *
+     *   seed += (seed <<  1) +
+     *           (seed <<  4) +
+     *           (seed <<  7) +
+     *           (seed <<  8) +
+     *           (seed << 24);
+     */
+    seed *= FNV132_PRIME;
     seed ^= src[i];
   }
 
@@ -38,3 +73,407 @@ fnv164(void* src, size_t size)
 {
   return fnv(src, size, FNV164_INIT);
 }
+
+/*
+ * AVX2の使用可否(プロセス起動時に一度だけ判定する)
+ *
+ *  AVX2版の関数はtarget属性で個別にコンパイルするので、-mavx2無しでビル
+ *  ドしても実行環境がAVX2に対応していれば使用される。
+ */
+#ifdef ENABLE_X86_ACCEL
+static int use_avx2 = 0;
+
+__attribute__((constructor))
+static void
+select_impl(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) use_avx2 = !0;
+}
+
+/*
+ * 64bit×32bit乗算(FNV132_PRIME)のAVX2による代替
+ *
+ *  FNV132_PRIMEは32bitに収まるので、x * FNV132_PRIME = lo(x) * P +
+ *  ((hi(x) * P) << 32)として32bit乗算2回とシフト及び加算で求める。
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+mul_prime32(__m256i x)
+{
+  __m256i k;
+  __m256i lo;
+  __m256i hi;
+
+  k  = _mm256_set1_epi64x(FNV132_PRIME);
+  lo = _mm256_mul_epu32(x, k);
+  hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), k);
+
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+// 四つのキーの同じ位置から8バイトずつをベクタに読み込む
+__attribute__((target("avx2")))
+static inline __m256i
+load4(uint8_t* p[4], size_t j)
+{
+  return _mm256_set_epi64x(read64(p[3] + j), read64(p[2] + j),
+                           read64(p[1] + j), read64(p[0] + j));
+}
+
+/*
+ * MANY_KEYS個のキーを共通の長さ(8バイト単位)まで処理する
+ *
+ *  ベクタの各要素を一つのキーに割り当て、各キーから8バイトずつ読み込んで
+ *  下位のバイトから順に一バイトずつ演算する。四本のベクタは互いに独立し
+ *  ているので、乗算の遅延を隠すことができる(配列に置くとメモリ経由の依存
+ *  になるので、ベクタは個別の変数で保持する)。処理したバイト数を返す。
+ */
+__attribute__((target("avx2")))
+static size_t
+many_avx2(uint8_t* p[MANY_KEYS], size_t m, uint64_t h[MANY_KEYS])
+{
+  size_t j;
+  int b;
+  __m256i v0;
+  __m256i v1;
+  __m256i v2;
+  __m256i v3;
+  __m256i w0;
+  __m256i w1;
+  __m256i w2;
+  __m256i w3;
+  __m256i mask;
+
+  m   -= m % 8;
+  mask = _mm256_set1_epi64x(0xff);
+
+  v0 = v1 = v2 = v3 = _mm256_set1_epi64x(FNV164_INIT);
+
+  for (j = 0; j < m; j += 8) {
+    w0 = load4(p +  0, j);
+    w1 = load4(p +  4, j);
+    w2 = load4(p +  8, j);
+    w3 = load4(p + 12, j);
+
+    for (b = 0; b < 8; b++) {
+      v0 = _mm256_xor_si256(mul_prime32(v0), _mm256_and_si256(w0, mask));
+      v1 = _mm256_xor_si256(mul_prime32(v1), _mm256_and_si256(w1, mask));
+      v2 = _mm256_xor_si256(mul_prime32(v2), _mm256_and_si256(w2, mask));
+      v3 = _mm256_xor_si256(mul_prime32(v3), _mm256_and_si256(w3, mask));
+
+      w0 = _mm256_srli_epi64(w0, 8);
+      w1 = _mm256_srli_epi64(w1, 8);
+      w2 = _mm256_srli_epi64(w2, 8);
+      w3 = _mm256_srli_epi64(w3, 8);
+    }
+  }
+
+  _mm256_storeu_si256((__m256i*)(h +  0), v0);
+  _mm256_storeu_si256((__m256i*)(h +  4), v1);
+  _mm256_storeu_si256((__m256i*)(h +  8), v2);
+  _mm256_storeu_si256((__m256i*)(h + 12), v3);
+
+  return m;
+}
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+/*
+ * 四つのキーの交互処理
+ *
+ *  p[j]からlen[j]バイトをh[j]を初期値として処理し、結果をh[j]に返す。四つ
+ *  のキーに共通する長さまでは交互に処理して依存関係の無い乗算を並べ、残り
+ *  はキー毎に処理する。
+ */
+static void
+many_x4(uint8_t* p[4], size_t len[4], uint64_t h[4])
+{
+  size_t j;
+  size_t m;
+  uint8_t* p0;
+  uint8_t* p1;
+  uint8_t* p2;
+  uint8_t* p3;
+  uint64_t h0;
+  uint64_t h1;
+  uint64_t h2;
+  uint64_t h3;
+
+  p0 = p[0];
+  p1 = p[1];
+  p2 = p[2];
+  p3 = p[3];
+
+  h0 = h[0];
+  h1 = h[1];
+  h2 = h[2];
+  h3 = h[3];
+
+  m = len[0];
+  if (len[1] < m) m = len[1];
+  if (len[2] < m) m = len[2];
+  if (len[3] < m) m = len[3];
+
+  for (j = 0; j < m; j++) {
+    h0 = (h0 * FNV132_PRIME) ^ p0[j];
+    h1 = (h1 * FNV132_PRIME) ^ p1[j];
+    h2 = (h2 * FNV132_PRIME) ^ p2[j];
+    h3 = (h3 * FNV132_PRIME) ^ p3[j];
+  }
+
+  // 共通の長さを超えた分はキー毎に処理
+  h[0] = fnv(p0 + m, len[0] - m, h0);
+  h[1] = fnv(p1 + m, len[1] - m, h1);
+  h[2] = fnv(p2 + m, len[2] - m, h2);
+  h[3] = fnv(p3 + m, len[3] - m, h3);
+}
+
+/*
+ * 複数のキーの一括処理(fnv164()と同じ値を返す)
+ *
+ *  FNV1は一バイト毎に前の結果に依存するので、一つのキーの処理は乗算の遅延
+ *  で律速される。AVX2が使用可能な場合はMANY_KEYS個のキーを一組としてベク
+ *  タの各要素に割り当て、全てのキーに共通する長さまでを同時に処理する。残
+ *  り(及びAVX2が使用できない場合の全体)は四つのキーを交互に処理して、乗算
+ *  器を遊ばせないようにする。
+ */
+void
+fnv164_many(void* src[], size_t sizes[], size_t n, uint64_t dst[])
+{
+  size_t i;
+  size_t k;
+  uint8_t* p[4];
+  size_t len[4];
+  uint64_t h[4];
+
+  i = 0;
+
+#ifdef ENABLE_X86_ACCEL
+  if (use_avx2) {
+    size_t j;
+    size_t m;
+    uint8_t* pv[MANY_KEYS];
+    uint64_t hv[MANY_KEYS];
+
+    for (; i + MANY_KEYS <= n; i += MANY_KEYS) {
+      m = sizes[i];
+
+      for (j = 0; j < MANY_KEYS; j++) {
+        pv[j] = src[i + j];
+        if (sizes[i + j] < m) m = sizes[i + j];
+      }
+
+      // 共通部分が短い場合は交互処理の方が速い
+      m = (m >= MANY_MIN)? many_avx2(pv, m, hv): 0;
+
+      for (j = 0; j < MANY_KEYS; j += 4) {
+        for (k = 0; k < 4; k++) {
+          p[k]   = pv[j + k] + m;
+          len[k] = sizes[i + j + k] - m;
+          h[k]   = (m > 0)? hv[j + k]: FNV164_INIT;
+        }
+
+        many_x4(p, len, h);
+        for (k = 0; k < 4; k++) dst[i + j + k] = h[k];
+      }
+    }
+  }
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+  for (; i + 4 <= n; i += 4) {
+    for (k = 0; k < 4; k++) {
+      p[k]   = src[i + k];
+      len[k] = sizes[i + k];
+      h[k]   = FNV164_INIT;
+    }
+
+    many_x4(p, len, h);
+    for (k = 0; k < 4; k++) dst[i + k] = h[k];
+  }
+
+  for (; i < n; i++) dst[i] = fnv(src[i], sizes[i], FNV164_INIT);
+}
+
+/*
+ * 高速版(fnv1_fast64)
+ *
+ *  FNV-1aの演算(XORしてから乗算)を1バイトではなく8バイト(リトルエンディ
+ *  アンで読んだワード)単位で行う。連続するワードはFAST_LANES本のレーンに
+ *  順に割り当て、レーン毎に独立して計算する(レーン間に依存関係が無いので
+ *  乗算を並列に実行できる)。8バイトに満たない末尾はレーン0で1バイト単位
+ *  のFNV-1aとして処理し、最後に各レーンと入力長を畳み込む。
+ *
+ *  レーンの畳み込みは、それまでの値を撹拌してから次のレーンをXORする。単
+ *  純にXORして乗算するだけでは、二つのレーンが同じ値になった時点で互いに
+ *  打ち消して0になり、他のレーンの値に関係なく同じ結果になってしまう(初期
+ *  値の差しか無いレーン同士では、ワードの差を初期値の差に合わせるだけで
+ *  衝突を作れる)。撹拌を挟むとレーンの順序も結果に反映される。
+ *
+ *  ワード単位の乗算では入力の上位bitが結果の下位bitに伝搬しないので、ハッ
+ *  シュテーブル等で下位bitを使用しても偏らないように最後にも撹拌を行う。
+ *  fnv164()とは異なる値を返す。
+ */
+
+// レーン毎の初期値(互いに無関係な定数)
+static const uint64_t fast_seed[FAST_LANES] = {
+  FNV164_INIT,
+  0x9e3779b97f4a7c15ULL,
+  0xc2b2ae3d27d4eb4fULL,
+  0x165667b19e3779f9ULL,
+};
+
+static inline void
+fast_init(uint64_t h[FAST_LANES])
+{
+  int i;
+
+  for (i = 0; i < FAST_LANES; i++) h[i] = fast_seed[i];
+}
+
+/*
+ * ワード位置wから末尾までを処理して最終値を返す
+ */
+static uint64_t
+fast_finish(uint64_t h[FAST_LANES], const uint8_t* src, size_t size, size_t w)
+{
+  size_t nw;
+  size_t i;
+  uint64_t ret;
+
+  nw = size / 8;
+
+  for (; w < nw && (w % FAST_LANES) != 0; w++) {
+    h[w % FAST_LANES] = (h[w % FAST_LANES] ^ read64(src + w * 8)) * FNV164_PRIME;
+  }
+
+  for (; w + FAST_LANES <= nw; w += FAST_LANES) {
+    h[0] = (h[0] ^ read64(src + w * 8 +  0)) * FNV164_PRIME;
+    h[1] = (h[1] ^ read64(src + w * 8 +  8)) * FNV164_PRIME;
+    h[2] = (h[2] ^ read64(src + w * 8 + 16)) * FNV164_PRIME;
+    h[3] = (h[3] ^ read64(src + w * 8 + 24)) * FNV164_PRIME;
+  }
+
+  for (; w < nw; w++) {
+    h[w % FAST_LANES] = (h[w % FAST_LANES] ^ read64(src + w * 8)) * FNV164_PRIME;
+  }
+
+  for (i = nw * 8; i < size; i++) h[0] = (h[0] ^ src[i]) * FNV164_PRIME;
+
+  ret = h[0];
+  for (i = 1; i < FAST_LANES; i++) ret = fnv1_mix64(ret) ^ h[i];
+
+  return fnv1_mix64(ret ^ (uint64_t)size);
+}
+
+uint64_t
+fnv1_fast64(void* src, size_t size)
+{
+  uint64_t h[FAST_LANES];
+
+  fast_init(h);
+
+  return fast_finish(h, src, size, 0);
+}
+
+#ifdef ENABLE_X86_ACCEL
+/*
+ * 64bit乗算(FNV164_PRIME)のAVX2による代替
+ *
+ *  AVX2には64bit同士の乗算命令が無いが、FNV164_PRIMEは2^40 + 0x1b3なので
+ *  x * FNV164_PRIME = x * 0x1b3 + (x << 40) として32bit乗算2回で求める。
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+mul_prime(__m256i x)
+{
+  __m256i k;
+  __m256i lo;
+  __m256i hi;
+
+  k  = _mm256_set1_epi64x(0x1b3);
+  lo = _mm256_mul_epu32(x, k);
+  hi = _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), k), 32);
+
+  return _mm256_add_epi64(_mm256_add_epi64(lo, hi), _mm256_slli_epi64(x, 40));
+}
+
+/*
+ * fnv1_fast64_many()のAVX2版
+ *
+ *  四つのキーを一組とし、ベクタの各要素を一つのキーに割り当てて、全ての
+ *  キーに共通するワード数までを同時に処理する。残りはキー毎に処理する。処
+ *  理したキーの数(4の倍数)を返す。
+ */
+__attribute__((target("avx2")))
+static size_t
+fast_many_avx2(void* src[], size_t sizes[], size_t n, uint64_t dst[])
+{
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t m;
+  const uint8_t* p[4];
+  uint64_t h[4][FAST_LANES];
+  __m256i v[FAST_LANES];
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    m = sizes[i] / 8;
+
+    for (j = 0; j < 4; j++) {
+      p[j] = src[i + j];
+      if (sizes[i + j] / 8 < m) m = sizes[i + j] / 8;
+    }
+
+    // 一巡(FAST_LANESワード)単位で処理する
+    m -= m % FAST_LANES;
+
+    for (k = 0; k < FAST_LANES; k++) {
+      v[k] = _mm256_set1_epi64x((long long)fast_seed[k]);
+    }
+
+    for (j = 0; j < m; j += FAST_LANES) {
+      for (k = 0; k < FAST_LANES; k++) {
+        v[k] = _mm256_xor_si256(v[k],
+                                _mm256_set_epi64x(read64(p[3] + (j + k) * 8),
+                                                  read64(p[2] + (j + k) * 8),
+                                                  read64(p[1] + (j + k) * 8),
+                                                  read64(p[0] + (j + k) * 8)));
+        v[k] = mul_prime(v[k]);
+      }
+    }
+
+    for (k = 0; k < FAST_LANES; k++) {
+      uint64_t t[4];
+
+      _mm256_storeu_si256((__m256i*)t, v[k]);
+      for (j = 0; j < 4; j++) h[j][k] = t[j];
+    }
+
+    for (j = 0; j < 4; j++) {
+      dst[i + j] = fast_finish(h[j], p[j], sizes[i + j], m);
+    }
+  }
+
+  return i;
+}
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+/*
+ * 複数のキーの一括処理(fnv1_fast64()と同じ値を返す)
+ *
+ *  AVX2が使用可能な場合はfast_many_avx2()で四つずつ処理し、残りはキー毎に
+ *  処理する。
+ */
+void
+fnv1_fast64_many(void* src[], size_t sizes[], size_t n, uint64_t dst[])
+{
+  size_t i;
+
+  i = 0;
+
+#ifdef ENABLE_X86_ACCEL
+  if (use_avx2) i = fast_many_avx2(src, sizes, n, dst);
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+  for (; i < n; i++) dst[i] = fnv1_fast64(src[i], sizes[i]);
+}
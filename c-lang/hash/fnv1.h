@@ -20,6 +20,32 @@ extern "C" {
 
 API_SPEC uint32_t fnv132(void* src, size_t size);
 API_SPEC uint64_t fnv164(void* src, size_t size);
+API_SPEC void fnv164_many(void* src[], size_t sizes[], size_t n, uint64_t dst[]);
+
+/*
+ * 8バイト単位・複数レーンで処理する高速版(fnv164()とは異なる値を返す)
+ */
+API_SPEC uint64_t fnv1_fast64(void* src, size_t size);
+API_SPEC void fnv1_fast64_many(void* src[], size_t sizes[], size_t n, uint64_t dst[]);
+
+/*
+ * 64bitのハッシュ値の攪拌(MurmurHash3のfmix64)
+ *
+ *  fnv164()の値は下位ビットの偏りが大きいので、テーブルの添字やプローブ位置
+ *  の導出に使う前にこの関数で全ビットに行き渡らせる。bloom/hll/cmsの
+ *  *_add_hash()等はfnv164()の値を受け取り、内部でこの関数を適用する。
+ */
+static inline uint64_t
+fnv1_mix64(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
 
 #ifdef __cplusplus
 }
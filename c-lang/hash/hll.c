@@ -0,0 +1,610 @@
+﻿/*
+ * HyperLogLog cardinality estimator
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif /* defined(__SSE2__) || defined(__AVX2__) */
+
+#include "fnv1.h"
+#include "hll.h"
+
+#define DEFAULT_ERROR   (__LINE__)
+#define ALLOC(t)        ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)     ((t*)malloc(sizeof(t) * (n)))
+
+#define SP_BITS         25          // 疎な表現でのインデックスのビット数
+#define TMP_SIZE        256         // 疎な表現の未整列の追加分の上限
+#define BATCH           16          // 一括登録でまとめてハッシュ値を求める数
+
+/*
+ * 疎な表現の要素は「25ビットのインデックス << 6 | 値」とする(整列すると同
+ * じインデックスの要素は値の昇順に並ぶ)
+ */
+#define SP_ENTRY(i,r)   (((uint32_t)(i) << 6) | (uint32_t)(r))
+#define SP_INDEX(e)     ((e) >> 6)
+#define SP_RANK(e)      ((e) & 0x3f)
+
+/**
+ * @brief
+ *  hll_tの実体
+ */
+struct __hll_t__ {
+  int p;
+  size_t m;                     // レジスタ数
+
+  uint8_t* reg;                 // 密な表現のレジスタ(疎な表現の間はNULL)
+
+  uint32_t* sp;                 // 疎な表現の要素(整列済み)
+  size_t nsp;
+  size_t limit;                 // 密な表現に切り替える要素数
+
+  uint32_t tmp[TMP_SIZE];       // 疎な表現への未整列の追加分
+  size_t ntmp;
+};
+
+/*
+ * declar internal functions
+ */
+
+static int
+cmp_u32(const void* a, const void* b)
+{
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief
+ *  疎な表現の要素からのレジスタ番号と値の復元
+ *
+ * @remark
+ *  インデックスの下位(25 - p)ビットはハッシュ値のpビット目以降の先頭部分
+ *  なので、そこに1が立っていればその位置から、全て0であれば要素の値に
+ *  (25 - p)を加えたものが密な表現での値となる。
+ */
+static inline void
+sp_to_reg(const hll_t* ptr, uint32_t e, size_t* idx, uint8_t* rank)
+{
+  uint32_t sub;
+  int w;
+
+  w    = SP_BITS - ptr->p;
+  sub  = SP_INDEX(e) & ((1U << w) - 1);
+  *idx = SP_INDEX(e) >> w;
+
+  if (sub) {
+    *rank = (uint8_t)(__builtin_clz(sub) - (32 - w) + 1);
+  } else {
+    *rank = (uint8_t)(w + SP_RANK(e));
+  }
+}
+
+static inline void
+reg_set(uint8_t* reg, size_t idx, uint8_t rank)
+{
+  if (reg[idx] < rank) reg[idx] = rank;
+}
+
+/**
+ * @brief
+ *  レジスタ毎の最大値の算出 (dst[i] = max(dst[i], src[i]))
+ */
+static void
+reg_max(uint8_t* dst, const uint8_t* src, size_t m)
+{
+  size_t i;
+
+  i = 0;
+
+#if defined(__AVX2__)
+  for (; i + 32 <= m; i += 32) {
+    _mm256_storeu_si256((__m256i*)(dst + i),
+        _mm256_max_epu8(_mm256_loadu_si256((const __m256i*)(dst + i)),
+                        _mm256_loadu_si256((const __m256i*)(src + i))));
+  }
+#endif /* defined(__AVX2__) */
+
+#if defined(__SSE2__)
+  for (; i + 16 <= m; i += 16) {
+    _mm_storeu_si128((__m128i*)(dst + i),
+        _mm_max_epu8(_mm_loadu_si128((const __m128i*)(dst + i)),
+                     _mm_loadu_si128((const __m128i*)(src + i))));
+  }
+#endif /* defined(__SSE2__) */
+
+  for (; i < m; i++) reg_set(dst, i, src[i]);
+}
+
+/**
+ * @brief
+ *  疎な表現の未整列分の併合
+ *
+ * @remark
+ *  未整列分を整列して後ろから併合し、同じインデックスの要素は値の最大のもの
+ *  だけを残す。
+ */
+static void
+sp_flush(hll_t* ptr)
+{
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t n;
+
+  if (ptr->ntmp == 0) return;
+
+  qsort(ptr->tmp, ptr->ntmp, sizeof(uint32_t), cmp_u32);
+
+  i = ptr->nsp;
+  j = ptr->ntmp;
+  k = ptr->nsp + ptr->ntmp;
+
+  while (j > 0) {
+    if (i > 0 && ptr->sp[i - 1] > ptr->tmp[j - 1]) {
+      ptr->sp[--k] = ptr->sp[--i];
+    } else {
+      ptr->sp[--k] = ptr->tmp[--j];
+    }
+  }
+
+  n = ptr->nsp + ptr->ntmp;
+  k = 0;
+
+  for (i = 0; i < n; i++) {
+    if (i + 1 < n && SP_INDEX(ptr->sp[i]) == SP_INDEX(ptr->sp[i + 1])) continue;
+    ptr->sp[k++] = ptr->sp[i];
+  }
+
+  ptr->nsp  = k;
+  ptr->ntmp = 0;
+}
+
+/**
+ * @brief
+ *  密な表現への切り替え
+ */
+static int
+to_dense(hll_t* ptr)
+{
+  int ret;
+  size_t idx;
+  uint8_t rank;
+  size_t i;
+
+  ret = 0;
+
+  if (ptr->reg == NULL) {
+    sp_flush(ptr);
+
+    ptr->reg = (uint8_t*)calloc(ptr->m, 1);
+    if (ptr->reg == NULL) ret = DEFAULT_ERROR;
+
+    if (!ret) {
+      for (i = 0; i < ptr->nsp; i++) {
+        sp_to_reg(ptr, ptr->sp[i], &idx, &rank);
+        reg_set(ptr->reg, idx, rank);
+      }
+
+      free(ptr->sp);
+      ptr->sp  = NULL;
+      ptr->nsp = 0;
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * @brief
+ *  未整列分の併合(必要であれば密な表現に切り替える)
+ *
+ * @remark
+ *  spの領域はlimit + TMP_SIZE要素分しか無いので、併合後にlimitを超えた場合
+ *  は必ず密な表現に切り替える。to_dense()以外からはsp_flush()を直接呼ばず、
+ *  併合は常にこの関数を通すこと。
+ */
+static int
+sp_flush_or_promote(hll_t* ptr)
+{
+  int ret;
+
+  ret = 0;
+
+  sp_flush(ptr);
+  if (ptr->nsp > ptr->limit) ret = to_dense(ptr);
+
+  return ret;
+}
+
+/**
+ * @brief
+ *  疎な表現への要素の追加(表現に応じて振り分ける)
+ */
+static int
+add_entry(hll_t* ptr, uint32_t e)
+{
+  int ret;
+  size_t idx;
+  uint8_t rank;
+
+  ret = 0;
+
+  if (ptr->reg != NULL) {
+    sp_to_reg(ptr, e, &idx, &rank);
+    reg_set(ptr->reg, idx, rank);
+
+  } else {
+    ptr->tmp[ptr->ntmp++] = e;
+
+    if (ptr->ntmp == TMP_SIZE) ret = sp_flush_or_promote(ptr);
+  }
+
+  return ret;
+}
+
+static int
+add_hash(hll_t* ptr, uint64_t h)
+{
+  int ret;
+  uint8_t rank;
+  size_t idx;
+
+  if (ptr->reg != NULL) {
+    idx  = h >> (64 - ptr->p);
+    rank = (uint8_t)(__builtin_clzll((h << ptr->p) |
+                                     (1ULL << (ptr->p - 1))) + 1);
+    reg_set(ptr->reg, idx, rank);
+    ret = 0;
+
+  } else {
+    rank = (uint8_t)(__builtin_clzll((h << SP_BITS) |
+                                     (1ULL << (SP_BITS - 1))) + 1);
+    ret  = add_entry(ptr, SP_ENTRY(h >> (64 - SP_BITS), rank));
+  }
+
+  return ret;
+}
+
+/*
+ * Ertlの改良推定量で使用する関数
+ */
+static double
+sigma(double x)
+{
+  double y;
+  double z;
+  double zp;
+
+  if (x == 1.0) return INFINITY;
+
+  y = 1.0;
+  z = x;
+
+  do {
+    x  *= x;
+    zp  = z;
+    z  += x * y;
+    y  += y;
+  } while (z != zp);
+
+  return z;
+}
+
+static double
+tau(double x)
+{
+  double y;
+  double z;
+  double zp;
+
+  if (x == 0.0 || x == 1.0) return 0.0;
+
+  y = 1.0;
+  z = 1.0 - x;
+
+  do {
+    x   = sqrt(x);
+    zp  = z;
+    y  *= 0.5;
+    z  -= (1.0 - x) * (1.0 - x) * y;
+  } while (z != zp);
+
+  return z / 3.0;
+}
+
+/*
+ * declar global functions
+ */
+
+int
+hll_new(int p, hll_t** dst)
+{
+  int ret;
+  hll_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (p < HLL_MIN_PRECISION || p > HLL_MAX_PRECISION) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(hll_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    memset(obj, 0, sizeof(*obj));
+
+    obj->p     = p;
+    obj->m     = (size_t)1 << p;
+    obj->limit = obj->m / 4;
+    obj->sp    = NALLOC(uint32_t, obj->limit + TMP_SIZE);
+
+    if (obj->sp == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+hll_destroy(hll_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    if (ptr->reg != NULL) free(ptr->reg);
+    if (ptr->sp != NULL) free(ptr->sp);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+hll_add(hll_t* ptr, const void* key, size_t len)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || (key == NULL && len > 0)) ret = DEFAULT_ERROR;
+
+  /*
+   * update registers
+   */
+  if (!ret) ret = add_hash(ptr, fnv1_mix64(fnv164((void*)key, len)));
+
+  return ret;
+}
+
+int
+hll_add_hash(hll_t* ptr, uint64_t hv)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * update registers
+   */
+  if (!ret) ret = add_hash(ptr, fnv1_mix64(hv));
+
+  return ret;
+}
+
+int
+hll_add_many(hll_t* ptr, const void* keys[], const size_t lens[], size_t n)
+{
+  int ret;
+  uint64_t hv[BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || (n > 0 && (keys == NULL || lens == NULL))) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (keys[i] == NULL && lens[i] > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * update registers
+   */
+  for (i = 0; !ret && i < n; i += m) {
+    m = (n - i < BATCH)? n - i: BATCH;
+
+    fnv164_many((void**)keys + i, (size_t*)lens + i, m, hv);
+
+    for (j = 0; !ret && j < m; j++) ret = add_hash(ptr, fnv1_mix64(hv[j]));
+  }
+
+  return ret;
+}
+
+int
+hll_count(hll_t* ptr, double* dst)
+{
+  int ret;
+  uint32_t c[66];
+  double m;
+  double z;
+  int q;
+  int k;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL || dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * flush pending entries
+   */
+  if (!ret && ptr->reg == NULL) ret = sp_flush_or_promote(ptr);
+
+  /*
+   * sparse (2^25個のレジスタとみなした線形カウンティング)
+   */
+  if (!ret && ptr->reg == NULL) {
+    m    = (double)(1 << SP_BITS);
+    *dst = m * log(m / (m - (double)ptr->nsp));
+  }
+
+  /*
+   * dense (Ertl, "New cardinality estimation algorithms for HyperLogLog
+   * sketches", 2017)
+   */
+  if (!ret && ptr->reg != NULL) {
+    q = 64 - ptr->p;
+    m = (double)ptr->m;
+
+    memset(c, 0, sizeof(c));
+    for (i = 0; i < ptr->m; i++) c[ptr->reg[i]]++;
+
+    z = m * tau(1.0 - (double)c[q + 1] / m);
+    for (k = q; k >= 1; k--) z = 0.5 * (z + c[k]);
+    z += m * sigma((double)c[0] / m);
+
+    *dst = (0.5 / M_LN2) * m * m / z;
+  }
+
+  return ret;
+}
+
+int
+hll_merge(hll_t* ptr, hll_t* src)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || src == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->p != src->p) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * merge
+   *
+   *  併合元が密な表現であれば併合先も密な表現に切り替えてレジスタ毎の最大
+   *  値をとる。疎な表現であれば要素を一つずつ追加する。
+   */
+  if (!ret && ptr != src && src->reg == NULL) {
+    ret = sp_flush_or_promote(src);
+  }
+
+  if (!ret && ptr != src) {
+    if (src->reg != NULL) {
+      ret = to_dense(ptr);
+      if (!ret) reg_max(ptr->reg, src->reg, ptr->m);
+
+    } else {
+      for (i = 0; !ret && i < src->nsp; i++) ret = add_entry(ptr, src->sp[i]);
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,131 @@
+﻿/*
+ * HyperLogLog cardinality estimator
+ *
+ *  Copyright (C) 2026 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+#ifndef __HLL_H__
+#define __HLL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HLL_MIN_PRECISION   4
+#define HLL_MAX_PRECISION   18
+
+/**
+ * @brief
+ *  HyperLogLogのコンテキストを抽象化した型
+ *
+ * @see
+ *  struct __hll_t__
+ */
+typedef struct __hll_t__ hll_t;
+
+/**
+ * @brief
+ *  HyperLogLogオブジェクトの生成
+ *
+ * @param [in] p  精度(レジスタ数 2^p、HLL_MIN_PRECISION〜HLL_MAX_PRECISION)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  推定の標準誤差はおよそ 1.04 / sqrt(2^p) (p = 14で約0.8%)。登録数が少な
+ *  い間は(インデックス, 値)の組を整列した配列で保持する疎な表現を使用し(イ
+ *  ンデックスを25ビットに拡張して保持するので、少数の推定はほぼ正確になる)、
+ *  その配列がレジスタの配列(2^pバイト)の1/4を超えた時点で密な表現に切り替
+ *  える。
+ *
+ * @remark
+ *  キーのハッシュ値はfnv164()の値をfnv1_mix64()で攪拌して使用する。推定値
+ *  はErtlの改良推定量(バイアス補正テーブルを必要としない)で算出する。
+ */
+int hll_new(int p, hll_t** dst);
+
+/**
+ * @brief
+ *  HyperLogLogオブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int hll_destroy(hll_t* ptr);
+
+/**
+ * @brief
+ *  キーの登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] key  キーへのポインタ
+ * @param [in] len  キーのサイズ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int hll_add(hll_t* ptr, const void* key, size_t len);
+
+/**
+ * @brief
+ *  ハッシュ値を指定したキーの登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] hv  キーのfnv164()の値
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int hll_add_hash(hll_t* ptr, uint64_t hv);
+
+/**
+ * @brief
+ *  複数キーの一括登録
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] keys  キーへのポインタの配列
+ * @param [in] lens  キーのサイズの配列
+ * @param [in] n  キーの数
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ハッシュ値はfnv164_many()でまとめて算出する。
+ */
+int hll_add_many(hll_t* ptr, const void* keys[], const size_t lens[],
+                 size_t n);
+
+/**
+ * @brief
+ *  異なるキーの数の推定
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [out] dst  推定値の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int hll_count(hll_t* ptr, double* dst);
+
+/**
+ * @brief
+ *  他のオブジェクトの内容の併合
+ *
+ * @param [in] ptr  併合先のオブジェクトのポインタ
+ * @param [in] src  併合元のオブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合(精度が異なる場合を含む)は0以外の
+ *  値を返す。
+ *
+ * @remark
+ *  処理後のptrは、両方に登録されたキーを全て登録した場合と同じ状態になる。
+ *  スレッド毎に集計したオブジェクトをまとめる場合に使用する。密な表現同士
+ *  の併合はレジスタ毎の最大値をSIMD命令(SSE2/AVX2)でまとめて求める。
+ */
+int hll_merge(hll_t* ptr, hll_t* src);
+
+#endif /* !defined(__HLL_H__) */
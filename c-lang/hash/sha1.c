@@ -7,7 +7,20 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <endian.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define ENABLE_X86_ACCEL
+#endif /* defined(__x86_64__) || defined(__i386__) */
 
 #include "sha1.h"
 
@@ -16,6 +29,56 @@
 
 #define ALLOC(t)        ((t*)malloc(sizeof(t)))
 
+#define BLOCK_SIZE      64
+#define LANES           8     // マルチバッファ処理のレーン数(AVX2)
+
+/*
+ * sha1_many()のスレッド分割の設定
+ *
+ *  スレッド一本あたりのデータ量がMT_MIN_BYTESに満たない場合はスレッドを
+ *  増やさない(メッセージの数ではなくデータの総量で決めるので、少数の大き
+ *  なメッセージでも分割される)。メッセージは一スレッドあたりMT_SPLIT回程
+ *  度に分けて取り出して処理する(各スレッドが処理を終えた時点で次の組を取
+ *  り出すので、メッセージの長さに偏りがあってもスレッド間の負荷は均等にな
+ *  る)。
+ */
+#define MT_MIN_BYTES    (256 * 1024)
+#define MT_MAX_THREADS  32
+#define MT_SPLIT        4
+
+/*
+ * ツリーモードの設定
+ *
+ *  TREE_BATCHはsha1_tree_update()が一度にスレッドへ渡すチャンクの数(ダイジ
+ *  ェストの格納先等をスタック上に確保するため上限を設けている)。小さな単位
+ *  で入力されたデータはCPU数分(最大TREE_BUF_CHUNKS個)のチャンクをバッファ
+ *  に溜めてから渡す(一つずつ渡すとスレッドに分割されないため)。
+ */
+#define TREE_DEFAULT_CHUNK  (1024 * 1024)
+#define TREE_BATCH          256
+#define TREE_BUF_CHUNKS     MT_MAX_THREADS
+#define TREE_MAX_DEPTH      64
+
+#define TREE_TAG_NODE       0x01
+#define TREE_TAG_ROOT       0x02
+
+/*
+ * sha1_fd()の設定
+ *
+ *  通常ファイルはFD_MAP_WINDOWバイト毎にmmap()して処理する(32ビット環境で
+ *  もアドレス空間を使い切らないように窓を設けている)。mmap()できない場合は
+ *  FD_READ_SIZEバイトのバッファにread()で読み込んで処理する。
+ */
+#define FD_MAP_WINDOW       (64 * 1024 * 1024)
+#define FD_READ_SIZE        (1024 * 1024)
+
+/*
+ * HMACの設定
+ */
+#define HMAC_IPAD           0x36
+#define HMAC_OPAD           0x5c
+#define HMAC_BATCH          64    // sha1_hmac_many()の外側ハッシュの処理単位
+
 #define R_MASK(n)       (((1 << (n)) - 1) & 0xffffffff)
 #define L_MASK(n)       (~R_MASK(n))
 #if 0
@@ -83,6 +146,39 @@ struct __sha1_t__ {
   uint8_t buf[64];
 };
 
+/**
+ * @brief
+ *  sha1_tree_tの実体
+ *
+ * @remark
+ *  stackには確定済みの部分木のダイジェストを高さの降順に積む。葉の数を二進
+ *  数で見た時に立っているビットがそれぞれ一つの部分木に対応するので、深さ
+ *  はTREE_MAX_DEPTHを超えない。
+ */
+struct __sha1_tree_t__ {
+  size_t chunk;         // チャンク(葉)のサイズ
+  uint8_t* buf;         // 入力データの一時保存領域(capバイト)
+  size_t cap;           // bufのサイズ(chunkの整数倍)
+  size_t nbuf;          // bufに保存されているデータのサイズ
+  uint64_t total;       // 入力されたデータの総量
+  uint64_t nleaf;       // 確定済みの葉の数
+  int depth;            // stackに積まれている部分木の数
+  sha1_output_t stack[TREE_MAX_DEPTH];
+};
+
+/**
+ * @brief
+ *  sha1_hmac_tの実体
+ *
+ * @remark
+ *  鍵そのものは保持せず、鍵とipad/opadのXORを1ブロック処理した中間状態の
+ *  みを保持する。
+ */
+struct __sha1_hmac_t__ {
+  uint32_t ih[5];       // 内側ハッシュの中間状態(K ^ ipad 処理後)
+  uint32_t oh[5];       // 外側ハッシュの中間状態(K ^ opad 処理後)
+};
+
 /*
  * declar internal functions
  */
@@ -229,310 +325,1980 @@ transform(uint32_t state[5], const uint8_t buf[64])
   // a = b = c = d = e =0;
 }
 
+static void
+transform_blocks(uint32_t state[5], const uint8_t* data, size_t n)
+{
+  for (; n > 0; n--, data += BLOCK_SIZE) transform(state, data);
+}
+
+#ifdef ENABLE_X86_ACCEL
 /*
- * declar global functions
+ * SHA-NI(SHA拡張命令)による実装
+ *
+ *  sha1rnds4で4ラウンドずつ処理し、メッセージスケジュールはsha1msg1/
+ *  sha1msg2で求める。グループgの処理ではMSG[g%4]を消費し、後続のグループ
+ *  で使用するMSG[(g+1)%4]〜MSG[(g+3)%4]の計算を進める(最後の数グループで
+ *  求める値は使用されないが、処理を揃えるためにそのまま計算する)。
  */
+#define SHANI_GROUP(e0, e1, m0, m1, m2, m3, f) { \
+    e0 = _mm_sha1nexte_epu32(e0, m0); \
+    e1 = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1, m0); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, f); \
+    m3 = _mm_sha1msg1_epu32(m3, m0); \
+    m2 = _mm_xor_si128(m2, m0); \
+}
 
-int
-sha1_new(sha1_t** dst)
+__attribute__((target("sha,sse4.1")))
+static void
+transform_shani(uint32_t state[5], const uint8_t* data, size_t n)
 {
-  int ret;
-  sha1_t* obj;
+  __m128i abcd;
+  __m128i abcd0;
+  __m128i e0;
+  __m128i e1;
+  __m128i e00;
+  __m128i m0;
+  __m128i m1;
+  __m128i m2;
+  __m128i m3;
+  __m128i mask;
+
+  mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+  e0   = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+  for (; n > 0; n--, data += BLOCK_SIZE) {
+    abcd0 = abcd;
+    e00   = e0;
+
+    // rounds 0-3
+    m0   = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data +  0)), mask);
+    e0   = _mm_add_epi32(e0, m0);
+    e1   = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    // rounds 4-7
+    m1   = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), mask);
+    e1   = _mm_sha1nexte_epu32(e1, m1);
+    e0   = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    m0   = _mm_sha1msg1_epu32(m0, m1);
+
+    // rounds 8-11
+    m2   = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), mask);
+    e0   = _mm_sha1nexte_epu32(e0, m2);
+    e1   = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    m1   = _mm_sha1msg1_epu32(m1, m2);
+    m0   = _mm_xor_si128(m0, m2);
+
+    // rounds 12-79
+    m3   = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), mask);
+    SHANI_GROUP(e1, e0, m3, m0, m1, m2, 0);
+    SHANI_GROUP(e0, e1, m0, m1, m2, m3, 0);
+    SHANI_GROUP(e1, e0, m1, m2, m3, m0, 1);
+    SHANI_GROUP(e0, e1, m2, m3, m0, m1, 1);
+    SHANI_GROUP(e1, e0, m3, m0, m1, m2, 1);
+    SHANI_GROUP(e0, e1, m0, m1, m2, m3, 1);
+    SHANI_GROUP(e1, e0, m1, m2, m3, m0, 1);
+    SHANI_GROUP(e0, e1, m2, m3, m0, m1, 2);
+    SHANI_GROUP(e1, e0, m3, m0, m1, m2, 2);
+    SHANI_GROUP(e0, e1, m0, m1, m2, m3, 2);
+    SHANI_GROUP(e1, e0, m1, m2, m3, m0, 2);
+    SHANI_GROUP(e0, e1, m2, m3, m0, m1, 2);
+    SHANI_GROUP(e1, e0, m3, m0, m1, m2, 3);
+    SHANI_GROUP(e0, e1, m0, m1, m2, m3, 3);
+    SHANI_GROUP(e1, e0, m1, m2, m3, m0, 3);
+    SHANI_GROUP(e0, e1, m2, m3, m0, m1, 3);
+    SHANI_GROUP(e1, e0, m3, m0, m1, m2, 3);
+
+    // combine state
+    e0   = _mm_sha1nexte_epu32(e0, e00);
+    abcd = _mm_add_epi32(abcd, abcd0);
+  }
 
-  /*
-   * initialize
-   */
-  ret = 0;
-  obj = NULL;
+  _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+  state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
 
-  /*
-   * argument check
-   */
-  if (dst == NULL) ret = DEFAULT_ERROR;
+/*
+ * AVX2による8レーンのマルチバッファ実装
+ *
+ *  8個の独立したメッセージのブロックを一つずつ受け取り、ベクタの各要素を
+ *  一つのメッセージに割り当てて同時に処理する。状態はレーン毎ではなく変数
+ *  毎に並べた形(st[0]に8レーン分のa、st[1]にb…)で保持する。
+ */
+#define V_ROTL(x,n)     _mm256_or_si256(_mm256_slli_epi32(x, n), \
+                                        _mm256_srli_epi32(x, 32 - (n)))
+
+__attribute__((target("avx2")))
+static inline void
+transpose8(__m256i r[8])
+{
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+  __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void
+transform_x8(uint32_t st[5][LANES], const uint8_t* blk[LANES])
+{
+  __m256i a, b, c, d, e;
+  __m256i f, k, t;
+  __m256i w[16];
+  __m256i swap;
+  int i;
 
   /*
-   * memory allocate
+   * メッセージの読み込み(ビッグエンディアン変換及びレーン方向への転置)
    */
-  if (!ret) {
-    obj = ALLOC(sha1_t);
-    if (obj == NULL) ret = DEFAULT_ERROR;
+  swap = _mm256_set_epi8(12, 13, 14, 15,  8,  9, 10, 11,
+                          4,  5,  6,  7,  0,  1,  2,  3,
+                         12, 13, 14, 15,  8,  9, 10, 11,
+                          4,  5,  6,  7,  0,  1,  2,  3);
+
+  for (i = 0; i < LANES; i++) {
+    w[i]     = _mm256_loadu_si256((const __m256i*)(blk[i] +  0));
+    w[i + 8] = _mm256_loadu_si256((const __m256i*)(blk[i] + 32));
   }
 
-  /*
-   * setup object
-   */
-  if (!ret) reset(obj);
+  transpose8(w);
+  transpose8(w + 8);
+
+  for (i = 0; i < 16; i++) w[i] = _mm256_shuffle_epi8(w[i], swap);
+
+  a = _mm256_loadu_si256((const __m256i*)st[0]);
+  b = _mm256_loadu_si256((const __m256i*)st[1]);
+  c = _mm256_loadu_si256((const __m256i*)st[2]);
+  d = _mm256_loadu_si256((const __m256i*)st[3]);
+  e = _mm256_loadu_si256((const __m256i*)st[4]);
 
   /*
-   * put return paramter
-   */
-  if (!ret) *dst = obj;
-  
-  /*
-   * post process
+   * ラウンド処理
    */
-  if (ret) {
-    if (obj != NULL) free(obj);
+  for (i = 0; i < 80; i++) {
+    if (i >= 16) {
+      t = _mm256_xor_si256(_mm256_xor_si256(w[(i - 3) & 15], w[(i - 8) & 15]),
+                           _mm256_xor_si256(w[(i - 14) & 15], w[i & 15]));
+      w[i & 15] = V_ROTL(t, 1);
+    }
+
+    if (i < 20) {
+      f = _mm256_xor_si256(_mm256_and_si256(b, _mm256_xor_si256(c, d)), d);
+      k = _mm256_set1_epi32(0x5a827999);
+    } else if (i < 40) {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32(0x6ed9eba1);
+    } else if (i < 60) {
+      f = _mm256_or_si256(_mm256_and_si256(b, c),
+                          _mm256_and_si256(d, _mm256_or_si256(b, c)));
+      k = _mm256_set1_epi32((int)0x8f1bbcdc);
+    } else {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32((int)0xca62c1d6);
+    }
+
+    t = _mm256_add_epi32(_mm256_add_epi32(V_ROTL(a, 5), f),
+                         _mm256_add_epi32(_mm256_add_epi32(e, k), w[i & 15]));
+    e = d;
+    d = c;
+    c = V_ROTL(b, 30);
+    b = a;
+    a = t;
   }
 
-  return ret;
+  _mm256_storeu_si256((__m256i*)st[0],
+                      _mm256_add_epi32(a, _mm256_loadu_si256((__m256i*)st[0])));
+  _mm256_storeu_si256((__m256i*)st[1],
+                      _mm256_add_epi32(b, _mm256_loadu_si256((__m256i*)st[1])));
+  _mm256_storeu_si256((__m256i*)st[2],
+                      _mm256_add_epi32(c, _mm256_loadu_si256((__m256i*)st[2])));
+  _mm256_storeu_si256((__m256i*)st[3],
+                      _mm256_add_epi32(d, _mm256_loadu_si256((__m256i*)st[3])));
+  _mm256_storeu_si256((__m256i*)st[4],
+                      _mm256_add_epi32(e, _mm256_loadu_si256((__m256i*)st[4])));
 }
+#endif /* defined(ENABLE_X86_ACCEL) */
 
-int
-sha1_destroy(sha1_t* ptr)
+/*
+ * 実装の選択
+ *
+ *  単一ストリームのブロック処理はSHA-NIが使用可能であればSHA-NIを、そう
+ *  でなければ汎用実装を使用する。複数メッセージの処理(sha1_many())は、
+ *  SHA-NIが使用可能であればメッセージ毎にSHA-NIで処理し(SHA-NI一本の方が
+ *  AVX2の8レーンより速い)、SHA-NIが無くAVX2が使用可能であれば8レーンの
+ *  マルチバッファ処理を行う。判定はプロセス起動時に一度だけCPUIDで行う。
+ */
+static void (*blocks)(uint32_t[5], const uint8_t*, size_t) = transform_blocks;
+static int use_x8 = 0;
+
+#ifdef ENABLE_X86_ACCEL
+__attribute__((constructor))
+static void
+select_impl(void)
 {
-  int ret;
+  unsigned int eax, ebx, ecx, edx;
+  unsigned int xlo, xhi;
+  int osxsave;
+  int ymm;
+  int sse41;
 
-  /*
-   * initialize
-   */
-  ret = 0;
+  ymm = 0;
 
-  /*
-   * argument check
-   */
-  if (ptr == NULL) ret = DEFAULT_ERROR;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return;
 
-  /*
-   * release resources
-   */
-  if (!ret) free(ptr);
+  sse41 = (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
 
-  /*
-   * post process
-   */
-  // nothing
+  // AVX2はOSがYMMレジスタの退避に対応している場合のみ使用できる
+  osxsave = (ecx & bit_OSXSAVE) && (ecx & bit_AVX);
+  if (osxsave) {
+    __asm__ volatile ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    ymm = ((xlo & 0x6) == 0x6);
+  }
 
-  return ret;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return;
+
+  if (sse41 && (ebx & bit_SHA)) {
+    blocks = transform_shani;
+  } else if (ymm && (ebx & bit_AVX2)) {
+    use_x8 = !0;
+  }
 }
+#endif /* defined(ENABLE_X86_ACCEL) */
 
-int
-sha1_update(sha1_t* ptr, void* data, size_t size)
+/*
+ * 複数メッセージの処理
+ *
+ *  メッセージは末尾の端数とパディングを含むブロック(1〜2ブロック)をレーン
+ *  毎の領域に作成しておき、先頭から順にブロック単位で取り出す。全レーンに
+ *  共通の処理をブロック単位で行うので、メッセージの長さが揃っていなくても
+ *  よい(処理を終えたレーンには次のメッセージを割り当てる)。
+ */
+struct lane {
+  const uint8_t* data;            // 未処理の全ブロックの先頭
+  size_t nblk;                    // dataから処理する残りのブロック数
+  uint8_t tail[BLOCK_SIZE * 2];   // 末尾の端数とパディング
+  int ntail;                      // tailのブロック数
+  int tpos;                       // 処理済みのtailのブロック数
+  size_t idx;                     // 処理中のメッセージの番号
+};
+
+static const uint32_t iv[5] = {
+  0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+/**
+ * @brief
+ *  レーンへのメッセージの割り当て
+ *
+ * @remark
+ *  preには既に処理済みの前置データのサイズ(ブロックサイズの倍数)を指定す
+ *  る。HMACのように前置ブロックの中間状態から算出を始める場合に使用する。
+ */
+static void
+lane_setup(struct lane* ln, const void* data, size_t size, uint64_t pre,
+           size_t idx)
 {
-  int ret;
+  size_t rem;
+  uint64_t bits;
+  uint8_t* p;
   int i;
-  int j;
 
-  /*
-   * initialize
-   */
-  ret = 0;
+  ln->data  = data;
+  ln->nblk  = size / BLOCK_SIZE;
+  ln->tpos  = 0;
+  ln->idx   = idx;
 
-  /*
-   * argument check
-   */
-  do {
-    if (ptr == NULL) {
-      ret = DEFAULT_ERROR;
-      break;
-    }
+  rem       = size % BLOCK_SIZE;
+  ln->ntail = (rem + 9 > BLOCK_SIZE)? 2: 1;
 
-    if (data == NULL) {
-      ret = DEFAULT_ERROR;
-      break;
-    }
-  } while (0);
+  memset(ln->tail, 0, sizeof(ln->tail));
+  if (rem > 0) memcpy(ln->tail, ln->data + ln->nblk * BLOCK_SIZE, rem);
+  ln->tail[rem] = 0x80;
 
-  /*
-   * update process
-   */
-  if (!ret) {
-    j = (ptr->count[0] >> 3) & 63;
+  bits = (pre + size) << 3;
+  p    = ln->tail + (ln->ntail * BLOCK_SIZE) - 8;
+  for (i = 0; i < 8; i++) p[i] = (uint8_t)(bits >> ((7 - i) * 8));
+}
 
-    ptr->count[0] += (size << 3);
-    ptr->count[1] += (size >> 29);
+static const uint8_t*
+lane_next(struct lane* ln)
+{
+  const uint8_t* ret;
 
-    if (ptr->count[0] < (size << 3)) ptr->count[1]++;
+  if (ln->nblk > 0) {
+    ret = ln->data;
+    ln->data += BLOCK_SIZE;
+    ln->nblk--;
 
-    if ((j + size) > 63) {
-      i = 64 - j;
+  } else if (ln->tpos < ln->ntail) {
+    ret = ln->tail + (ln->tpos++ * BLOCK_SIZE);
 
-      memcpy(ptr->buf + j, data, i);
-      transform(ptr->state, ptr->buf);
+  } else {
+    ret = NULL;
+  }
 
-      for (; (i + 63) < size; i += 64) transform(ptr->state, data + i);
+  return ret;
+}
 
-      j = 0;
+static void
+put_digest(const uint32_t state[5], sha1_output_t dst)
+{
+  int i;
 
-    } else {
-      i = 0;
-    }
+  for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
+    dst[i] = (uint8_t)((state[i >> 2] >> ((3 - (i & 3)) * 8)) & 0xff);
+  }
+}
 
-    memcpy(ptr->buf + j, data + i, size - i);
+/**
+ * @brief
+ *  レーン上の残りのブロックの逐次処理
+ */
+static void
+lane_finish(struct lane* ln, uint32_t state[5], sha1_output_t dst)
+{
+  if (ln->nblk > 0) {
+    blocks(state, ln->data, ln->nblk);
+    ln->data += ln->nblk * BLOCK_SIZE;
+    ln->nblk  = 0;
   }
 
-  /*
-   * post process
-   */
-  // nothing
+  if (ln->tpos < ln->ntail) {
+    blocks(state, ln->tail + (ln->tpos * BLOCK_SIZE), ln->ntail - ln->tpos);
+    ln->tpos = ln->ntail;
+  }
 
-  return ret;
+  put_digest(state, dst);
 }
 
-int
-sha1_final(sha1_t* ptr, sha1_output_t dst)
+/**
+ * @brief
+ *  中間状態からの一つのメッセージの算出(コンテキストの確保を行わない)
+ */
+static void
+hash_from(const uint32_t init[5], uint64_t pre, const void* data, size_t size,
+          sha1_output_t dst)
 {
-  int ret;
+  struct lane ln;
+  uint32_t state[5];
+
+  memcpy(state, init, sizeof(state));
+  lane_setup(&ln, data, size, pre, 0);
+  lane_finish(&ln, state, dst);
+}
+
+static void
+hash_one(const void* data, size_t size, sha1_output_t dst)
+{
+  hash_from(iv, 0, data, size, dst);
+}
+
+#ifdef ENABLE_X86_ACCEL
+/*
+ * 稼働中のレーンがこの数以下になり、割り当てるメッセージも無くなった場合は
+ * 残りを逐次処理で片付ける(空きレーンの多いベクタ処理は逐次処理より遅い)
+ */
+#define MB_MIN_LANES    2
+
+static void
+hash_x8(const uint32_t init[5], uint64_t pre, const void* data[],
+        const size_t sizes[], size_t n, sha1_output_t dst[])
+{
+  struct lane ln[LANES];
+  uint32_t st[5][LANES] __attribute__((aligned(32)));
+  uint32_t state[5];
+  const uint8_t* blk[LANES];
+  int act[LANES];
+  int nact;
+  size_t next;
   int i;
   int j;
-  int k;
-  uint8_t fc[8];  // as Final Count
 
-  const uint8_t c80[1] = {0x80};
-  const uint8_t c00[1] = {0x00};
+  static const uint8_t dummy[BLOCK_SIZE];
 
-  /*
-   * initialize
-   */
-  ret = 0;
+  next = 0;
 
-  /*
-   * argument check
-   */
-  do {
-    if (ptr == NULL) {
-      ret = DEFAULT_ERROR;
-      break;
-    }
+  for (i = 0; i < LANES; i++) act[i] = 0;
 
-    if (dst == NULL) {
-      ret = DEFAULT_ERROR;
-      break;
-    }
-  } while (0);
+  while (1) {
+    /*
+     * ブロックの取り出し(処理を終えたレーンには次のメッセージを割り当てる)
+     */
+    nact = 0;
 
-  /*
-   * do padding
-   */
-  if (!ret) {
-    for (i = 0; i < 8; i++) {
-      j = (i >= 4)? 0: 1;
-      k = (3 - (i & 3)) * 8;
+    for (i = 0; i < LANES; i++) {
+      blk[i] = (act[i])? lane_next(ln + i): NULL;
 
-      fc[i] = (uint8_t)((ptr->count[j] >> k) & 0xff);
-    }
+      if (blk[i] == NULL) {
+        if (act[i]) {
+          for (j = 0; j < 5; j++) state[j] = st[j][i];
+          put_digest(state, dst[ln[i].idx]);
+          act[i] = 0;
+        }
 
-    sha1_update(ptr, (void*)c80, 1);
+        if (next < n) {
+          lane_setup(ln + i, data[next], sizes[next], pre, next);
+          for (j = 0; j < 5; j++) st[j][i] = init[j];
+          act[i] = !0;
+          next++;
 
-    while ((ptr->count[0] & 0x1f8) != 0x1c0) {
-      sha1_update(ptr, (void*)c00, 1);
+          blk[i] = lane_next(ln + i);
+        }
+      }
+
+      if (act[i]) {
+        nact++;
+      } else {
+        blk[i] = dummy;
+      }
     }
 
-    sha1_update(ptr, fc, 8);
-  }
+    if (nact == 0) break;
 
-  /*
-   * put return parameter
-   */
-  if (!ret) {
-    for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
-      j = i >> 2;
-      k = (3 - (i & 3)) * 8;
+    /*
+     * 残りが少なくなった場合は逐次処理で完了させる
+     */
+    if (nact <= MB_MIN_LANES && next >= n) {
+      for (i = 0; i < LANES; i++) {
+        if (!act[i]) continue;
 
-      dst[i] = (uint8_t)((ptr->state[j] >> k) & 0xff);
+        for (j = 0; j < 5; j++) state[j] = st[j][i];
+        blocks(state, blk[i], 1);
+        lane_finish(ln + i, state, dst[ln[i].idx]);
+      }
+      break;
     }
+
+    transform_x8(st, blk);
   }
+}
+#endif /* defined(ENABLE_X86_ACCEL) */
 
-  /*
-   * post process
-   */
-  if (!ret) reset(ptr);
+static void
+hash_many_from(const uint32_t init[5], uint64_t pre, const void* data[],
+               const size_t sizes[], size_t n, sha1_output_t dst[])
+{
+  size_t i;
 
-  return ret;
+#ifdef ENABLE_X86_ACCEL
+  if (use_x8) {
+    hash_x8(init, pre, data, sizes, n, dst);
+    return;
+  }
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+  for (i = 0; i < n; i++) hash_from(init, pre, data[i], sizes[i], dst[i]);
 }
 
-int
-sha1(void* data, size_t size, sha1_output_t dst)
+static void
+hash_many(const void* data[], const size_t sizes[], size_t n,
+          sha1_output_t dst[])
+{
+  hash_many_from(iv, 0, data, sizes, n, dst);
+}
+
+/*
+ * スレッドによる分割処理
+ */
+struct mt_job {
+  const void** data;
+  const size_t* sizes;
+  size_t n;
+  sha1_output_t* dst;
+  size_t batch;         // 一度に取り出すメッセージの数
+  size_t next;          // 次に取り出すメッセージの番号(アトミックに更新)
+};
+
+static void*
+mt_worker(void* arg)
+{
+  struct mt_job* job;
+  size_t i;
+  size_t m;
+
+  job = (struct mt_job*)arg;
+
+  while (1) {
+    i = __atomic_fetch_add(&job->next, job->batch, __ATOMIC_RELAXED);
+    if (i >= job->n) break;
+
+    m = (job->n - i < job->batch)? job->n - i: job->batch;
+    hash_many(job->data + i, job->sizes + i, m, job->dst + i);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief
+ *  使用するスレッド数の決定
+ */
+static int
+mt_threads(const size_t sizes[], size_t n)
+{
+  size_t total;
+  size_t i;
+  long ncpu;
+  size_t ret;
+
+  total = 0;
+  for (i = 0; i < n; i++) total += sizes[i];
+
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu < 1) ncpu = 1;
+
+  ret = total / MT_MIN_BYTES;
+  if (ret > (size_t)ncpu) ret = ncpu;
+  if (ret > MT_MAX_THREADS) ret = MT_MAX_THREADS;
+  if (ret > n) ret = n;
+  if (ret < 1) ret = 1;
+
+  return (int)ret;
+}
+
+/**
+ * @brief
+ *  一度に取り出すメッセージ数の決定
+ *
+ * @remark
+ *  各スレッドがMT_SPLIT回程度取り出す量とする。レーン数を超える場合はレ
+ *  ーン数の倍数に切り上げ、マルチバッファ処理の空きレーンを減らす。
+ */
+static size_t
+mt_batch(size_t n, int nthr)
+{
+  size_t div;
+  size_t ret;
+
+  div = (size_t)nthr * MT_SPLIT;
+  ret = (n + div - 1) / div;
+
+  if (ret > LANES) ret = ((ret + LANES - 1) / LANES) * LANES;
+
+  return ret;
+}
+
+/**
+ * @brief
+ *  複数メッセージの算出(スレッド分割あり)
+ *
+ * @remark
+ *  呼び出し元のスレッドも処理に加わる。スレッドの生成に失敗した場合も、
+ *  残りのメッセージは生成できたスレッドと呼び出し元で処理される。
+ */
+static void
+hash_many_mt(const void* data[], const size_t sizes[], size_t n,
+             sha1_output_t dst[])
+{
+  pthread_t thr[MT_MAX_THREADS];
+  struct mt_job job;
+  int nthr;
+  int nrun;
+  int i;
+
+  nthr = mt_threads(sizes, n);
+  nrun = 0;
+
+  if (nthr <= 1) {
+    hash_many(data, sizes, n, dst);
+
+  } else {
+    job.data  = data;
+    job.sizes = sizes;
+    job.n     = n;
+    job.dst   = dst;
+    job.batch = mt_batch(n, nthr);
+    job.next  = 0;
+
+    for (i = 0; i < nthr - 1; i++) {
+      if (pthread_create(thr + nrun, NULL, mt_worker, &job)) break;
+      nrun++;
+    }
+
+    mt_worker(&job);
+
+    for (i = 0; i < nrun; i++) pthread_join(thr[i], NULL);
+  }
+}
+
+/**
+ * @brief
+ *  コンテキストへのデータの投入(引数チェック無し)
+ *
+ * @remark
+ *  バッファに端数が残っている場合はそれを埋めて処理し、以降の完全なブロッ
+ *  クは入力データから直接処理する。バッファへの複写はブロックの端数のみ。
+ */
+static void
+update(sha1_t* ptr, const void* data, size_t size)
+{
+  const uint8_t* p;
+  uint64_t bits;
+  size_t j;
+  size_t n;
+
+  p    = (const uint8_t*)data;
+  j    = (ptr->count[0] >> 3) & 63;
+
+  bits = (((uint64_t)ptr->count[1] << 32) | ptr->count[0]) +
+         ((uint64_t)size << 3);
+
+  ptr->count[0] = (uint32_t)bits;
+  ptr->count[1] = (uint32_t)(bits >> 32);
+
+  if (j > 0) {
+    n = BLOCK_SIZE - j;
+    if (n > size) n = size;
+
+    memcpy(ptr->buf + j, p, n);
+    p    += n;
+    size -= n;
+
+    if (j + n < BLOCK_SIZE) return;
+
+    blocks(ptr->state, ptr->buf, 1);
+  }
+
+  if (size >= BLOCK_SIZE) {
+    blocks(ptr->state, p, size / BLOCK_SIZE);
+    p    += (size / BLOCK_SIZE) * BLOCK_SIZE;
+    size %= BLOCK_SIZE;
+  }
+
+  if (size > 0) memcpy(ptr->buf, p, size);
+}
+
+/*
+ * HMAC/PBKDF2の内部処理
+ */
+static void
+hmac_setup(sha1_hmac_t* ptr, const void* key, size_t klen)
+{
+  uint8_t k[BLOCK_SIZE];
+  uint8_t blk[BLOCK_SIZE];
+  int i;
+
+  memset(k, 0, sizeof(k));
+
+  if (klen > BLOCK_SIZE) {
+    hash_one(key, klen, k);
+  } else if (klen > 0) {
+    memcpy(k, key, klen);
+  }
+
+  for (i = 0; i < BLOCK_SIZE; i++) blk[i] = k[i] ^ HMAC_IPAD;
+  memcpy(ptr->ih, iv, sizeof(ptr->ih));
+  blocks(ptr->ih, blk, 1);
+
+  for (i = 0; i < BLOCK_SIZE; i++) blk[i] = k[i] ^ HMAC_OPAD;
+  memcpy(ptr->oh, iv, sizeof(ptr->oh));
+  blocks(ptr->oh, blk, 1);
+
+  memset(k, 0, sizeof(k));
+  memset(blk, 0, sizeof(blk));
+}
+
+static void
+hmac_one(const sha1_hmac_t* ptr, const void* data, size_t size,
+         sha1_output_t dst)
+{
+  sha1_output_t in;
+
+  hash_from(ptr->ih, BLOCK_SIZE, data, size, in);
+  hash_from(ptr->oh, BLOCK_SIZE, in, SHA1_DIGEST_SIZE, dst);
+}
+
+/**
+ * @brief
+ *  PBKDF2の二回目以降の反復処理
+ *
+ * @param [in] key  HMACの中間状態
+ * @param [in,out] u  各出力ブロックのU(先頭20バイト)とパディングを格納した
+ *                    ブロック
+ * @param [in,out] t  各出力ブロックの値(U1で初期化しておく)
+ * @param [in] n  出力ブロックの数(LANES以下)
+ * @param [in] iter  反復回数
+ *
+ * @remark
+ *  内側・外側とも入力は「前置ブロック + 20バイト」なのでパディングは共通と
+ *  なり、一つのブロックを使い回せる。一回の反復は内側・外側それぞれ一回の
+ *  圧縮関数呼び出しで済む。
+ */
+static void
+pbkdf2_iterate(const sha1_hmac_t* key, uint8_t u[][BLOCK_SIZE],
+               sha1_output_t t[], int n, uint32_t iter)
+{
+  uint32_t state[5];
+  uint32_t c;
+  int i;
+  int j;
+
+#ifdef ENABLE_X86_ACCEL
+  uint32_t st[5][LANES] __attribute__((aligned(32)));
+  const uint8_t* blk[LANES];
+
+  if (use_x8 && n >= MB_MIN_LANES) {
+    for (i = 0; i < LANES; i++) blk[i] = u[(i < n)? i: 0];
+
+    for (c = 1; c < iter; c++) {
+      for (i = 0; i < LANES; i++) {
+        for (j = 0; j < 5; j++) st[j][i] = key->ih[j];
+      }
+
+      transform_x8(st, blk);
+
+      for (i = 0; i < n; i++) {
+        for (j = 0; j < 5; j++) state[j] = st[j][i];
+        put_digest(state, u[i]);
+      }
+
+      for (i = 0; i < LANES; i++) {
+        for (j = 0; j < 5; j++) st[j][i] = key->oh[j];
+      }
+
+      transform_x8(st, blk);
+
+      for (i = 0; i < n; i++) {
+        for (j = 0; j < 5; j++) state[j] = st[j][i];
+        put_digest(state, u[i]);
+        for (j = 0; j < SHA1_DIGEST_SIZE; j++) t[i][j] ^= u[i][j];
+      }
+    }
+
+    return;
+  }
+#endif /* defined(ENABLE_X86_ACCEL) */
+
+  for (i = 0; i < n; i++) {
+    for (c = 1; c < iter; c++) {
+      memcpy(state, key->ih, sizeof(state));
+      blocks(state, u[i], 1);
+      put_digest(state, u[i]);
+
+      memcpy(state, key->oh, sizeof(state));
+      blocks(state, u[i], 1);
+      put_digest(state, u[i]);
+
+      for (j = 0; j < SHA1_DIGEST_SIZE; j++) t[i][j] ^= u[i][j];
+    }
+  }
+}
+
+/*
+ * ツリーモードの内部処理
+ */
+static void
+tree_reset(sha1_tree_t* ptr)
+{
+  ptr->nbuf  = 0;
+  ptr->total = 0;
+  ptr->nleaf = 0;
+  ptr->depth = 0;
+}
+
+/**
+ * @brief
+ *  節のダイジェストの算出 (H(0x01 || left || right))
+ */
+static void
+tree_node(const sha1_output_t left, const sha1_output_t right,
+          sha1_output_t dst)
+{
+  uint8_t msg[1 + (SHA1_DIGEST_SIZE * 2)];
+
+  msg[0] = TREE_TAG_NODE;
+  memcpy(msg + 1, left, SHA1_DIGEST_SIZE);
+  memcpy(msg + 1 + SHA1_DIGEST_SIZE, right, SHA1_DIGEST_SIZE);
+
+  hash_one(msg, sizeof(msg), dst);
+}
+
+/**
+ * @brief
+ *  葉の追加
+ *
+ * @remark
+ *  葉の数が偶数になる度に、同じ高さの部分木同士を結合する。
+ */
+static void
+tree_push(sha1_tree_t* ptr, const sha1_output_t leaf)
+{
+  uint64_t n;
+
+  memcpy(ptr->stack[ptr->depth++], leaf, SHA1_DIGEST_SIZE);
+
+  for (n = ++ptr->nleaf; !(n & 1); n >>= 1) {
+    ptr->depth--;
+    tree_node(ptr->stack[ptr->depth - 1], ptr->stack[ptr->depth],
+              ptr->stack[ptr->depth - 1]);
+  }
+}
+
+/**
+ * @brief
+ *  連続した完全なチャンクの処理
+ *
+ * @return
+ *  処理したデータのサイズ
+ */
+static size_t
+tree_chunks(sha1_tree_t* ptr, const uint8_t* data, size_t size)
+{
+  const void* msg[TREE_BATCH];
+  size_t sizes[TREE_BATCH];
+  sha1_output_t leaf[TREE_BATCH];
+  size_t ret;
+  size_t n;
+  size_t i;
+
+  ret = 0;
+
+  while (size - ret >= ptr->chunk) {
+    n = (size - ret) / ptr->chunk;
+    if (n > TREE_BATCH) n = TREE_BATCH;
+
+    for (i = 0; i < n; i++) {
+      msg[i]   = data + ret + (i * ptr->chunk);
+      sizes[i] = ptr->chunk;
+    }
+
+    hash_many_mt(msg, sizes, n, leaf);
+
+    for (i = 0; i < n; i++) tree_push(ptr, leaf[i]);
+
+    ret += n * ptr->chunk;
+  }
+
+  return ret;
+}
+
+/*
+ * declar global functions
+ */
+
+int
+sha1_new(sha1_t** dst)
+{
+  int ret;
+  sha1_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(sha1_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) reset(obj);
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+  
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+sha1_destroy(sha1_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) free(ptr);
+
+  /*
+   * post process
+   */
+  // nothing
+
+  return ret;
+}
+
+int
+sha1_update(sha1_t* ptr, void* data, size_t size)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (data == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update process
+   */
+  if (!ret) update(ptr, data, size);
+
+  /*
+   * post process
+   */
+  // nothing
+
+  return ret;
+}
+
+int
+sha1_updatev(sha1_t* ptr, const struct iovec* iov, int n)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (n < 0 || (n > 0 && iov == NULL)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (iov[i].iov_base == NULL && iov[i].iov_len > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * update process
+   *
+   *  各要素の完全なブロックは要素のメモリ上で直接処理し、要素の境界をまた
+   *  ぐブロックのみコンテキストのバッファで組み立てる。
+   */
+  if (!ret) {
+    for (i = 0; i < n; i++) {
+      if (iov[i].iov_len > 0) update(ptr, iov[i].iov_base, iov[i].iov_len);
+    }
+  }
+
+  return ret;
+}
+
+int
+sha1_final(sha1_t* ptr, sha1_output_t dst)
+{
+  int ret;
+  int i;
+  int j;
+  int k;
+  uint8_t fc[8];  // as Final Count
+
+  const uint8_t c80[1] = {0x80};
+  const uint8_t c00[1] = {0x00};
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * do padding
+   */
+  if (!ret) {
+    for (i = 0; i < 8; i++) {
+      j = (i >= 4)? 0: 1;
+      k = (3 - (i & 3)) * 8;
+
+      fc[i] = (uint8_t)((ptr->count[j] >> k) & 0xff);
+    }
+
+    sha1_update(ptr, (void*)c80, 1);
+
+    while ((ptr->count[0] & 0x1f8) != 0x1c0) {
+      sha1_update(ptr, (void*)c00, 1);
+    }
+
+    sha1_update(ptr, fc, 8);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
+      j = i >> 2;
+      k = (3 - (i & 3)) * 8;
+
+      dst[i] = (uint8_t)((ptr->state[j] >> k) & 0xff);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (!ret) reset(ptr);
+
+  return ret;
+}
+
+int
+sha1(void* data, size_t size, sha1_output_t dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (data == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calculate digest
+   *
+   *  一括で与えられたデータはコンテキストを確保せずスタック上で処理する。
+   */
+  if (!ret) hash_one(data, size, dst);
+
+  return ret;
+}
+
+int
+sha1_many(const void* data[], const size_t sizes[], size_t n,
+          sha1_output_t dst[])
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (n > 0 && (data == NULL || sizes == NULL || dst == NULL)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (data[i] == NULL && sizes[i] > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * calculate digests
+   */
+  if (!ret) hash_many_mt(data, sizes, n, dst);
+
+  return ret;
+}
+
+int
+sha1_fd(int fd, sha1_output_t dst)
+{
+  int ret;
+  int err;
+  sha1_t ctx;
+  struct stat st;
+  off_t pos;
+  off_t off;
+  size_t len;
+  size_t skip;
+  long pgsz;
+  uint8_t* map;
+  uint8_t* buf;
+  ssize_t n;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  map = MAP_FAILED;
+  buf = NULL;
+  len = 0;
+  pos = -1;
+
+  reset(&ctx);
+
+  /*
+   * argument check
+   */
+  do {
+    if (fd < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  if (!ret) {
+    err = fstat(fd, &st);
+    if (err) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * regular file (mmap)
+   *
+   *  現在のオフセットから終端までを窓単位でマップして処理する。マップの開始
+   *  位置はページ境界に揃える必要があるので、最初の窓のみ先頭を読み飛ばす。
+   */
+  if (!ret && S_ISREG(st.st_mode)) {
+    pos  = lseek(fd, 0, SEEK_CUR);
+    pgsz = sysconf(_SC_PAGESIZE);
+
+    while (pos >= 0 && pos < st.st_size) {
+      off  = pos - (pos % pgsz);
+      skip = pos - off;
+      len  = ((uint64_t)(st.st_size - off) > FD_MAP_WINDOW)?
+                                    FD_MAP_WINDOW: (size_t)(st.st_size - off);
+
+      map = (uint8_t*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, off);
+      if (map == MAP_FAILED) break;
+
+      madvise(map, len, MADV_SEQUENTIAL);
+      update(&ctx, map + skip, len - skip);
+      munmap(map, len);
+
+      pos = off + len;
+    }
+
+    if (map != MAP_FAILED) lseek(fd, pos, SEEK_SET);
+  }
+
+  /*
+   * other files (read)
+   *
+   *  パイプ等のmmap()できないファイル、およびmmap()に失敗した場合は途中から
+   *  read()で読み込む。
+   */
+  if (!ret && (!S_ISREG(st.st_mode) || pos < st.st_size)) {
+    if (pos >= 0) lseek(fd, pos, SEEK_SET);
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    buf = (uint8_t*)malloc(FD_READ_SIZE);
+    if (buf == NULL) ret = DEFAULT_ERROR;
+
+    while (!ret) {
+      n = read(fd, buf, FD_READ_SIZE);
+
+      if (n > 0) {
+        update(&ctx, buf, n);
+      } else if (n == 0) {
+        break;
+      } else if (errno != EINTR) {
+        ret = DEFAULT_ERROR;
+      }
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    err = sha1_final(&ctx, dst);
+    if (err) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * post process
+   */
+  if (buf != NULL) free(buf);
+
+  return ret;
+}
+
+#if 0
+#include <stdio.h>
+
+void
+print_digest(sha1_output_t src)
+{
+  int i;
+
+  for (i = 0; i < SHA1_DIGEST_SIZE; i++) printf("%02x", src[i]);
+  printf("\n");
+}
+
+int
+main(int argc, char* argv[])
 {
-  int ret;
-  int err;
   sha1_t* dig;
+  int i;
+  sha1_output_t hash;
+
+  /*
+   * test vector (from FIPS PUB 180-1)
+   *
+   * "abc" 
+   *   -> a9993e364706816aba3e25717850c26c9cd0d89d
+   *
+   * "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+   *   -> 84983e441c3bd26ebaae4aa1f95129e5e54670f1
+   *
+   * million repetitions of "a"
+   *   -> 34aa973cd4c4daa4f61eeb2bdbad27316534016f
+   */
+
+  sha1("abc", 3, hash);
+  print_digest(hash);
+
+  sha1("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, hash);
+  print_digest(hash);
+
+  sha1_new(&dig);
+  for (i = 0; i < 1000000; i++) sha1_update(dig, (void*)"a", 1);
+  sha1_final(dig, hash);
+  sha1_destroy(dig);
+  print_digest(hash);
+}
+#endif
+
+int
+sha1_tree_new(size_t chunk, sha1_tree_t** dst)
+{
+  int ret;
+  sha1_tree_t* obj;
+  long ncpu;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  obj  = NULL;
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (chunk == 0) chunk = TREE_DEFAULT_CHUNK;
+  if (ncpu < 1) ncpu = 1;
+  if (ncpu > TREE_BUF_CHUNKS) ncpu = TREE_BUF_CHUNKS;
+
+  /*
+   * argument check
+   */
+  do {
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (chunk % BLOCK_SIZE != 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(sha1_tree_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    obj->buf = (uint8_t*)malloc(chunk * ncpu);
+    if (obj->buf == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) {
+    obj->chunk = chunk;
+    obj->cap   = chunk * ncpu;
+    tree_reset(obj);
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj != NULL) free(obj);
+  }
+
+  return ret;
+}
+
+int
+sha1_tree_destroy(sha1_tree_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    free(ptr->buf);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+sha1_tree_update(sha1_tree_t* ptr, void* data, size_t size)
+{
+  int ret;
+  uint8_t* p;
+  size_t n;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  p   = (uint8_t*)data;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (data == NULL && size > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update process
+   *
+   *  バッファの容量に満たない入力はバッファに溜め、一杯になった時点でまと
+   *  めて処理する。容量以上の入力は完全なチャンクを入力データから直接処理
+   *  し、端数のみをバッファに複写する。
+   */
+  if (!ret) {
+    ptr->total += size;
+
+    if (ptr->nbuf > 0 || size < ptr->cap) {
+      n = ptr->cap - ptr->nbuf;
+      if (n > size) n = size;
+
+      memcpy(ptr->buf + ptr->nbuf, p, n);
+      ptr->nbuf += n;
+      p         += n;
+      size      -= n;
+
+      if (ptr->nbuf == ptr->cap) {
+        tree_chunks(ptr, ptr->buf, ptr->cap);
+        ptr->nbuf = 0;
+      }
+    }
+
+    if (size >= ptr->cap) {
+      n = tree_chunks(ptr, p, size);
+      p    += n;
+      size -= n;
+    }
+
+    if (size > 0) {
+      memcpy(ptr->buf + ptr->nbuf, p, size);
+      ptr->nbuf += size;
+    }
+  }
+
+  return ret;
+}
+
+int
+sha1_tree_final(sha1_tree_t* ptr, sha1_output_t dst)
+{
+  int ret;
+  sha1_output_t node;
+  uint8_t msg[1 + SHA1_DIGEST_SIZE + 8 + 8];
+  size_t n;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * flush last chunk
+   *
+   *  バッファに残った完全なチャンクを処理した後、端数を最後の葉とする。入
+   *  力が空の場合も空のチャンクを一つの葉として扱う。
+   */
+  if (!ret) {
+    n = tree_chunks(ptr, ptr->buf, ptr->nbuf);
+
+    if (ptr->nbuf > n || ptr->nleaf == 0) {
+      hash_one(ptr->buf + n, ptr->nbuf - n, node);
+      tree_push(ptr, node);
+    }
+
+    ptr->nbuf = 0;
+  }
+
+  /*
+   * fold remaining subtrees (右側の小さい部分木から順に結合する)
+   */
+  if (!ret) {
+    memcpy(node, ptr->stack[ptr->depth - 1], SHA1_DIGEST_SIZE);
+
+    for (i = ptr->depth - 2; i >= 0; i--) {
+      tree_node(ptr->stack[i], node, node);
+    }
+  }
+
+  /*
+   * put return parameter
+   *
+   *  ルートにはデータの総量とチャンクサイズを含めて算出する(木の形状を確
+   *  定させるため)。
+   */
+  if (!ret) {
+    msg[0] = TREE_TAG_ROOT;
+    memcpy(msg + 1, node, SHA1_DIGEST_SIZE);
+
+    for (i = 0; i < 8; i++) {
+      msg[1 + SHA1_DIGEST_SIZE + i]     = (uint8_t)(ptr->total >> ((7 - i) * 8));
+      msg[1 + SHA1_DIGEST_SIZE + 8 + i] =
+                              (uint8_t)((uint64_t)ptr->chunk >> ((7 - i) * 8));
+    }
+
+    hash_one(msg, sizeof(msg), dst);
+  }
+
+  /*
+   * post process
+   */
+  if (!ret) tree_reset(ptr);
+
+  return ret;
+}
+
+int
+sha1_tree_file(const char* path, size_t chunk, sha1_output_t dst)
+{
+  int ret;
+  int err;
+  int fd;
+  struct stat st;
+  void* map;
+  sha1_tree_t* tree;
 
   /*
    * initialize
    */
-  ret = 0;
-  dig = NULL;
+  ret  = 0;
+  fd   = -1;
+  map  = MAP_FAILED;
+  tree = NULL;
 
   /*
    * argument check
    */
-  if (data == NULL) ret = DEFAULT_ERROR;
+  do {
+    if (path == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
 
   /*
    * create calculate context
    */
   if (!ret) {
-    err = sha1_new(&dig);
+    err = sha1_tree_new(chunk, &tree);
     if (err) ret = DEFAULT_ERROR;
   }
 
   /*
-   * input data stream
+   * map file
    */
   if (!ret) {
-    err = sha1_update(dig, data, size);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    err = fstat(fd, &st);
     if (err) ret = DEFAULT_ERROR;
   }
 
+  if (!ret) {
+    if ((uint64_t)st.st_size > SIZE_MAX) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      ret = DEFAULT_ERROR;
+    } else {
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+    }
+  }
+
   /*
-   * put return parameter
+   * calculate digest
    */
+  if (!ret && st.st_size > 0) {
+    err = sha1_tree_update(tree, map, st.st_size);
+    if (err) ret = DEFAULT_ERROR;
+  }
+
   if (!ret) {
-    err = sha1_final(dig, dst);
+    err = sha1_tree_final(tree, dst);
     if (err) ret = DEFAULT_ERROR;
   }
 
   /*
    * post process
    */
-  if (dig != NULL) sha1_destroy(dig);
+  if (map != MAP_FAILED) munmap(map, st.st_size);
+  if (fd >= 0) close(fd);
+  if (tree != NULL) sha1_tree_destroy(tree);
 
   return ret;
 }
 
-#if 0
-#include <stdio.h>
+int
+sha1_hmac_new(const void* key, size_t klen, sha1_hmac_t** dst)
+{
+  int ret;
+  sha1_hmac_t* obj;
 
-void
-print_digest(sha1_output_t src)
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (key == NULL && klen > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * memory allocate
+   */
+  if (!ret) {
+    obj = ALLOC(sha1_hmac_t);
+    if (obj == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * setup object
+   */
+  if (!ret) hmac_setup(obj, key, klen);
+
+  /*
+   * put return paramter
+   */
+  if (!ret) *dst = obj;
+
+  return ret;
+}
+
+int
+sha1_hmac_destroy(sha1_hmac_t* ptr)
 {
-  int i;
+  int ret;
 
-  for (i = 0; i < SHA1_DIGEST_SIZE; i++) printf("%02x", src[i]);
-  printf("\n");
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = DEFAULT_ERROR;
+
+  /*
+   * release resources
+   */
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+    free(ptr);
+  }
+
+  return ret;
 }
 
 int
-main(int argc, char* argv[])
+sha1_hmac(sha1_hmac_t* ptr, const void* data, size_t size, sha1_output_t dst)
 {
-  sha1_t* dig;
-  int i;
-  sha1_output_t hash;
+  int ret;
 
   /*
-   * test vector (from FIPS PUB 180-1)
-   *
-   * "abc" 
-   *   -> a9993e364706816aba3e25717850c26c9cd0d89d
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (data == NULL && size > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calculate MAC
+   */
+  if (!ret) hmac_one(ptr, data, size, dst);
+
+  return ret;
+}
+
+int
+sha1_hmac_many(sha1_hmac_t* ptr, const void* data[], const size_t sizes[],
+               size_t n, sha1_output_t dst[])
+{
+  int ret;
+  const void* msg[HMAC_BATCH];
+  size_t len[HMAC_BATCH];
+  size_t i;
+  size_t j;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (n > 0 && (data == NULL || sizes == NULL || dst == NULL)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (data[i] == NULL && sizes[i] > 0) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * calculate MACs
    *
-   * "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
-   *   -> 84983e441c3bd26ebaae4aa1f95129e5e54670f1
+   *  内側ハッシュの結果をdstに書き込み、それを入力として外側ハッシュを算出
+   *  する(入力はレーンへの割り当て時にレーン内に複写されるので、同じ領域に
+   *  結果を書き戻しても問題ない)。
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = (n - i < HMAC_BATCH)? n - i: HMAC_BATCH;
+
+      hash_many_from(ptr->ih, BLOCK_SIZE, data + i, sizes + i, m, dst + i);
+
+      for (j = 0; j < m; j++) {
+        msg[j] = dst[i + j];
+        len[j] = SHA1_DIGEST_SIZE;
+      }
+
+      hash_many_from(ptr->oh, BLOCK_SIZE, msg, len, m, dst + i);
+    }
+  }
+
+  return ret;
+}
+
+int
+sha1_pbkdf2(const void* pass, size_t plen, const void* salt, size_t slen,
+            uint32_t iter, void* dst, size_t dlen)
+{
+  int ret;
+  sha1_hmac_t key;
+  sha1_t ctx;
+  uint8_t u[LANES][BLOCK_SIZE];
+  sha1_output_t t[LANES];
+  uint8_t cnt[4];
+  uint64_t nblk;
+  uint64_t blk;
+  size_t off;
+  size_t len;
+  int n;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  nblk = ((uint64_t)dlen + SHA1_DIGEST_SIZE - 1) / SHA1_DIGEST_SIZE;
+
+  /*
+   * argument check
+   */
+  do {
+    if (pass == NULL && plen > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (salt == NULL && slen > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (iter == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL && dlen > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (nblk > 0xffffffff) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * setup
    *
-   * million repetitions of "a"
-   *   -> 34aa973cd4c4daa4f61eeb2bdbad27316534016f
+   *  反復ブロックのパディングは「前置ブロック(64バイト) + 20バイト」の長さ
+   *  で固定となる。
    */
+  if (!ret) {
+    hmac_setup(&key, pass, plen);
 
-  sha1("abc", 3, hash);
-  print_digest(hash);
+    memset(u, 0, sizeof(u));
+    for (i = 0; i < LANES; i++) {
+      u[i][SHA1_DIGEST_SIZE] = 0x80;
+      u[i][BLOCK_SIZE - 2]   = (uint8_t)(((BLOCK_SIZE + SHA1_DIGEST_SIZE) * 8) >> 8);
+      u[i][BLOCK_SIZE - 1]   = (uint8_t)(((BLOCK_SIZE + SHA1_DIGEST_SIZE) * 8) & 0xff);
+    }
+  }
 
-  sha1("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, hash);
-  print_digest(hash);
+  /*
+   * derive key
+   *
+   *  出力ブロックはLANES個ずつまとめて反復処理を行う。
+   */
+  if (!ret) {
+    for (blk = 0; blk < nblk; blk += n) {
+      n = (nblk - blk < LANES)? (int)(nblk - blk): LANES;
+
+      for (i = 0; i < n; i++) {
+        cnt[0] = (uint8_t)((blk + i + 1) >> 24);
+        cnt[1] = (uint8_t)((blk + i + 1) >> 16);
+        cnt[2] = (uint8_t)((blk + i + 1) >> 8);
+        cnt[3] = (uint8_t)((blk + i + 1) >> 0);
+
+        memcpy(ctx.state, key.ih, sizeof(ctx.state));
+        ctx.count[0] = BLOCK_SIZE * 8;
+        ctx.count[1] = 0;
+
+        if (slen > 0) update(&ctx, salt, slen);
+        update(&ctx, cnt, sizeof(cnt));
+        sha1_final(&ctx, u[i]);
+
+        hash_from(key.oh, BLOCK_SIZE, u[i], SHA1_DIGEST_SIZE, u[i]);
+        memcpy(t[i], u[i], SHA1_DIGEST_SIZE);
+      }
+
+      pbkdf2_iterate(&key, u, t, n, iter);
+
+      for (i = 0; i < n; i++) {
+        off = (blk + i) * SHA1_DIGEST_SIZE;
+        len = (dlen - off < SHA1_DIGEST_SIZE)? dlen - off: SHA1_DIGEST_SIZE;
+        memcpy((uint8_t*)dst + off, t[i], len);
+      }
+    }
+  }
 
-  sha1_new(&dig);
-  for (i = 0; i < 1000000; i++) sha1_update(dig, (void*)"a", 1);
-  sha1_final(dig, hash);
-  sha1_destroy(dig);
-  print_digest(hash);
+  /*
+   * post process
+   */
+  memset(&key, 0, sizeof(key));
+  memset(u, 0, sizeof(u));
+  memset(t, 0, sizeof(t));
+
+  return ret;
 }
-#endif
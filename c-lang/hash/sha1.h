@@ -4,9 +4,11 @@
  *  Copyright (C) 2023 Hiroshi Kuwagata <kgt9221@gmail.com>
  */
 #ifndef __SHA1_H__
+#define __SHA1_H__
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #define SHA1_DIGEST_SIZE  20
 
@@ -25,6 +27,24 @@ typedef struct __sha1_t__ sha1_t;
  */
 typedef uint8_t sha1_output_t[SHA1_DIGEST_SIZE];
 
+/**
+ * @brief
+ *  ツリーモードの算出処理コンテキストを抽象化した型
+ *
+ * @see
+ *  struct __sha1_tree_t__
+ */
+typedef struct __sha1_tree_t__ sha1_tree_t;
+
+/**
+ * @brief
+ *  HMAC-SHA1の鍵(事前計算済みの中間状態)を抽象化した型
+ *
+ * @see
+ *  struct __sha1_hmac_t__
+ */
+typedef struct __sha1_hmac_t__ sha1_hmac_t;
+
 /**
  * @brief
  *  SHA1算出コンテキストの生成
@@ -60,6 +80,24 @@ int sha1_destroy(sha1_t* ptr);
  */
 int sha1_update(sha1_t* ptr, void* data, size_t size);
 
+/**
+ * @brief
+ *  SHA1算出コンテキストの更新(分散バッファ)
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] iov  入力データの配列
+ * @param [in] n  iovの要素数
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  iovの各要素を順にsha1_update()した場合と同じ結果となる。各要素に含まれ
+ *  る完全なブロックは要素のメモリから直接処理し、要素の境界をまたぐブロッ
+ *  クのみをコンテキスト内で組み立てるので、事前に連結する必要は無い。
+ */
+int sha1_updatev(sha1_t* ptr, const struct iovec* iov, int n);
+
 /**
  * @brief
  *  SHA1算出コンテキストのファイナライズ
@@ -84,4 +122,223 @@ int sha1_finalize(sha1_t* ptr, sha1_output_t dst);
  */
 int sha1(void* data, size_t size, sha1_output_t dst);
 
+/**
+ * @brief
+ *  ファイルディスクリプタから読み出したデータのSHA1算出
+ *
+ * @param [in] fd  入力元のファイルディスクリプタ
+ * @param [out] dst  算出結果の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  現在のオフセットから終端までのデータを対象とし、処理後のオフセットは終
+ *  端となる。通常ファイルはmmap()でマップして(MADV_SEQUENTIAL指定)複写せず
+ *  に処理し、パイプやソケット等はread()で読み込んで処理する。
+ */
+int sha1_fd(int fd, sha1_output_t dst);
+
+/**
+ * @brief
+ *  複数メッセージのSHA1の一括算出
+ *
+ * @param [in] data  入力データへのポインタの配列
+ * @param [in] sizes  入力データのサイズの配列
+ * @param [in] n  メッセージの数
+ * @param [out] dst  算出結果の格納先の配列
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  各メッセージについてsha1()と同じ値を算出する。x86ではCPUIDで使用可能な
+ *  命令を判定し、SHA拡張命令(SHA-NI)が使用可能であればそれを、そうでなく
+ *  AVX2が使用可能であれば8個のメッセージを同時に処理するマルチバッファ実
+ *  装を使用する。
+ *
+ * @remark
+ *  データの総量が十分に大きい場合は、オンラインのCPU数を上限としてスレッ
+ *  ドを生成し、メッセージを分担して処理する(呼び出し元のスレッドも処理に加
+ *  わる)。算出用のコンテキストはスタック上に確保し、ヒープからのメモリ確保
+ *  は行わない。結果の格納先は呼び出し側で用意すること。
+ */
+int sha1_many(const void* data[], const size_t sizes[], size_t n,
+              sha1_output_t dst[]);
+
+/**
+ * @brief
+ *  ツリーモード算出コンテキストの生成
+ *
+ * @param [in] chunk  チャンク(葉)のサイズ(0を指定した場合は1MiB)
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ツリーモードでは入力をchunkバイト毎のチャンクに分割して各チャンクの
+ *  SHA1を葉とし、節を H(0x01 || 左 || 右) としたマークル木のルートを算出す
+ *  る。最終的な出力は H(0x02 || ルート || 総サイズ || chunk) (数値は64ビット
+ *  ビッグエンディアン)となる。チャンクの算出はsha1_many()と同様にスレッド
+ *  に分割して行うので、大きなデータではCPU数に応じた速度が得られる。
+ *
+ * @remark
+ *  出力は通常のSHA1とは互換性が無く、同じデータでもchunkが異なれば別の値と
+ *  なる。chunkにはSHA1のブロックサイズ(64バイト)の倍数を指定すること。
+ */
+int sha1_tree_new(size_t chunk, sha1_tree_t** dst);
+
+/**
+ * @brief
+ *  ツリーモード算出コンテキストの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int sha1_tree_destroy(sha1_tree_t* ptr);
+
+/**
+ * @brief
+ *  ツリーモード算出コンテキストの更新
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [in] data  入力データへのポインタ
+ * @param [in] size  入力データのサイズ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  入力の分割のされ方は結果に影響しない。小さな単位で渡されたデータはCPU
+ *  数分のチャンクが溜まるまでコンテキスト内に複写してからまとめて処理し、
+ *  それ以上の大きさのデータは完全なチャンクを入力データから直接処理する。
+ */
+int sha1_tree_update(sha1_tree_t* ptr, void* data, size_t size);
+
+/**
+ * @brief
+ *  ツリーモード算出コンテキストのファイナライズ
+ *
+ * @param [in] ptr  対象オブジェクトのポインタ
+ * @param [out] dst  算出結果の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  処理後、コンテキストは生成直後の状態に戻る。
+ */
+int sha1_tree_final(sha1_tree_t* ptr, sha1_output_t dst);
+
+/**
+ * @brief
+ *  ファイルのツリーモードSHA1の算出
+ *
+ * @param [in] path  対象ファイルのパス
+ * @param [in] chunk  チャンクのサイズ(sha1_tree_new()と同じ)
+ * @param [out] dst  算出結果の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  ファイルはmmap()でマップして(MADV_SEQUENTIAL指定)直接処理する。
+ */
+int sha1_tree_file(const char* path, size_t chunk, sha1_output_t dst);
+
+/**
+ * @brief
+ *  HMAC-SHA1の鍵オブジェクトの生成
+ *
+ * @param [in] key  鍵へのポインタ
+ * @param [in] klen  鍵のサイズ
+ * @param [out] dst  生成したオブジェクトの格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  鍵とipad/opadのXORを処理した内側・外側の中間状態を事前に算出して保持す
+ *  る(鍵そのものは保持しない)。同じ鍵で多数のメッセージを処理する場合は、
+ *  このオブジェクトを使い回すことで鍵の処理を省くことができる。
+ */
+int sha1_hmac_new(const void* key, size_t klen, sha1_hmac_t** dst);
+
+/**
+ * @brief
+ *  HMAC-SHA1の鍵オブジェクトの破棄
+ *
+ * @param [in] ptr  破棄対象オブジェクトのポインタ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ */
+int sha1_hmac_destroy(sha1_hmac_t* ptr);
+
+/**
+ * @brief
+ *  HMAC-SHA1の算出
+ *
+ * @param [in] ptr  鍵オブジェクトのポインタ
+ * @param [in] data  メッセージへのポインタ
+ * @param [in] size  メッセージのサイズ
+ * @param [out] dst  算出結果の格納先
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  メモリの確保は行わない。55バイト以下のメッセージであれば圧縮関数の呼び
+ *  出しは内側・外側の二回のみとなる。
+ */
+int sha1_hmac(sha1_hmac_t* ptr, const void* data, size_t size,
+              sha1_output_t dst);
+
+/**
+ * @brief
+ *  複数メッセージのHMAC-SHA1の一括算出
+ *
+ * @param [in] ptr  鍵オブジェクトのポインタ
+ * @param [in] data  メッセージへのポインタの配列
+ * @param [in] sizes  メッセージのサイズの配列
+ * @param [in] n  メッセージの数
+ * @param [out] dst  算出結果の格納先の配列
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  sha1_many()と同様に、AVX2が使用可能であればマルチバッファ実装で処理す
+ *  る(スレッドの生成は行わない)。
+ */
+int sha1_hmac_many(sha1_hmac_t* ptr, const void* data[], const size_t sizes[],
+                   size_t n, sha1_output_t dst[]);
+
+/**
+ * @brief
+ *  PBKDF2-HMAC-SHA1による鍵導出
+ *
+ * @param [in] pass  パスワードへのポインタ
+ * @param [in] plen  パスワードのサイズ
+ * @param [in] salt  ソルトへのポインタ
+ * @param [in] slen  ソルトのサイズ
+ * @param [in] iter  反復回数(1以上)
+ * @param [out] dst  導出した鍵の格納先
+ * @param [in] dlen  導出する鍵のサイズ
+ *
+ * @return
+ *  処理に成功した場合は0を、失敗した場合は0以外の値を返す。
+ *
+ * @remark
+ *  RFC 8018の定義に従う。反復一回あたりの圧縮関数の呼び出しは二回で、メモ
+ *  リの確保は行わない。dlenが20バイトを超える場合(出力ブロックが複数の場合)
+ *  は、AVX2が使用可能であれば複数の出力ブロックをマルチバッファ実装で同時
+ *  に処理する。
+ */
+int sha1_pbkdf2(const void* pass, size_t plen, const void* salt, size_t slen,
+                uint32_t iter, void* dst, size_t dlen);
+
 #endif /* !defined(__SHA1_H__) */
@@ -0,0 +1,210 @@
+﻿#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fnv1.h"
+#include "sha1.h"
+#include "chunker.h"
+#include "hll.h"
+
+struct span {
+  uint64_t off;         // 次に期待するチャンクの先頭位置
+  uint64_t size;        // コールバックで受け取ったデータの総量
+  int error;
+};
+
+static int
+chunk_cb(void* arg, uint64_t off, const void* data, size_t size,
+         const sha1_output_t digest)
+{
+  struct span* sp;
+
+  sp = (struct span*)arg;
+
+  if (off != sp->off) sp->error = !0;
+
+  sp->off  += size;
+  sp->size += size;
+
+  return 0;
+}
+
+/*
+ * fnv1_fast64()のレーンの畳み込みによる衝突が無いこと
+ *
+ *  二つのレーンが同じ値になるキー(第2ワード = 第1ワード ^ 3)や、レーンに
+ *  割り当てられるワードを入れ替えたキーが同じ値にならないことを確認する。
+ *  また、一括処理版が単独の場合と同じ値を返すことを確認する。
+ */
+static int
+test_fnv_fast_lanes(void)
+{
+  uint64_t k[8][4] = {
+    {0x1122334455667788ULL, 0x1122334455667788ULL ^ 3},
+    {0xdeadbeefcafebabeULL, 0xdeadbeefcafebabeULL ^ 3},
+    {42, 42 ^ 3, 7, 8},
+    {99999, 99999 ^ 3, 7, 8},
+    {1, 2, 3, 4},
+    {2, 1, 3, 4},
+    {1, 2, 4, 3},
+    {4, 3, 2, 1},
+  };
+  size_t len[8] = {16, 16, 32, 32, 32, 32, 32, 32};
+  void* src[40];
+  size_t sizes[40];
+  uint64_t h[8];
+  uint64_t many[40];
+  uint8_t buf[400];
+  int fail;
+  int round;
+  int i;
+  int j;
+
+  fail = 0;
+
+  for (i = 0; i < 8; i++) h[i] = fnv1_fast64(k[i], len[i]);
+
+  for (i = 0; i < 8; i++) {
+    for (j = i + 1; j < 8; j++) {
+      if (h[i] == h[j]) {
+        printf("fnv1_fast64: collision %d %d (%016llx)\n", i, j,
+               (unsigned long long)h[i]);
+        fail++;
+      }
+    }
+  }
+
+  for (i = 0; i < (int)sizeof(buf); i++) buf[i] = (uint8_t)(i * 131 + 7);
+
+  // 長さが不揃いな場合と、SIMD版で処理される程度に揃っている場合
+  for (round = 0; round < 2; round++) {
+    for (i = 0; i < 40; i++) {
+      src[i]   = buf + i;
+      sizes[i] = (round == 0)? (i * 37) % 300: 64 + (i * 5);
+    }
+
+    fnv1_fast64_many(src, sizes, 40, many);
+    for (i = 0; i < 40; i++) {
+      if (many[i] != fnv1_fast64(src[i], sizes[i])) fail++;
+    }
+
+    fnv164_many(src, sizes, 40, many);
+    for (i = 0; i < 40; i++) {
+      if (many[i] != fnv164(src[i], sizes[i])) fail++;
+    }
+  }
+
+  printf("fnv: fail=%d\n", fail);
+
+  return fail;
+}
+
+/*
+ * 空のストリームを終端した後にコンテキストを再利用する
+ */
+static int
+test_chunker_empty(void)
+{
+  chunker_t* ck;
+  struct span sp;
+  uint8_t* data;
+  size_t i;
+  int err;
+
+  data = (uint8_t*)malloc(100000);
+  for (i = 0; i < 100000; i++) data[i] = (uint8_t)((i * 2654435761U) >> 13);
+
+  memset(&sp, 0, sizeof(sp));
+  chunker_new(256, 1024, 4096, chunk_cb, &sp, &ck);
+
+  err = chunker_finish(ck);
+  printf("finish(empty): err=%d size=%lu\n", err, (unsigned long)sp.size);
+
+  if (!err) err = chunker_feed(ck, data, 100000);
+  if (!err) err = chunker_finish(ck);
+  printf("finish(100000): err=%d size=%lu\n", err, (unsigned long)sp.size);
+
+  chunker_destroy(ck);
+  free(data);
+
+  return (err || sp.error || sp.size != 100000);
+}
+
+/*
+ * 疎な表現から密な表現への切り替えをまたいで追加と計数を交互に行う
+ *
+ *  途中の計数や併合で疎な表現の領域があふれないこと、最終的な推定値が一括
+ *  で追加した場合と一致することを確認する。
+ */
+static int
+test_hll_interleave(void)
+{
+  hll_t* ref;
+  hll_t* hl;
+  hll_t* src;
+  hll_t* dst;
+  double a;
+  double b;
+  double c;
+  uint64_t i;
+  int err;
+
+  hll_new(10, &ref);
+  hll_new(10, &hl);
+  hll_new(10, &src);
+  hll_new(10, &dst);
+
+  err = 0;
+
+  for (i = 0; !err && i < 5000; i++) {
+    hll_add(ref, &i, sizeof(i));
+
+    err = hll_add(hl, &i, sizeof(i));
+    if (!err) err = hll_count(hl, &a);
+  }
+
+  // 未整列分を残したままの併合元に、併合後も追加を続ける
+  for (i = 0; !err && i < 400; i++) err = hll_add(src, &i, sizeof(i));
+  if (!err) err = hll_merge(dst, src);
+  for (i = 400; !err && i < 5000; i++) err = hll_add(src, &i, sizeof(i));
+  if (!err) err = hll_merge(dst, src);
+
+  if (!err) err = hll_count(ref, &a);
+  if (!err) err = hll_count(hl, &b);
+  if (!err) err = hll_count(dst, &c);
+
+  printf("hll: err=%d ref=%.1f interleave=%.1f merge=%.1f\n", err, a, b, c);
+
+  hll_destroy(ref);
+  hll_destroy(hl);
+  hll_destroy(src);
+  hll_destroy(dst);
+
+  return (err || a != b || a != c);
+}
+
+int
+main(int argc, char* argv[])
+{
+  int fail;
+
+  fail = 0;
+
+  if (test_fnv_fast_lanes()) {
+    printf("fnv: NG\n");
+    fail++;
+  }
+
+  if (test_chunker_empty()) {
+    printf("chunker: NG\n");
+    fail++;
+  }
+
+  if (test_hll_interleave()) {
+    printf("hll: NG\n");
+    fail++;
+  }
+
+  return fail;
+}
@@ -226,3 +226,48 @@ cronog_result(cronog_t* ptr, int64_t* dst)
 
   return ret;
 }
+
+int
+cronog_result_ns(cronog_t* ptr, int64_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check object state
+   */
+  if (!ret) {
+    if (!(TEST_FLAG(ptr, STARTED) && TEST_FLAG(ptr, STOPPED))) {
+      ret = DEFAULT_ERROR;
+    }
+  }
+
+  /*
+   * put return paramter
+   */
+  if (!ret) {
+    *dst = ((ptr->ts.tv_sec - ptr->ts0.tv_sec) * 1000000000) +
+           (ptr->ts.tv_nsec - ptr->ts0.tv_nsec);
+  }
+
+  return ret;
+}